@@ -0,0 +1,463 @@
+#define _GNU_SOURCE	// posix_openpt(), cfmakeraw()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "UartPty.h"
+#include "PortIO.h"
+#include "Serial.h"
+#include "Clock.h"
+#include "Random.h"
+
+#define UART_FIFO		16		// Bytes each FIFO holds
+#define WIRE_RECORD		7		// Bytes of the pty per byte sent: byte, divisor (u16), written (u32)
+#define WIRE_QUEUE		1024	// Bytes sent and still on the line, at most
+#define MSR_LINE_UP		0xB0	// Carrier detect, data set ready, clear to send
+
+typedef struct {
+	unsigned char byte;
+	unsigned char lsr;		// Errors it arrived with
+	uint64_t written;		// When it was written to THR, on the sending end
+} UartByte_t;
+
+typedef struct {
+	uint64_t due;			// When it arrives
+	unsigned char record[WIRE_RECORD];
+} WireByte_t;
+
+typedef struct {
+	unsigned long base;		// First register
+	int fd;
+	char name[128];
+	UartPtyConf_t conf;
+	Rng_t rng;
+	UartPtyStats_t stats;
+
+	// Registers
+	unsigned char ier, lcr, mcr, scr, dll, dlm;
+	int fifo_on;
+	unsigned rx_trigger;
+
+	// Receiving side
+	UartByte_t rx_fifo[UART_FIFO];
+	unsigned rx_head, rx_count;
+	int overrun;				// Sticky until LSR is read
+	uint64_t rx_activity;		// Last byte received or read, for the timeout interrupt
+	unsigned char in_record[WIRE_RECORD];	// Record being read from the pty
+	unsigned in_len;
+
+	// Sending side
+	UartByte_t tx_fifo[UART_FIFO];
+	unsigned tx_head, tx_count;
+	UartByte_t tx_shift;		// Byte being sent
+	int tx_shifting;
+	uint64_t tx_done;			// When the byte being sent, or the last one, is out
+	int thre_pending;			// THR empty interrupt, until IIR reports it or THR is written
+	WireByte_t wire[WIRE_QUEUE];	// Sent, not arrived yet
+	unsigned wire_head, wire_count, wire_written;
+} Uart_t;
+
+static Uart_t uarts[UART_PTY_UARTS] = { { COM1_PORT, -1 }, { COM2_PORT, -1 } };
+
+static unsigned divisor(const Uart_t * u) {
+	unsigned div = u->dll | (u->dlm << 8);
+	return div ? div : 1;
+}
+
+// Private Method -- Microseconds a byte takes on the line: start, 8 data and stop bits
+static uint64_t byte_us(const Uart_t * u) {
+	return 10ULL * 1000000 * divisor(u) / SERIAL_BASE_BR;
+}
+
+// Private Method -- Puts a byte sent on the line, to arrive after the latency
+static void wire_push(Uart_t * u, const UartByte_t * b, unsigned div,
+		uint64_t sent) {
+	WireByte_t * w;
+
+	if (WIRE_QUEUE == u->wire_count)
+		return; // The pty is not read, the other end is gone
+
+	w = &u->wire[(u->wire_head + u->wire_count++) % WIRE_QUEUE];
+	w->due = sent + u->conf.latency_us;
+	w->record[0] = b->byte;
+	w->record[1] = div & 0xFF;
+	w->record[2] = div >> 8;
+	w->record[3] = b->written & 0xFF;
+	w->record[4] = (b->written >> 8) & 0xFF;
+	w->record[5] = (b->written >> 16) & 0xFF;
+	w->record[6] = (b->written >> 24) & 0xFF;
+	++u->stats.tx_bytes;
+}
+
+// Private Method -- Writes the bytes arrived at the other end to the pty
+static void wire_flush(Uart_t * u, uint64_t now) {
+	while (0 != u->wire_count && u->wire[u->wire_head].due <= now) {
+		WireByte_t * w = &u->wire[u->wire_head];
+		ssize_t n = write(u->fd, w->record + u->wire_written, WIRE_RECORD - u->wire_written);
+
+		if (n <= 0)
+			return; // Full, or nobody on the other end yet
+		if ((u->wire_written += n) < WIRE_RECORD)
+			return;
+
+		u->wire_written = 0;
+		u->wire_head = (u->wire_head + 1) % WIRE_QUEUE;
+		--u->wire_count;
+	}
+}
+
+// Private Method -- Sends the bytes of the transmit FIFO, one every byte_us()
+static void tx_run(Uart_t * u, uint64_t now) {
+	for (;;) {
+		if (u->tx_shifting) {
+			if (u->tx_done > now)
+				return;
+			wire_push(u, &u->tx_shift, divisor(u), u->tx_done);
+			u->tx_shifting = 0;
+		}
+		if (0 == u->tx_count)
+			return;
+
+		u->tx_shift = u->tx_fifo[u->tx_head];
+		u->tx_head = (u->tx_head + 1) % UART_FIFO;
+		--u->tx_count;
+		u->tx_done = (u->tx_done > u->tx_shift.written ? u->tx_done : u->tx_shift.written) + byte_us(u);
+		u->tx_shifting = 1;
+		if (0 == u->tx_count)
+			u->thre_pending = 1;
+	}
+}
+
+// Private Method -- A byte arrived: checks it was sent at this end's rate, and spoils it if asked to
+static void rx_arrive(Uart_t * u, const unsigned char * record,
+		uint64_t now) {
+	unsigned div = record[1] | (record[2] << 8);
+	UartByte_t b;
+
+	b.byte = record[0];
+	b.lsr = 0;
+	b.written = record[3] | (record[4] << 8) | (record[5] << 16)
+			| ((uint32_t) record[6] << 24);
+	++u->stats.rx_bytes;
+
+	if (div != divisor(u) || (0 != u->conf.max_rate && SERIAL_BASE_BR / div > u->conf.max_rate)) {
+		b.byte ^= 1 + rng_below(&u->rng, 255);
+		b.lsr = LSR_FE;
+		++u->stats.garbled;
+	} else if (0 != u->conf.error_ppm && rng_below(&u->rng, 1000000) < u->conf.error_ppm) {
+		b.byte ^= 1 << rng_below(&u->rng, 8);
+		b.lsr = LSR_FE;
+		++u->stats.errors;
+	} else if (0 != u->conf.noise_ppm && rng_below(&u->rng, 1000000) < u->conf.noise_ppm) {
+		b.byte ^= 1 << rng_below(&u->rng, 8);
+		++u->stats.errors;
+	}
+
+	if (UART_FIFO == u->rx_count) {
+		u->overrun = 1;
+		++u->stats.overruns;
+		return;
+	}
+	u->rx_fifo[(u->rx_head + u->rx_count++) % UART_FIFO] = b;
+	u->rx_activity = now;
+}
+
+// Private Method -- Takes the bytes the pty holds
+static void rx_take(Uart_t * u, uint64_t now) {
+	unsigned char buf[256];
+	ssize_t n, i;
+
+	while ((n = read(u->fd, buf, sizeof(buf))) > 0) {
+		for (i = 0; i < n; ++i) {
+			u->in_record[u->in_len++] = buf[i];
+			if (WIRE_RECORD == u->in_len) {
+				rx_arrive(u, u->in_record, now);
+				u->in_len = 0;
+			}
+		}
+	}
+}
+
+static unsigned char rx_pop(Uart_t * u, uint64_t now) {
+	UartByte_t * b;
+	uint32_t latency;
+
+	if (0 == u->rx_count)
+		return 0;
+
+	b = &u->rx_fifo[u->rx_head];
+	u->rx_head = (u->rx_head + 1) % UART_FIFO;
+	--u->rx_count;
+	u->rx_activity = now;
+
+	// Both ends read the same monotonic clock
+	latency = (uint32_t) now - (uint32_t) b->written;
+	++u->stats.read;
+	u->stats.latency_us += latency;
+	if (latency > u->stats.max_latency_us)
+		u->stats.max_latency_us = latency;
+	return b->byte;
+}
+
+static unsigned char lsr_value(const Uart_t * u) {
+	unsigned char lsr = 0;
+	unsigned i;
+
+	if (0 != u->rx_count)
+		lsr |= LSR_RD | u->rx_fifo[u->rx_head].lsr;
+	if (u->overrun)
+		lsr |= LSR_OE;
+	for (i = 0; i < u->rx_count; ++i)
+		if (u->rx_fifo[(u->rx_head + i) % UART_FIFO].lsr)
+			lsr |= LSR_FIFO_E;
+	if (0 == u->tx_count)
+		lsr |= LSR_THRE | (u->tx_shifting ? 0 : LSR_TER);
+	return lsr;
+}
+
+// Private Method -- Interrupt pending, highest priority first
+static unsigned char iir_value(const Uart_t * u, uint64_t now) {
+	unsigned char iir = IIR_NPI;
+
+	if ((u->ier & IER_RLS) && (u->overrun || (0 != u->rx_count && u->rx_fifo[u->rx_head].lsr)))
+		iir = IIR_ID_LSR;
+	else if ((u->ier & IER_RDA) && u->rx_count >= u->rx_trigger)
+		iir = IIR_ID_RDA;
+	else if ((u->ier & IER_RDA) && 0 != u->rx_count && now - u->rx_activity >= 4 * byte_us(u))
+		iir = IIR_ID_TIMEOUT;
+	else if ((u->ier & IER_THRE) && u->thre_pending)
+		iir = IIR_ID_THRE;
+
+	return iir | (u->fifo_on ? 0xC0 : 0);
+}
+
+// Private Method -- UART whose registers hold a port, NULL if none is open there
+static Uart_t * uart_at(unsigned long port) {
+	unsigned i;
+
+	for (i = 0; i < UART_PTY_UARTS; ++i)
+		if (port >= uarts[i].base && port <= uarts[i].base + SR && uarts[i].fd >= 0)
+			return &uarts[i];
+	return NULL;
+}
+
+// Private Method -- Runs a UART up to now
+static void uart_update(Uart_t * u, uint64_t now) {
+	if (u->fd < 0)
+		return;
+
+	tx_run(u, now);
+	wire_flush(u, now);
+	rx_take(u, now);
+}
+
+int port_inb(unsigned long port, unsigned long * value) {
+	uint64_t now = now_us();
+	Uart_t * u = uart_at(port);
+
+	if (NULL == u) {
+		printf("port_inb -> FAILED no device at 0x%lx\n", port);
+		return 1;
+	}
+	uart_update(u, now);
+
+	switch (port - u->base) {
+	case RBR:
+		*value = (u->lcr & LCR_DLAB) ? u->dll : rx_pop(u, now);
+		break;
+	case IER:
+		*value = (u->lcr & LCR_DLAB) ? u->dlm : u->ier;
+		break;
+	case IIR:
+		*value = iir_value(u, now);
+		if (IIR_ID_THRE == (*value & IIR_ID))
+			u->thre_pending = 0; // Reporting it clears it
+		break;
+	case LCR:
+		*value = u->lcr;
+		break;
+	case MCR:
+		*value = u->mcr;
+		break;
+	case LSR:
+		*value = lsr_value(u);
+		u->overrun = 0; // Errors are reported once
+		if (0 != u->rx_count)
+			u->rx_fifo[u->rx_head].lsr = 0;
+		break;
+	case MSR:
+		*value = MSR_LINE_UP;
+		break;
+	default:
+		*value = u->scr;
+		break;
+	}
+
+	return OK;
+}
+
+int port_outb(unsigned long port, unsigned long value) {
+	static const unsigned triggers[] = { 1, 4, 8, 14 };
+	uint64_t now = now_us();
+	Uart_t * u = uart_at(port);
+
+	if (NULL == u) {
+		printf("port_outb -> FAILED no device at 0x%lx\n", port);
+		return 1;
+	}
+	uart_update(u, now);
+	value &= 0xFF;
+
+	switch (port - u->base) {
+	case THR:
+		if (u->lcr & LCR_DLAB) {
+			u->dll = value;
+		} else {
+			if (u->tx_count < (u->fifo_on ? UART_FIFO : 1)) {
+				UartByte_t * b = &u->tx_fifo[(u->tx_head + u->tx_count++) % UART_FIFO];
+				b->byte = value;
+				b->lsr = 0;
+				b->written = now;
+			}
+			u->thre_pending = 0;
+			tx_run(u, now);
+		}
+		break;
+	case IER:
+		if (u->lcr & LCR_DLAB) {
+			u->dlm = value;
+		} else {
+			// Enabling it while THR is empty raises it at once
+			if ((value & IER_THRE) && !(u->ier & IER_THRE) && 0 == u->tx_count)
+				u->thre_pending = 1;
+			u->ier = value & 0x0F;
+		}
+		break;
+	case FCR:
+		u->fifo_on = value & FIFO_EN;
+		if (value & FIFO_CR)
+			u->rx_count = 0;
+		if (value & FIFO_CX)
+			u->tx_count = 0;
+		u->rx_trigger = u->fifo_on ? triggers[value >> 6] : 1;
+		break;
+	case LCR:
+		u->lcr = value;
+		break;
+	case MCR:
+		u->mcr = value;
+		break;
+	case SR:
+		u->scr = value;
+		break;
+	default: // LSR and MSR are read only
+		break;
+	}
+
+	return OK;
+}
+
+// The emulated UART settles at once
+void port_delay(unsigned long us) {
+	uart_pty_update();
+}
+
+int uart_pty_create(char * name, unsigned size) {
+	int fd;
+
+	if ((fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || 0 != grantpt(fd)
+			|| 0 != unlockpt(fd)) {
+		printf("uart_pty_create -> FAILED to create a pty: %s\n", strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	strncpy(name, ptsname(fd), size - 1);
+	name[size - 1] = '\0';
+	return fd;
+}
+
+int uart_pty_adopt(unsigned uart, int fd, const char * name,
+		const UartPtyConf_t * line) {
+	Uart_t * u = &uarts[uart];
+	struct termios tio;
+
+	u->fd = fd;
+	strncpy(u->name, name, sizeof(u->name) - 1);
+
+	// Bytes go through untouched: no echo, no line editing, no newline translation
+	if (0 != tcgetattr(fd, &tio)) {
+		printf("uart_pty_open -> FAILED tcgetattr(): %s\n", strerror(errno));
+		uart_pty_close(uart);
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(fd, TCSANOW, &tio);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	u->conf = *line;
+	rng_seed(&u->rng, u->conf.seed);
+	memset(&u->stats, 0, sizeof(u->stats));
+
+	u->ier = u->lcr = u->mcr = u->scr = 0;
+	u->dll = SERIAL_BASE_BR / 9600;
+	u->dlm = 0;
+	u->fifo_on = 0;
+	u->rx_trigger = 1;
+	u->rx_count = u->tx_count = u->wire_count = 0;
+	u->in_len = u->wire_written = 0;
+	u->overrun = u->thre_pending = u->tx_shifting = 0;
+	u->tx_done = 0;
+
+	return OK;
+}
+
+int uart_pty_open(unsigned uart, const char * path, const UartPtyConf_t * line) {
+	char name[128];
+	int fd;
+
+	if (NULL == path) {
+		if ((fd = uart_pty_create(name, sizeof(name))) < 0)
+			return 1;
+		path = name;
+	} else if ((fd = open(path, O_RDWR | O_NOCTTY)) < 0) {
+		printf("uart_pty_open -> FAILED to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	return uart_pty_adopt(uart, fd, path, line);
+}
+
+const char * uart_pty_name(unsigned uart) {
+	return uarts[uart].name;
+}
+
+void uart_pty_close(unsigned uart) {
+	if (uarts[uart].fd >= 0)
+		close(uarts[uart].fd);
+	uarts[uart].fd = -1;
+}
+
+void uart_pty_update() {
+	uint64_t now = now_us();
+	unsigned i;
+
+	for (i = 0; i < UART_PTY_UARTS; ++i)
+		uart_update(&uarts[i], now);
+}
+
+int uart_pty_irq(unsigned uart) {
+	Uart_t * u = &uarts[uart];
+
+	if (u->fd < 0)
+		return 0;
+	uart_update(u, now_us());
+	return !(iir_value(u, now_us()) & IIR_NPI);
+}
+
+const UartPtyStats_t * uart_pty_get_stats(unsigned uart) {
+	return &uarts[uart].stats;
+}
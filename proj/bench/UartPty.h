@@ -0,0 +1,107 @@
+#ifndef __UART_PTY_H
+#define __UART_PTY_H
+
+/** @defgroup UartPty UartPty
+ * @{
+ * Stand-in for the 16550s at COM1_PORT and COM2_PORT, behind port_inb() and port_outb(),
+ * whose lines are Linux pseudo-terminals: two processes, each with a UartPty on an end of
+ * the same pty, talk as two machines on a null-modem cable. With both UARTs, processes
+ * cable COM2 of each to COM1 of the next, in a ring.
+ *
+ * The registers behave as the 16550's do (RBR/THR, IER, IIR/FCR, LCR, MCR, LSR, MSR, SR,
+ * the divisor latch, and both 16 byte FIFOs), in time: a byte takes 10 bit times to
+ * leave at the rate of the divisor, then the latency of the line to arrive. The pty
+ * carries each byte with the rate it was sent at and when it was written to THR, so a
+ * byte sent at another rate than the receiver's arrives garbled, with a framing error.
+ *
+ * There are no interrupts: uart_pty_irq() tells when the UART would raise one, for the
+ * caller to run the interrupt handler.
+ */
+
+#include <stdint.h>
+
+#define UART_PTY_UARTS	2	/**< @brief UARTs emulated: SERIAL_COM1, then SERIAL_COM2 */
+
+/**
+ * @brief The line between both ends
+ */
+typedef struct {
+	unsigned long latency_us;	///> Time a byte takes to arrive, after its last bit is sent
+	unsigned long max_rate;		///> Fastest rate the line carries, faster bytes arrive garbled. 0 for any
+	unsigned error_ppm;			///> Bytes in a million received with a bit flipped and a framing error
+	unsigned noise_ppm;			///> Bytes in a million received with a bit flipped, and no error seen
+	uint32_t seed;				///> Seed of the bytes chosen to go wrong
+} UartPtyConf_t;
+
+/**
+ * @brief Counters of the emulated UART
+ */
+typedef struct {
+	unsigned long tx_bytes;		///> Bytes sent on the line
+	unsigned long rx_bytes;		///> Bytes arrived from the line
+	unsigned long garbled;		///> Bytes arrived at a rate other than the receiver's, or too fast for the line
+	unsigned long errors;		///> Bytes arrived with an error injected, flagged or not
+	unsigned long overruns;		///> Bytes lost to a full receive FIFO
+	unsigned long read;			///> Bytes read from RBR
+	uint64_t latency_us;		///> Sum of the times from THR on one end to RBR on the other
+	unsigned long max_latency_us;	///> Longest of them
+} UartPtyStats_t;
+
+/**
+ * @brief Opens an end of the line, and resets the UART as at power up
+ *
+ * @param uart SERIAL_COM1 or SERIAL_COM2
+ * @param path Pseudo-terminal of the other end, NULL to create the pty and be its master
+ * @param conf Line to emulate, copied
+ *
+ * @return 0 on success, non-zero otherwise
+ */
+int uart_pty_open(unsigned uart, const char * path, const UartPtyConf_t * conf);
+
+/**
+ * @brief Creates a pty without a UART on it yet, to hand to uart_pty_adopt() (after a fork)
+ *
+ * @param name Where to store the path of the other end
+ * @param size Bytes of name
+ *
+ * @return The master end, negative on failure
+ */
+int uart_pty_create(char * name, unsigned size);
+
+/**
+ * @brief Opens an end of the line on a pty already open, as uart_pty_open()
+ *
+ * @param fd End of the pty, closed with the UART
+ * @param name Path the other end opens
+ */
+int uart_pty_adopt(unsigned uart, int fd, const char * name,
+		const UartPtyConf_t * conf);
+
+/**
+ * @brief Path the other end must open, once uart_pty_open() created the pty
+ */
+const char * uart_pty_name(unsigned uart);
+
+/**
+ * @brief Closes the line
+ */
+void uart_pty_close(unsigned uart);
+
+/**
+ * @brief Runs the UARTs up to now: sends the bytes whose time came, and takes the ones arrived
+ */
+void uart_pty_update();
+
+/**
+ * @brief Whether a UART raises an interrupt (IIR has one pending). Never for one not open
+ */
+int uart_pty_irq(unsigned uart);
+
+/**
+ * @brief Gets the counters of a UART
+ */
+const UartPtyStats_t * uart_pty_get_stats(unsigned uart);
+
+/**@}*/
+
+#endif /* __UART_PTY_H */
@@ -0,0 +1,639 @@
+/*
+ * Frame-throughput benchmark: runs the game headless, as fast as possible.
+ *
+ * usage: bench_sim [-w size,period[,growth]] [-f shots,max] [-m max_enemies] [-c file.csv] [-l n] [-o file | -p file] [-k] [-n lag | -s file | -S file] [frames] [seed]
+ *
+ * Spawns follow the game's own schedule, seeded by seed. Shots follow a script
+ * with a separate generator, so both are the same from run to run.
+ *
+ * -w plays the stress scenario instead: waves of size enemy missiles every period frames,
+ * each wave growth missiles bigger than the last, with invulnerable bases.
+ * -f sets how many friendly missiles are fired automatically per frame, and how many may be alive.
+ * -m caps the enemy missiles alive.
+ * -c writes the time and entity counts of every frame to a CSV file.
+ * -l loses one in every n mouse bytes, counting the packets the parser drops and resyncs.
+ * -o records the session to a replay file. -p plays one back instead of the script, as fast
+ * as possible and with the recorded seed, until it ends, then checks it ended the same.
+ * -k saves the game to a snapshot and restores it after every game frame, which must not
+ * change how the game goes.
+ * -n plays multiplayer instead, against a scripted peer whose input arrives lag steps late.
+ * The rollbacks must make the game go the same whatever the lag.
+ * -s plays multiplayer as the end being watched, writing the steps it sends to a file, and
+ * reports how many bytes they take against the bit rates of the serial port. -S watches
+ * the game in that file, until its end, which must end as the game played.
+ *
+ * Built as bench_link (BENCH_LINK), multiplayer goes through the protocol and the serial
+ * driver instead, to a 16550 emulated on a pseudo-terminal (UartPty), in real time:
+ *
+ * usage: bench_link [-w ...] [-f ...] [-m ...] [-c file.csv] [-l n] [-k] -u new|pair|pty | -r nodes[,rate] [-L latency_us[,max_rate[,error_ppm[,noise_ppm]]]] [frames] [seed]
+ *
+ * -u new creates the pty and waits for another bench_link to join it with -u and the path
+ * it prints. -u pair plays both ends, forking the second, whose seed is seed + 1.
+ * -r plays a ring of nodes (3 or 4) at a fixed rate, 115200 bit/s by default: node i,
+ * forked by node i - 1 and with seed + i, has COM1 on the pty of node i - 1's COM2.
+ * -L sets the line: latency, fastest rate it carries, and the bytes in a million that
+ * arrive with a framing error, and silently wrong. Runs until the multiplayer game ends,
+ * which both ends must see the same.
+ *
+ * The report goes to stderr, the game's own log to stdout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include "planetary.h"
+#include "video_gr.h"
+#include "vbe.h"
+#include "Input.h"
+#include "Highscores.h"
+#include "Clock.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "Rollback.h"
+#include "Communication.h"
+#include "headless.h"
+#if BENCH_LINK
+#include <sys/wait.h>
+#include "Serial.h"
+#include "Frame.h"
+#include "UartPty.h"
+#else
+#include "headless_net.h"
+#endif
+
+#define DEFAULT_FRAMES	10000
+#define DEFAULT_SEED	1
+
+#define SHOT_PERIOD		20		/**< @brief Frames between two scripted shots */
+
+#define STRESS_FIRE			4	/**< @brief Default friendly missiles fired per frame, stress scenario */
+#define STRESS_MAX_FRIENDLY	1000	/**< @brief Default friendly missiles alive at most, stress scenario */
+#define BENCH_SNAPSHOT_MAX	8192	/**< @brief Capacity of the -k snapshot, for each kind of entity */
+
+#define PEER_SEED		7		/**< @brief Seed of the peer's shots, and of the net games */
+#define LINK_POLL_US	250		/**< @brief Time between two looks at the emulated UART, as its interrupts would come */
+#define RING_BIT_RATE	115200	/**< @brief Rate of the hops of -r, unless given */
+
+#if !BENCH_LINK
+static const unsigned long bench_rates[] = { 9600, 19200, 38400, 57600, 115200 };	// Bit rates the watched game is weighed against
+#endif
+
+static Rng_t script_rng;	// Generator of the shot script, apart from the game's streams
+static int net_on = 0;		// Playing multiplayer against the scripted peer
+#if !BENCH_LINK
+static com_mode_t net_mode = COM_MODE_ROLLBACK;	// Playing it, being watched, or watching
+#endif
+
+// Plays the part of the player: starts games, shoots, and skips the end of game animation
+static void script_input(unsigned long frame) {
+	int button_y = net_on ? MULTIP_Y : SINGLEP_Y;
+
+	switch (planetary_get_state()) {
+	case MENU:
+		headless_mouse(BUTTONS_X + BUTTONS_WIDTH / 2,
+				button_y + BUTTONS_HEIGHT / 2, BYTE0_RB);
+		headless_mouse(BUTTONS_X + BUTTONS_WIDTH / 2,
+				button_y + BUTTONS_HEIGHT / 2, 0);
+		break;
+	case GAME_MULTI:
+		if (rollback_active())
+			frame = rollback_frame(); // Shoot on the same steps, whatever the lag
+		/* no break */
+	case GAME_SINGLE:
+		if (0 == frame % SHOT_PERIOD) {
+			int x = 50 + rng_below(&script_rng, vg_getHorRes() - 100);
+			int y = 50 + rng_below(&script_rng, CANNON_POS_Y - 100);
+
+			// Alternate between the left and right cannons
+			headless_mouse(x, y,
+					(frame / SHOT_PERIOD) % 2 ? BYTE0_LB : BYTE0_RB);
+			headless_mouse(x, y, 0);
+		}
+		break;
+	case END_GAME_ANIMATION:
+		headless_key(ENTER_BREAK_CODE);
+		break;
+	case MP_END_ANIMATION:
+		headless_key(ESC_BREAK_CODE);
+		break;
+	default:
+		break;
+	}
+}
+
+#if !BENCH_LINK
+// Plays the part of the remote player of a net game: shoots in the steps between the
+// local player's shots, its input of a step arriving lag frames after it was due
+static void peer_input(unsigned lag) {
+	static Rng_t peer_rng;
+	static unsigned long next = 0, ticks = 0;
+	static NetInput_t input;
+
+	if (!rollback_active()) {
+		next = ticks = 0;
+		return;
+	}
+	if (0 == ticks++) {
+		rng_seed(&peer_rng, PEER_SEED);
+		memset(&input, 0, sizeof(input));
+	}
+
+	for (; next + lag < ticks; ++next) {
+		input.fire = 0;
+		if (SHOT_PERIOD / 2 == next % SHOT_PERIOD) {
+			input.pos[0] = 50 + rng_below(&peer_rng, vg_getHorRes() - 100);
+			input.pos[1] = 50 + rng_below(&peer_rng, CANNON_POS_Y - 100);
+			input.fire = (next / SHOT_PERIOD) % 2 ? NET_FIRE_LEFT : NET_FIRE_RIGHT;
+		}
+		rollback_remote_input(1, next, &input);
+	}
+}
+#endif
+
+// Starts from an empty leaderboard, so every run takes the same path
+static int reset_scores() {
+	remove(SCORES_PATH);
+	remove(SCORES_TXT_PATH);
+	return highscores_open(SCORES_PATH, NULL);
+}
+
+// First second of play slower than real time, and the entities alive then
+static unsigned long over_budget_frame = 0;
+static unsigned over_budget_gauges[PROF_NUM_GAUGES];
+
+// Keeps track of the time taken by the last FRAME_RATE frames
+static void check_budget(unsigned long frame, uint64_t frame_us) {
+	static uint64_t window_us = 0;
+	unsigned g;
+
+	window_us += frame_us;
+	if (0 != (frame + 1) % FRAME_RATE)
+		return;
+
+	if (0 == over_budget_frame && window_us > 1000000) {
+		over_budget_frame = frame + 1;
+		for (g = 0; g < PROF_NUM_GAUGES; ++g)
+			over_budget_gauges[g] = prof_get_value(g);
+	}
+	window_us = 0;
+}
+
+// Appends the timings of a frame to the CSV file
+static void write_csv_row(FILE * csv, unsigned long frame, uint64_t frame_us,
+		const uint64_t * section_us) {
+	unsigned s, g;
+
+	fprintf(csv, "%lu,%llu", frame, (unsigned long long) frame_us);
+	for (s = 0; s < PROF_NUM_SECTIONS; ++s)
+		fprintf(csv, ",%llu", (unsigned long long) section_us[s]);
+	for (g = 0; g < PROF_NUM_GAUGES; ++g)
+		fprintf(csv, ",%u", prof_get_value(g));
+	fprintf(csv, "\n");
+}
+
+static void write_csv_header(FILE * csv) {
+	unsigned s, g;
+
+	fprintf(csv, "frame,frame_us");
+	for (s = 0; s < PROF_NUM_SECTIONS; ++s)
+		fprintf(csv, ",%s_us", prof_section_name(s));
+	for (g = 0; g < PROF_NUM_GAUGES; ++g)
+		fprintf(csv, ",%s", prof_gauge_name(g));
+	fprintf(csv, "\n");
+}
+
+static void report(unsigned long frames, unsigned long seed, uint64_t elapsed_us) {
+	unsigned s, g, d;
+
+	fprintf(stderr, "bench_sim: %lu frames, seed %lu\n", frames, seed);
+	fprintf(stderr, "  total      %10.3f s  %10.1f frames/s\n",
+			elapsed_us / 1e6, elapsed_us ? frames * 1e6 / elapsed_us : 0.);
+
+	for (s = 0; s < PROF_NUM_SECTIONS; ++s) {
+		uint64_t total = prof_get_total_us(s);
+		fprintf(stderr, "  %-10s %10.3f s  %10.2f us/frame  (%lu calls)\n",
+				prof_section_name(s), total / 1e6, (double) total / frames,
+				prof_get_calls(s));
+	}
+
+	for (g = 0; g < PROF_NUM_GAUGES; ++g)
+		fprintf(stderr, "  peak %-18s %u\n", prof_gauge_name(g),
+				prof_get_peak(g));
+
+	for (d = 0; d < PROF_NUM_DELAYS; ++d)
+		fprintf(stderr, "  %s: %lu samples, avg %llu us, max %llu us\n",
+				prof_delay_name(d), prof_get_delay_samples(d),
+				(unsigned long long) prof_get_delay_avg_us(d),
+				(unsigned long long) prof_get_delay_max_us(d));
+	fprintf(stderr, "  input events dropped: %u\n", input_get_dropped());
+	fprintf(stderr, "  mouse packets: %lu, dropped %lu, resyncs %lu\n",
+			mouse_get_parser()->packets, mouse_get_parser()->dropped,
+			mouse_get_parser()->resyncs);
+
+	if (0 == over_budget_frame) {
+		fprintf(stderr, "  kept up with %d frames/s throughout\n", FRAME_RATE);
+	} else {
+		fprintf(stderr, "  fell below %d frames/s at frame %lu, with", FRAME_RATE,
+				over_budget_frame);
+		for (g = 0; g < PROF_NUM_GAUGES; ++g)
+			fprintf(stderr, "%s %u %s", g ? "," : "", over_budget_gauges[g],
+					prof_gauge_name(g));
+		fprintf(stderr, "\n");
+	}
+}
+
+#if !BENCH_LINK
+// Bytes a watched game took, and how far the serial port's bit rates go with them
+static void report_spectate() {
+	const SpectateStats_t * stats = planetary_get_spectate_stats();
+	unsigned long deltas = stats->steps - stats->keyframes;
+	double avg = stats->steps ? stats->bytes / (double) stats->steps : 0.;
+	double avg_delta = deltas ?
+			(stats->bytes - stats->keyframe_bytes) / (double) deltas : 0.;
+	double key_missile = stats->keyframe_missiles ?
+			stats->keyframe_missile_bits / 8. / stats->keyframe_missiles : 0.;
+	unsigned r;
+
+	fprintf(stderr, "  watched: %lu steps, %lu bytes, %.1f bytes/step (%u at most), %lu dropped\n",
+			stats->steps, stats->bytes, avg, stats->max_bytes, stats->dropped);
+	fprintf(stderr, "  watched: %.1f bytes/delta, %lu keyframes, %.1f bytes/missile in keyframes, %.1f bytes/spawn\n",
+			avg_delta, stats->keyframes, key_missile,
+			stats->spawned ? stats->spawn_bits / 8. / stats->spawned : 0.);
+
+	// A keyframe is sent whole, in the spare bytes of the steps between two
+	for (r = 0; r < sizeof(bench_rates) / sizeof(bench_rates[0]); ++r) {
+		double budget = bench_rates[r] / 10. / FRAME_RATE; // 8N1: 10 bits a byte
+		double missiles = key_missile > 0. ?
+				(budget - avg_delta) * SPECTATE_KEYFRAME / key_missile : 0.;
+
+		if (key_missile > 0. && missiles > COM_DELTA_MAX / key_missile)
+			missiles = COM_DELTA_MAX / key_missile;
+		fprintf(stderr, "  %6lu bit/s: %5.1f bytes/step, %5.1f%% used, ~%.0f missiles\n",
+				bench_rates[r], budget, 100. * avg / budget,
+				missiles > 0. ? missiles : 0.);
+	}
+}
+#endif
+
+#if BENCH_LINK
+// Services the UARTs, as their interrupts would, until a time comes
+static void link_wait(uint64_t until_us) {
+	do {
+		if (uart_pty_irq(SERIAL_COM1) || uart_pty_irq(SERIAL_COM2))
+			serial_handler();
+		if (now_us() >= until_us)
+			break;
+		usleep(LINK_POLL_US);
+	} while (1);
+}
+
+// How the lines went, on this end
+static void report_link(unsigned end, unsigned long up_frame, uint64_t elapsed_us) {
+	const RollbackStats_t * stats = rollback_get_stats();
+	const SessionStats_t * session = com_get_stats();
+	unsigned port;
+
+	fprintf(stderr, "  link: end %u, player %u, %lu bit/s, up at frame %lu\n", end,
+			com_get_player(), serial_get_rate(SERIAL_COM1), up_frame);
+	fprintf(stderr, "  session: up in %lu us, rtt %lu us (+-%lu, %lu samples), rto %lu us, %lu sent again, %lu timeouts, %lu rates failed\n",
+			session->handshake_us, session->srtt_us, session->rttvar_us,
+			session->rtt_samples, session->rto_us, session->resent,
+			session->timeouts, session->failures);
+	for (port = 0; port < com_ports(); ++port) {
+		const UartPtyStats_t * uart = uart_pty_get_stats(port);
+		const SerialStats_t * serial = serial_get_stats(port);
+		const FrameStats_t * frames = frame_get_stats(port);
+
+		fprintf(stderr, "  uart COM%u: sent %lu bytes, received %lu (%lu garbled, %lu with errors, %lu overruns), latency avg %.0f us, max %lu us\n",
+				port + 1, uart->tx_bytes, uart->rx_bytes, uart->garbled,
+				uart->errors, uart->overruns,
+				uart->read ? (double) uart->latency_us / uart->read : 0.,
+				uart->max_latency_us);
+		fprintf(stderr, "  serial COM%u: %lu line errors, %lu bytes dropped\n",
+				port + 1, serial->line_errors, serial->rx_dropped + serial->tx_dropped);
+		fprintf(stderr, "  frames COM%u: sent %lu (%lu again), received %lu (%lu twice, %lu bad), dropped %lu\n",
+				port + 1, frames->sent, frames->retransmitted, frames->received,
+				frames->duplicates, frames->bad, frames->dropped);
+	}
+	if (com_ports() > 1 && 0 != elapsed_us) {
+		// What the hop downstream carried, and what the inputs of every step need, against what it can
+		const RingStats_t * ring = com_get_ring_stats();
+		double hop = serial_get_stats(SERIAL_COM2)->tx_bytes * 1e6 / elapsed_us;
+		unsigned long need = ring->hop_bytes * FRAME_RATE;
+		unsigned player;
+
+		fprintf(stderr, "  ring: %lu inputs passed on, inputs of each player:",
+				ring->forwarded);
+		for (player = 0; player < rollback_players(); ++player)
+			fprintf(stderr, " %lu", ring->inputs[player]);
+		fprintf(stderr, "\n  ring: %.0f bytes/s downstream of %lu (%.1f%%), the inputs need %lu: %s\n",
+				hop, ring->hop_capacity, 100. * hop / ring->hop_capacity, need,
+				need > ring->hop_capacity ? "NOT sustained, over the rate"
+						: stats->stalls ? "fits the rate, stalled" : "sustained");
+	}
+	fprintf(stderr, "  net: %lu steps, %lu rollbacks, %lu steps simulated again (%u at most), %lu stalls\n",
+			stats->frames, stats->rollbacks, stats->resimulated,
+			stats->max_depth, stats->stalls);
+}
+
+#define BENCH_OPTS	"w:f:m:c:l:o:p:ku:r:L:"
+#define BENCH_USAGE	"[-w size,period[,growth]] [-f shots,max] [-m max_enemies] [-c file.csv] [-l n] [-k] -u new|pair|pty | -r nodes[,rate] [-L latency_us[,max_rate[,error_ppm[,noise_ppm]]]] [frames] [seed]"
+#else
+#define BENCH_OPTS	"w:f:m:c:l:o:p:kn:s:S:"
+#define BENCH_USAGE	"[-w size,period[,growth]] [-f shots,max] [-m max_enemies] [-c file.csv] [-l n] [-o file | -p file] [-k] [-n lag | -s file | -S file] [frames] [seed]"
+#endif
+
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s " BENCH_USAGE "\n", name);
+}
+
+int main(int argc, char * argv[]) {
+	unsigned long frames = DEFAULT_FRAMES, seed = DEFAULT_SEED, frame;
+	Stress_t stress = { 0, 0, 0, 0, STRESS_FIRE, STRESS_MAX_FRIENDLY, 1 };
+	int stress_on = 0, opt;
+	FILE * csv = NULL;
+	const char * record_path = NULL, * play_path = NULL;
+	ReplayCheck_t check;
+	Snapshot * snap = NULL;
+#if BENCH_LINK
+	const char * link_path = NULL;
+	UartPtyConf_t line = { 0, 0, 0, 0, 0 };
+	unsigned end = 0;			// 1 on the end forked by -u pair, the node in a ring
+	unsigned ring_nodes = 0;
+	unsigned long ring_rate = RING_BIT_RATE;
+	unsigned long up_frame = 0;	// Frame the net game started in
+	pid_t peer = -1;
+#else
+	unsigned net_lag = 0;
+#endif
+
+	while (-1 != (opt = getopt(argc, argv, BENCH_OPTS))) {
+		switch (opt) {
+		case 'w':
+			if (sscanf(optarg, "%u,%u,%u", &stress.wave_size,
+					&stress.wave_period, &stress.wave_growth) < 2
+					|| 0 == stress.wave_period) {
+				usage(argv[0]);
+				return 1;
+			}
+			stress_on = 1;
+			break;
+		case 'f':
+			if (2 != sscanf(optarg, "%u,%u", &stress.auto_fire,
+					&stress.max_friendly)) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'm':
+			stress.max_enemies = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			record_path = optarg;
+			break;
+		case 'p':
+			play_path = optarg;
+			frames = ULONG_MAX;
+			break;
+		case 'k':
+			snap = new_snapshot(BENCH_SNAPSHOT_MAX, BENCH_SNAPSHOT_MAX,
+					BENCH_SNAPSHOT_MAX);
+			if (NULL == snap)
+				return 1;
+			break;
+#if BENCH_LINK
+		case 'u':
+			link_path = optarg;
+			net_on = 1;
+			break;
+		case 'r':
+			if (sscanf(optarg, "%u,%lu", &ring_nodes, &ring_rate) < 1
+					|| ring_nodes < 3 || ring_nodes > NET_PLAYERS) {
+				usage(argv[0]);
+				return 1;
+			}
+			link_path = "ring";
+			net_on = 1;
+			break;
+		case 'L':
+			if (sscanf(optarg, "%lu,%lu,%u,%u", &line.latency_us, &line.max_rate,
+					&line.error_ppm, &line.noise_ppm) < 1) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+#else
+		case 'n':
+			net_lag = strtoul(optarg, NULL, 10);
+			net_on = 1;
+			headless_net_peer(PEER_SEED);
+			break;
+		case 's':
+		case 'S':
+			net_mode = 's' == opt ? COM_MODE_HOST : COM_MODE_WATCH;
+			if (OK != headless_net_spectate(net_mode, optarg, PEER_SEED))
+				return 1;
+			net_on = 1;
+			if (COM_MODE_WATCH == net_mode)
+				frames = ULONG_MAX;
+			break;
+#endif
+		case 'l':
+			headless_mouse_loss(strtoul(optarg, NULL, 10));
+			break;
+		case 'c':
+			if (NULL == (csv = fopen(optarg, "w"))) {
+				fprintf(stderr, "bench_sim -> FAILED to open %s\n", optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc)
+		frames = strtoul(argv[optind++], NULL, 10);
+	if (optind < argc)
+		seed = strtoul(argv[optind++], NULL, 10);
+
+#if BENCH_LINK
+	if (NULL == link_path) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	line.seed = seed;
+	if (ring_nodes) {
+		// Every pty first, then each node forks the next: they report from the last one on
+		char names[NET_PLAYERS][128];
+		int masters[NET_PLAYERS];
+		unsigned node;
+
+		for (node = 0; node < ring_nodes; ++node)
+			if ((masters[node] = uart_pty_create(names[node], sizeof(names[node]))) < 0)
+				return 1;
+		while (end + 1 < ring_nodes && 0 == (peer = fork())) {
+			++end;
+			line.seed = ++seed;
+		}
+		if (peer < 0 && end + 1 < ring_nodes) {
+			fprintf(stderr, "bench_link -> FAILED to fork node %u\n", end + 1);
+			return 1;
+		}
+
+		for (node = 0; node < ring_nodes; ++node)
+			if (node != end)
+				close(masters[node]);
+		if (OK != uart_pty_adopt(SERIAL_COM2, masters[end], names[end], &line)
+				|| OK != uart_pty_open(SERIAL_COM1,
+						names[(end + ring_nodes - 1) % ring_nodes], &line)
+				|| OK != planetary_set_ring(ring_nodes, end, ring_rate))
+			return 1;
+	} else {
+		// Both ends of -u pair start from the pty the first one creates
+		if (OK != uart_pty_open(SERIAL_COM1, strcmp(link_path, "new")
+				&& strcmp(link_path, "pair") ? link_path : NULL, &line))
+			return 1;
+		if (0 == strcmp(link_path, "new"))
+			fprintf(stderr, "bench_link: the other end is %s\n",
+					uart_pty_name(SERIAL_COM1));
+		if (0 == strcmp(link_path, "pair") && 0 == (peer = fork())) {
+			char path[128];
+
+			strncpy(path, uart_pty_name(SERIAL_COM1), sizeof(path) - 1);
+			path[sizeof(path) - 1] = '\0';
+			uart_pty_close(SERIAL_COM1);
+			end = 1;
+			line.seed = ++seed;
+			if (OK != uart_pty_open(SERIAL_COM1, path, &line))
+				return 1;
+		}
+	}
+	if (OK != serial_set_conf(SERIAL_COM1)
+			|| (ring_nodes && OK != serial_set_conf(SERIAL_COM2)))
+		return 1;
+#endif
+
+	if (NULL != record_path && OK != replay_record(record_path, seed))
+		return 1;
+	if (NULL != play_path && OK != replay_play(play_path, &seed))
+		return 1;
+
+	rng_seed_streams(seed);
+	rng_seed(&script_rng, ~(uint64_t) seed);
+
+	if (OK != vg_init(MODE_800X600_64k)) {
+		fprintf(stderr, "bench_sim -> FAILED vg_init()\n");
+		return 1;
+	}
+	if (OK != reset_scores()) {
+		fprintf(stderr, "bench_sim -> FAILED to reset %s\n", SCORES_PATH);
+		return 1;
+	}
+	if (NULL == BMPsHolder()->game_background) {
+		fprintf(stderr, "bench_sim -> FAILED to load the bitmaps in %s\n",
+				RES_PATH);
+		return 1;
+	}
+
+	planetary_set_render_rate(FRAME_RATE);
+	planetary_set_stress(stress_on ? &stress : NULL);
+	prof_reset();
+
+	if (NULL != csv)
+		write_csv_header(csv);
+
+	uint64_t start = now_us();
+	for (frame = 0; frame < frames; ++frame) {
+		uint64_t section_us[PROF_NUM_SECTIONS];
+		unsigned s;
+
+		for (s = 0; s < PROF_NUM_SECTIONS; ++s)
+			section_us[s] = prof_get_total_us(s);
+
+		// The stress scenario shoots by itself, only the menu needs the script
+		if (REPLAY_PLAYING != replay_mode()
+				&& (!stress_on || GAME_SINGLE != planetary_get_state()))
+			script_input(frame);
+#if BENCH_LINK
+		link_wait(start + frame * SIM_DT_US);
+		if (0 == up_frame && rollback_active())
+			up_frame = frame;
+#else
+		if (net_on)
+			peer_input(net_lag);
+#endif
+
+		uint64_t frame_start = now_us();
+		if (OK != timer_handler())
+			break;
+#if BENCH_LINK
+		if (MP_END_ANIMATION == planetary_get_state())
+			break;
+#else
+		if (COM_MODE_WATCH == net_mode && headless_net_stream_end())
+			break;
+#endif
+		buffer_handler();
+		input_presented();
+		if (NULL != snap && OK == snapshot_save(snap)
+				&& OK != snapshot_restore(snap)) {
+			fprintf(stderr, "bench_sim -> FAILED to restore frame %lu\n", frame);
+			break;
+		}
+		uint64_t frame_us = now_us() - frame_start;
+
+		check_budget(frame, frame_us);
+		if (NULL != csv) {
+			for (s = 0; s < PROF_NUM_SECTIONS; ++s)
+				section_us[s] = prof_get_total_us(s) - section_us[s];
+			write_csv_row(csv, frame, frame_us, section_us);
+		}
+	}
+	uint64_t elapsed = now_us() - start;
+
+#if BENCH_LINK
+	if (peer > 0)
+		waitpid(peer, NULL, 0); // Reports one end after the other
+	report(frame, seed, elapsed);
+	report_link(end, up_frame, elapsed);
+	uart_pty_close(SERIAL_COM1);
+	uart_pty_close(SERIAL_COM2);
+#else
+	report(frame, seed, elapsed);
+	if (COM_MODE_HOST == net_mode) {
+		report_spectate();
+	} else if (net_on && COM_MODE_ROLLBACK == net_mode) {
+		const RollbackStats_t * stats = rollback_get_stats();
+		fprintf(stderr, "  net: %lu steps, %lu rollbacks, %lu steps simulated again (%u at most), %lu stalls\n",
+				stats->frames, stats->rollbacks, stats->resimulated,
+				stats->max_depth, stats->stalls);
+		fprintf(stderr, "  net: sent %lu bytes, %.0f bytes/s\n",
+				headless_net_bytes(),
+				frame ? headless_net_bytes() * (double) FRAME_RATE / frame : 0.);
+	}
+#endif
+
+	planetary_get_check(&check);
+	fprintf(stderr, "  final: %lu frames, score %lu, %lu enemy missiles, %lu friendly missiles, %lu explosions\n",
+			(unsigned long) check.frames, (unsigned long) check.score,
+			(unsigned long) check.e_missiles, (unsigned long) check.f_missiles,
+			(unsigned long) check.explosions);
+	if (OK != replay_stop(&check)) {
+		fprintf(stderr, "bench_sim -> replay FAILED\n");
+		return 1;
+	}
+
+	if (OK != highscores_flush())
+		fprintf(stderr, "bench_sim -> FAILED to write %s\n", SCORES_PATH);
+
+	if (NULL != csv)
+		fclose(csv);
+	if (NULL != snap)
+		delete_snapshot(snap);
+	vg_exit();
+	return 0;
+}
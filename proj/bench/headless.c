@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "headless.h"
+#include "Input.h"
+#include "video_gr.h"
+#include "RTC.h"
+#include "Clock.h"
+
+#define MAX_DELTA	255		// Largest movement a packet holds, without overflow
+
+/** Keyboard **/
+
+static unsigned char next_scancode = 0;
+
+int keyboard_read(void) {
+	return next_scancode;
+}
+
+void headless_key(unsigned char scancode) {
+	next_scancode = scancode;
+	keyboard_handler();
+}
+
+/** Mouse **/
+
+static MouseParser_t parser = { PARSER_BYTE0, PACKET_NELEMENTS, { 0 }, { 0 }, 1, 0,
+		0, 0 };
+static unsigned loss_period = 0;	// Lose one byte in every loss_period, 0 for none
+static unsigned long bytes_sent = 0;
+
+const MouseParser_t * mouse_get_parser(void) {
+	return &parser;
+}
+
+void headless_mouse_loss(unsigned period) {
+	mouse_parser_init(&parser, PACKET_NELEMENTS);
+	loss_period = period;
+}
+
+// Sends a packet to the handler byte by byte, through the same parser as the mouse interrupts
+static void send_packet(const unsigned char * bytes) {
+	MousePacket_t packet;
+	unsigned i;
+
+	for (i = 0; i < PACKET_NELEMENTS; ++i) {
+		if (0 != loss_period && 0 == ++bytes_sent % loss_period)
+			continue;
+		if (mouse_parser_feed(&parser, bytes[i], now_us(), &packet))
+			mouse_packet_handler(&packet);
+	}
+}
+
+static int clamp_delta(int delta) {
+	if (delta > MAX_DELTA)
+		return MAX_DELTA;
+	if (delta < -MAX_DELTA)
+		return -MAX_DELTA;
+	return delta;
+}
+
+void headless_mouse(int x, int y, unsigned char buttons) {
+	static int cursor[2] = { -1, -1 }; // Where the sent packets leave the cursor
+	unsigned char packet[PACKET_NELEMENTS];
+
+	if (cursor[0] < 0)
+		memcpy(cursor, get_mouse_pos(), sizeof(cursor));
+
+	// Positions off the screen are never reached
+	x = x < 0 ? 0 : (x >= (int) vg_getHorRes() ? (int) vg_getHorRes() - 1 : x);
+	y = y < 0 ? 0 : (y >= (int) vg_getVerRes() ? (int) vg_getVerRes() - 1 : y);
+
+	do {
+		int dx = clamp_delta(x - cursor[0]);
+		int dy = clamp_delta(cursor[1] - y); // PS/2 y grows upwards
+
+		packet[0] = BYTE0_SYNC_BIT | buttons;
+		if (dx < 0)
+			packet[0] |= BYTE0_X_SIGN;
+		if (dy < 0)
+			packet[0] |= BYTE0_Y_SIGN;
+		packet[1] = (unsigned char) dx;
+		packet[2] = (unsigned char) dy;
+
+		send_packet(packet);
+		cursor[0] += dx;
+		cursor[1] -= dy;
+	} while (cursor[0] != x || cursor[1] != y);
+}
+
+/** RTC **/
+
+void rtc_read_date(Date_t * date) {
+	time_t now = time(NULL);
+	struct tm * local = localtime(&now);
+
+	date->minute = local->tm_min;
+	date->hour = local->tm_hour;
+	date->day = local->tm_mday;
+	date->month = local->tm_mon + 1;
+	date->year = local->tm_year - 100;
+}
@@ -0,0 +1,41 @@
+#ifndef __HEADLESS_H
+#define __HEADLESS_H
+
+/** @defgroup Headless Headless
+ * @{
+ * Stand-ins for the devices the game talks to, so its logic runs as a plain Linux process.
+ *
+ * Keyboard and mouse input go through the same handlers the interrupts would call,
+ * and the RTC reads the system clock. The serial port is either left out for a scripted
+ * peer (headless_net.h), or emulated (UartPty.h).
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief Feeds a byte to the keyboard handler, as if the KBC had received it
+ *
+ * @param scancode Byte to feed. Two-byte codes must be fed one byte at a time
+ */
+void headless_key(unsigned char scancode);
+
+/**
+ * @brief Moves the mouse to a position, through PS/2 packets
+ *
+ * @param x Position to move to, in the horizontal axis
+ * @param y Position to move to, in the vertical axis
+ * @param buttons Buttons held (BYTE0_LB, BYTE0_RB, BYTE0_MB)
+ */
+void headless_mouse(int x, int y, unsigned char buttons);
+
+/**
+ * @brief Makes the mouse lose bytes, to exercise the packet parser's recovery.
+ * Resets the parser counters
+ *
+ * @param period Lose one byte in every period bytes sent, 0 to lose none
+ */
+void headless_mouse_loss(unsigned period);
+
+/**@}*/
+
+#endif /* __HEADLESS_H */
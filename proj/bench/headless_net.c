@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include "headless_net.h"
+#include "Serial.h"
+#include "Communication.h"
+#include "Frame.h"
+
+#define WATCH_ARRIVED	16	// Steps of a watched game received and not read, at most
+
+/** Serial Port -- connected to a peer only if asked to **/
+
+static serial_state_t comState = NONE;
+static int peer_on = 0;
+static uint32_t peer_seed = 0;
+static unsigned long bytes_sent_peer = 0;
+
+// Watched games: the steps go to a file on the playing end, and come from it on the other
+static com_mode_t peer_mode = COM_MODE_ROLLBACK;
+static FILE * stream = NULL;
+static int stream_end = 0;
+static unsigned char arrived[WATCH_ARRIVED][COM_DELTA_MAX];	// Steps received, not read yet
+static unsigned arrived_len[WATCH_ARRIVED];
+static unsigned arrived_head = 0, arrived_count = 0;
+
+void headless_net_peer(uint32_t seed) {
+	peer_on = 1;
+	peer_seed = seed;
+}
+
+int headless_net_spectate(com_mode_t mode, const char * path, uint32_t seed) {
+	if (NULL == (stream = fopen(path, COM_MODE_HOST == mode ? "wb" : "rb"))) {
+		printf("headless_net_spectate -> FAILED to open %s\n", path);
+		return 1;
+	}
+	headless_net_peer(seed);
+	peer_mode = mode;
+	return OK;
+}
+
+int headless_net_stream_end() {
+	return stream_end && 0 == arrived_count;
+}
+
+unsigned long headless_net_bytes() {
+	return bytes_sent_peer;
+}
+
+int serial_enable_interrupts(unsigned port) {
+	return OK;
+}
+
+int serial_disable_interrupts(unsigned port) {
+	return OK;
+}
+
+int serial_read(unsigned port, unsigned char * byte, unsigned char * errors) {
+	return 1;
+}
+
+unsigned serial_tx_free(unsigned port) {
+	return SERIAL_RING_SIZE;
+}
+
+int serial_write(unsigned port, unsigned char info) {
+	++bytes_sent_peer;
+	return OK;
+}
+
+void setComState(serial_state_t state) {
+	comState = state;
+	if (MP_WAITING == state && peer_on) { // The peer answers at once
+		comState = MP_ONGOING;
+		if (COM_MODE_ROLLBACK == peer_mode)
+			rollback_start(0, 2);
+	}
+}
+
+// A step of the file arrives every frame, as fast as the playing end sends them
+void com_update() {
+	unsigned char len[2];
+	unsigned slot = (arrived_head + arrived_count) % WATCH_ARRIVED;
+
+	if (COM_MODE_WATCH != peer_mode || stream_end || WATCH_ARRIVED == arrived_count)
+		return;
+
+	if (2 != fread(len, 1, 2, stream)
+			|| (arrived_len[slot] = len[0] | (len[1] << 8)) > COM_DELTA_MAX
+			|| arrived_len[slot] != fread(arrived[slot], 1, arrived_len[slot], stream)) {
+		stream_end = 1;
+		return;
+	}
+	++arrived_count;
+}
+
+void com_set_watch(int watch) {
+}
+
+com_mode_t com_get_mode() {
+	return peer_mode;
+}
+
+int com_send_delta(const unsigned char * step, unsigned len) {
+	unsigned char prefix[2] = { len & 0xFF, len >> 8 };
+
+	if (len > COM_DELTA_MAX || NULL == stream)
+		return 1;
+	fwrite(prefix, 1, 2, stream);
+	fwrite(step, 1, len, stream);
+	bytes_sent_peer += COM_DELTA_WIRE(len);
+	return OK;
+}
+
+int com_read_delta(unsigned char * step) {
+	unsigned len;
+
+	if (0 == arrived_count)
+		return 0;
+	len = arrived_len[arrived_head];
+	memcpy(step, arrived[arrived_head], len);
+	arrived_head = (arrived_head + 1) % WATCH_ARRIVED;
+	--arrived_count;
+	return len;
+}
+
+unsigned com_delta_queued() {
+	return arrived_count;
+}
+
+serial_state_t getComState() {
+	return comState;
+}
+
+void com_send_input(unsigned long frame, const NetInput_t * input) {
+	bytes_sent_peer += FRAME_OVERHEAD + MP_INPUT_LEN;
+}
+
+unsigned com_get_player() {
+	return 0;
+}
+
+unsigned com_ports() {
+	return 1;
+}
+
+int com_set_ring(unsigned nodes, unsigned index, unsigned long rate) {
+	return nodes ? 1 : OK; // The scripted peer is a single end
+}
+
+int com_ring_sustains(unsigned steps_per_s) {
+	return 1;
+}
+
+uint32_t com_get_seed() {
+	return peer_seed;
+}
@@ -0,0 +1,46 @@
+#ifndef __HEADLESS_NET_H
+#define __HEADLESS_NET_H
+
+/** @defgroup HeadlessNet HeadlessNet
+ * @{
+ * Stand-ins for the serial port and the multiplayer protocol: multiplayer only connects
+ * to a scripted peer, whose input and steps never go through a line.
+ */
+
+#include <stdint.h>
+#include "Communication.h"
+
+/**
+ * @brief Makes multiplayer connect at once, as player 0, instead of waiting forever.
+ * The peer's input must then be given to rollback_remote_input()
+ *
+ * @param seed Seed of the multiplayer games
+ */
+void headless_net_peer(uint32_t seed);
+
+/**
+ * @brief Makes multiplayer connect at once to watch a game, or to be watched, instead of
+ * playing a net game. The playing end writes the steps it sends to a file, which the
+ * watching end reads one step per frame
+ *
+ * @param mode COM_MODE_HOST to play, COM_MODE_WATCH to watch
+ * @param path File of the steps
+ * @param seed Seed of the multiplayer games
+ *
+ * @return 0 on success, non-zero if the file can't be opened
+ */
+int headless_net_spectate(com_mode_t mode, const char * path, uint32_t seed);
+
+/**
+ * @brief Whether the watching end has read every step of the file
+ */
+int headless_net_stream_end();
+
+/**
+ * @brief Bytes sent to the peer so far
+ */
+unsigned long headless_net_bytes();
+
+/**@}*/
+
+#endif /* __HEADLESS_NET_H */
@@ -1,4 +1,5 @@
 #include "BMPsHolder.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -7,13 +8,13 @@ static BMPsHolder_t * bmps_ptr = NULL;
 // Load sequence of bitmaps numbered [00, num)
 Bitmap ** load_bmps(const char * base, unsigned num) {
 	Bitmap ** array = malloc(sizeof(Bitmap *) * num);
-	char * path = (char*) malloc(strlen(base) + 2 + strlen(".bmp"));
+	char * path = (char*) malloc(strlen(base) + 2 + strlen(".bmp") + 1);
 	strcpy(path, base);
 	strcat(path, "00.bmp");
 
 	unsigned i, j;
 	for (i = 0; i < num; ++i) {
-		char parsed_num[2]; // Parse unsigned int to string
+		char parsed_num[3]; // Parse unsigned int to string
 		snprintf(parsed_num, 3, "%02d", i);
 
 		for (j = 0; path[j] != 0 && parsed_num[j] != 0; ++j) {
@@ -36,42 +37,42 @@ void delete_bmps(Bitmap ** arr, unsigned num) {
 static BMPsHolder_t * new_bmps_holder() {
 	BMPsHolder_t * ptr = malloc(sizeof(BMPsHolder_t));
 
-	ptr->numbers = load_bmps("/home/planetary_defense/res/Numbers/",
+	ptr->numbers = load_bmps(RES_PATH "Numbers/",
 	NUM_NUMBERS_BMPS);
 	ptr->big_numbers = load_bmps(
-			"/home/planetary_defense/res/Numbers/big",
+			RES_PATH "Numbers/big",
 			NUM_NUMBERS_BMPS);
 	ptr->explosion = load_bmps(
-			"/home/planetary_defense/res/Explosion/",
+			RES_PATH "Explosion/",
 			NUM_EXPLOSION_BMPS);
 	ptr->buildings = load_bmps(
-			"/home/planetary_defense/res/Buildings/building",
+			RES_PATH "Buildings/building",
 			NUM_BUILDINGS_BMPS);
 
 	ptr->game_background = loadBitmap(
-			"/home/planetary_defense/res/background.bmp");
+			RES_PATH "background.bmp");
 	ptr->HS_background = loadBitmap(
-			"/home/planetary_defense/res/HSbackground.bmp");
+			RES_PATH "HSbackground.bmp");
 	ptr->heart = loadBitmap(
-			"/home/planetary_defense/res/8_bit_heart.bmp");
+			RES_PATH "8_bit_heart.bmp");
 
 	ptr->menu_background =
 			loadBitmap(
-					"/home/planetary_defense/res/InitialMenu/InitialMenu.bmp");
+					RES_PATH "InitialMenu/InitialMenu.bmp");
 	ptr->SP_button = loadBitmap(
-			"/home/planetary_defense/res/InitialMenu/SpArea.bmp");
+			RES_PATH "InitialMenu/SpArea.bmp");
 	ptr->MP_button = loadBitmap(
-			"/home/planetary_defense/res/InitialMenu/MpArea.bmp");
+			RES_PATH "InitialMenu/MpArea.bmp");
 	ptr->HS_button = loadBitmap(
-			"/home/planetary_defense/res/InitialMenu/HsArea.bmp");
+			RES_PATH "InitialMenu/HsArea.bmp");
 	ptr->highscore_text = loadBitmap(
-			"/home/planetary_defense/res/highscore_text.bmp");
+			RES_PATH "highscore_text.bmp");
 	ptr->waiting_MP = loadBitmap(
-			"/home/planetary_defense/res/waitingMP.bmp");
+			RES_PATH "waitingMP.bmp");
 	ptr->win = loadBitmap(
-			"/home/planetary_defense/res/win.bmp");
+			RES_PATH "win.bmp");
 	ptr->lost = loadBitmap(
-			"/home/planetary_defense/res/lost.bmp");
+			RES_PATH "lost.bmp");
 
 	return ptr;
 }
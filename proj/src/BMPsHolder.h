@@ -8,6 +8,10 @@
 
 #include "Bitmap.h"
 
+#ifndef RES_PATH
+#define RES_PATH			"/home/planetary_defense/res/"	/**< @brief Directory holding the game resources */
+#endif
+
 #define NUM_EXPLOSION_BMPS	16		/**< @brief Number of Bitmaps in explosion animation */
 #define NUM_BUILDINGS_BMPS	3		/**< @brief Number of Bitmaps in Buildings destruction Animation */
 #define NUM_NUMBERS_BMPS	10		/**< @brief Number of Bitmaps for the numbers graphic representation */
@@ -0,0 +1,77 @@
+#include "BitPack.h"
+
+void bitpack_init(BitPack_t * bp, unsigned char * buf, unsigned size) {
+	bp->buf = buf;
+	bp->size = size;
+	bp->bit = 0;
+	bp->overflow = 0;
+}
+
+void bitpack_put(BitPack_t * bp, uint32_t value, unsigned bits) {
+	unsigned i;
+
+	if (bp->overflow || bp->bit + bits > 8UL * bp->size) {
+		bp->overflow = 1;
+		return;
+	}
+
+	for (i = 0; i < bits; ++i, ++(bp->bit)) {
+		unsigned char mask = 1 << (bp->bit & 7);
+
+		if (0 == (bp->bit & 7))
+			bp->buf[bp->bit >> 3] = 0; // Bytes are cleared as they are reached
+		if ((value >> i) & 1)
+			bp->buf[bp->bit >> 3] |= mask;
+	}
+}
+
+void bitpack_put_varint(BitPack_t * bp, uint32_t value) {
+	while (value >= 0x80) {
+		bitpack_put(bp, (value & 0x7F) | 0x80, 8);
+		value >>= 7;
+	}
+	bitpack_put(bp, value, 8);
+}
+
+void bitpack_put_svarint(BitPack_t * bp, int32_t value) {
+	uint32_t zigzag = (uint32_t) value << 1;
+	bitpack_put_varint(bp, value < 0 ? ~zigzag : zigzag);
+}
+
+uint32_t bitpack_get(BitPack_t * bp, unsigned bits) {
+	uint32_t value = 0;
+	unsigned i;
+
+	if (bp->overflow || bp->bit + bits > 8UL * bp->size) {
+		bp->overflow = 1;
+		return 0;
+	}
+
+	for (i = 0; i < bits; ++i, ++(bp->bit))
+		if (bp->buf[bp->bit >> 3] & (1 << (bp->bit & 7)))
+			value |= (uint32_t) 1 << i;
+	return value;
+}
+
+uint32_t bitpack_get_varint(BitPack_t * bp) {
+	uint32_t value = 0, group;
+	unsigned shift = 0;
+
+	do {
+		group = bitpack_get(bp, 8);
+		if (shift < 32)
+			value |= (group & 0x7F) << shift;
+		shift += 7;
+	} while ((group & 0x80) && !bp->overflow && shift < 35);
+
+	return value;
+}
+
+int32_t bitpack_get_svarint(BitPack_t * bp) {
+	uint32_t value = bitpack_get_varint(bp);
+	return (int32_t) ((value >> 1) ^ (~(value & 1) + 1));
+}
+
+unsigned bitpack_bytes(const BitPack_t * bp) {
+	return (bp->bit + 7) >> 3;
+}
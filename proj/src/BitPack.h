@@ -0,0 +1,70 @@
+#ifndef __BITPACK_H
+#define __BITPACK_H
+
+/** @defgroup BitPack BitPack
+ * @{
+ * Reads and writes values of any width in a byte buffer, least significant bit first.
+ *
+ * Varints take 8 bits per 7 bits of value, so small numbers stay small; signed ones
+ * are zigzag encoded first, so small negative numbers do too. Running out of buffer
+ * sets overflow instead of writing, or reading, past its end.
+ */
+
+#include <stdint.h>
+
+typedef struct {
+	unsigned char * buf;
+	unsigned size;			///> Capacity of buf, in bytes
+	unsigned long bit;		///> Bits written, or read
+	int overflow;			///> Set once a value did not fit
+} BitPack_t;
+
+/**
+ * @brief Starts writing, or reading, a buffer
+ *
+ * @param bp BitPack to initialise
+ * @param buf Buffer to write to, or read from
+ * @param size Capacity of buf, in bytes
+ */
+void bitpack_init(BitPack_t * bp, unsigned char * buf, unsigned size);
+
+/**
+ * @brief Writes the low bits of a value
+ *
+ * @param bits Number of bits to write, 32 at most
+ */
+void bitpack_put(BitPack_t * bp, uint32_t value, unsigned bits);
+
+/**
+ * @brief Writes an unsigned value as a varint
+ */
+void bitpack_put_varint(BitPack_t * bp, uint32_t value);
+
+/**
+ * @brief Writes a signed value as a zigzag varint
+ */
+void bitpack_put_svarint(BitPack_t * bp, int32_t value);
+
+/**
+ * @brief Reads a value written by bitpack_put(). 0 once overflowed
+ */
+uint32_t bitpack_get(BitPack_t * bp, unsigned bits);
+
+/**
+ * @brief Reads a value written by bitpack_put_varint()
+ */
+uint32_t bitpack_get_varint(BitPack_t * bp);
+
+/**
+ * @brief Reads a value written by bitpack_put_svarint()
+ */
+int32_t bitpack_get_svarint(BitPack_t * bp);
+
+/**
+ * @brief Number of bytes the bits written so far take
+ */
+unsigned bitpack_bytes(const BitPack_t * bp);
+
+/**@}*/
+
+#endif /* __BITPACK_H */
@@ -6,6 +6,8 @@
 #include "Bitmap.h"
 
 #include "stdio.h"
+#include <stdlib.h>
+#include <string.h>
 #include "video_gr.h"
 
 Bitmap* loadBitmap(const char* filename) {
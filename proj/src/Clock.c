@@ -0,0 +1,66 @@
+#include "Clock.h"
+
+#if HEADLESS
+#include <time.h>
+
+uint64_t now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int clock_use_rtc(unsigned long hz) {
+	return 0;
+}
+
+#else
+#include <minix/syslib.h>
+#include <minix/sysutil.h>
+#include "RTC.h"
+
+static unsigned long rtc_hz = 0;	// Frequency of the RTC periods counted, 0 before clock_use_rtc()
+static uint64_t rtc_base_us = 0;	// Time when the count started
+static uint64_t last_us = 0;		// Last time told, it never goes back
+
+// Private Method -- Time by the system clock, a tick at a time
+static uint64_t uptime_us() {
+	clock_t ticks;
+	if (OK != getuptime(&ticks))
+		return 0;
+
+	return (uint64_t) ticks * 1000000 / sys_hz();
+}
+
+uint64_t now_us() {
+	uint64_t uptime = uptime_us(), rtc;
+
+	if (0 == rtc_hz)
+		return uptime;
+
+	// Both fall behind, never ahead: the RTC by the periods lost, the system clock by a tick.
+	// Polling the RTC counts the periods that end inside a handler too
+	rtc = rtc_base_us + (uint64_t) rtc_poll() * 1000000 / rtc_hz;
+	if (rtc < uptime) {
+		rtc_base_us += uptime - rtc; // Counts on from there
+		rtc = uptime;
+	}
+	if (rtc > last_us)
+		last_us = rtc;
+
+	return last_us;
+}
+
+int clock_use_rtc(unsigned long hz) {
+	uint64_t base = now_us();
+
+	if (OK != rtc_set_periodic(hz))
+		return 1;
+
+	rtc_base_us = base;
+	last_us = base;
+	rtc_hz = hz;
+	return OK;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __CLOCK_H
+#define __CLOCK_H
+
+/** @defgroup Clock Clock
+ * @{
+ * Monotonic time source, used to measure how long things take
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief Gets the current time
+ *
+ * Only differences between two readings are meaningful.
+ * Resolution depends on the backend: a microsecond on Linux (HEADLESS),
+ * a system clock tick on MINIX, or a period of the RTC once clock_use_rtc() was called.
+ *
+ * @return Microseconds elapsed since an arbitrary point in the past
+ */
+uint64_t now_us();
+
+/**
+ * @brief Tells the time with the periodic interrupt of the RTC from now on: 122 us at 8192 Hz
+ *
+ * The periods are counted as the RTC interrupts are handled (rtc_ih()), and by every
+ * now_us(), which polls the RTC (rtc_poll()), so the time moves inside a handler too.
+ * Periods that end between two readings count as one; the system clock makes up for
+ * them, and the time never goes back. Nothing to do on
+ * Linux (HEADLESS), whose clock is finer already.
+ *
+ * @param hz Frequency of the interrupt, a power of two up to RTC_PERIODIC_MAX_HZ
+ *
+ * @return 0 on success, non-zero otherwise (the system clock goes on)
+ */
+int clock_use_rtc(unsigned long hz);
+
+/**@}*/
+
+#endif /* __CLOCK_H */
@@ -1,81 +1,562 @@
 #include "Serial.h"
 #include "Communication.h"
+#include "Frame.h"
+#include "Random.h"
+#include "Clock.h"
+#include <stdio.h>
+#include <string.h>
+#if !HEADLESS
 #include <minix/syslib.h>
+#endif
 
 
-// Current state of communication
-static serial_state_t comState = NONE;
 static int flag = 0;
 static int first = 0;
 
-void serial_handler() {
-	
-	// Check type of interrupt
-	/*
-	unsigned long iir = 0;
-	sys_inb(COM1_PORT + IIR, &iir);
-	if ( iir & ~IIR_NPI ) {
-		switch ( iir & IIR_ID ) {
-		case IIR_RX:
-			printf("Serial Interrupt: Received!!\n");
-			break;
-		default:
-			printf("** RECEIVED UNINTENDED INTERRUPT ?? **\n");
-			return;
-		}
-	}*/
-	//if (comState == NONE)
+static unsigned player = 0;		// Index of this end in a multiplayer game
+static uint32_t seed = 0;		// Seed of the multiplayer game
+
+/**
+ * Session: a state machine whose transitions are all in session_table. Frames received
+ * and time passing are its events. Each state has what the game sees of it, a timeout,
+ * and what it sends until answered: again after the retransmission timeout (RTO), then
+ * after twice as long each time.
+ *
+ * The link comes up as: the end announcing itself (MP_WAITING) is answered by an end
+ * already waiting, which becomes player 0 and sends the seed and its fastest rate
+ * (hello). Player 1 chooses the fastest rate both have (MP_RATE), then both switch to it
+ * once their bytes left. Player 0 tells it is ready (MP_READY), player 1 sends the test
+ * pattern, player 0 echoes it if it arrived intact and without line errors, and player 1
+ * acknowledges the echo. A failure or a timeout takes both ends back to SERIAL_BIT_RATE,
+ * to start over with a slower rate at most.
+ *
+ * MP_WAITING carries when it was sent, and the hello echoes it; MP_PING and MP_PONG do the
+ * same while playing. The round trip times they give are smoothed as TCP does, into the
+ * RTO. An end not heard from for SESSION_DEAD_US while playing is gone.
+ *
+ * A ring (com_set_ring()) skips the handshake: every node is at the configured rate, and
+ * passes what comes on COM1 (upstream) on to COM2 (downstream). The leader, node 0, sends
+ * the seed around (MP_RING) until it comes back, then tells everyone to start (MP_GO).
+ * Each input goes around once, and stops at the node before its player.
+ */
+typedef enum {
+	SES_IDLE,		// Out of multiplayer
+	SES_CONNECT,	// Announcing this end, no one answered yet
+	SES_OFFERED,	// Player 0 answered, waits for MP_RATE
+	SES_SWITCH,		// Waits for the bytes sent to leave, to change rate
+	SES_TEST,		// At the new rate, testing it
+	SES_RING,		// In a ring, the seed goes around it
+	SES_GAME,		// Playing
+	SES_LEFT,		// This end left the game, MP_ENDED is sent until the other end has it
+	SES_ENDED,		// The other end left the game
+	SES_LOST,		// The other end stopped answering
+	NUM_SESSION,
+	SES_SAME = NUM_SESSION	// In session_table: the event changes nothing
+} session_t;
+
+typedef enum {
+	EV_START,		// This end waits for another
+	EV_ANNOUNCED,	// The other end announced itself, this one answered
+	EV_HELLO,		// The other end answered, this one is player 1
+	EV_RATE,		// Player 1 chose the rate
+	EV_DRAINED,		// The bytes sent at the old rate left
+	EV_TESTED,		// The new rate works
+	EV_FAILED,		// It does not
+	EV_LEAVE,		// This end leaves
+	EV_BYE,			// The other end left the game
+	EV_DELIVERED,	// The other end has every reliable frame
+	EV_TIMEOUT,		// The time of the state is up
+	EV_STOP,		// The game is done with multiplayer
+	EV_RING,		// This end waits for the others of a ring
+	EV_CLOSED,		// The seed went around the ring
+	NUM_EVENTS
+} session_event_t;
+
+typedef struct {
+	const char * name;
+	serial_state_t com;			// State the game sees
+	unsigned long timeout_us;	// Time in the state before EV_TIMEOUT, 0 for none
+	int quiet;					// The timeout counts from the last frame from the other end
+	void (*enter)(session_t from);	// Done on entering the state, NULL for nothing
+	void (*resend)();			// Done again while in the state, NULL for nothing
+	unsigned long resend_us;	// Time between two, 0 for the RTO doubled each time
+	session_t next[NUM_EVENTS];	// State each event leads to
+} SessionRow_t;
+
+static void connect_enter(session_t from);
+static void offered_enter(session_t from);
+static void switch_enter(session_t from);
+static void test_enter(session_t from);
+static void ring_enter(session_t from);
+static void game_enter(session_t from);
+static void left_enter(session_t from);
+static void gone_enter(session_t from);
+static void send_waiting();
+static void send_hello();
+static void send_test();
+static void send_ring();
+static void send_ping();
+
+#define STAY	SES_SAME
+static const SessionRow_t session_table[NUM_SESSION] = {
+	/*                                                                                              START        ANNOUNCED    HELLO       RATE        DRAINED   TESTED    FAILED       LEAVE     BYE        DELIVERED  TIMEOUT      STOP      RING      CLOSED */
+	{ "idle",    NONE,       0,                  0, NULL,          NULL,         0,               { SES_CONNECT, STAY,        STAY,       STAY,       STAY,     STAY,     STAY,        STAY,     STAY,      STAY,      STAY,        STAY,     SES_RING, STAY } },
+	{ "connect", MP_WAITING, SESSION_CONNECT_US, 0, connect_enter, send_waiting, 0,               { STAY,        SES_OFFERED, SES_SWITCH, STAY,       STAY,     STAY,     STAY,        SES_IDLE, STAY,      STAY,      SES_IDLE,    SES_IDLE, STAY,     STAY } },
+	{ "offered", MP_WAITING, SESSION_LINK_US,    0, offered_enter, send_hello,   0,               { STAY,        STAY,        SES_SWITCH, SES_SWITCH, STAY,     STAY,     STAY,        SES_IDLE, STAY,      STAY,      SES_CONNECT, SES_IDLE, STAY,     STAY } },
+	{ "switch",  MP_WAITING, SESSION_LINK_US,    0, switch_enter,  NULL,         0,               { STAY,        STAY,        STAY,       STAY,       SES_TEST, STAY,     STAY,        SES_IDLE, STAY,      STAY,      SES_CONNECT, SES_IDLE, STAY,     STAY } },
+	{ "test",    MP_WAITING, SESSION_LINK_US,    0, test_enter,    send_test,    0,               { STAY,        STAY,        STAY,       STAY,       STAY,     SES_GAME, SES_CONNECT, SES_IDLE, STAY,      STAY,      SES_CONNECT, SES_IDLE, STAY,     STAY } },
+	{ "ring",    MP_WAITING, SESSION_CONNECT_US, 0, ring_enter,    send_ring,    0,               { STAY,        STAY,        STAY,       STAY,       STAY,     STAY,     STAY,        SES_IDLE, STAY,      STAY,      SES_IDLE,    SES_IDLE, STAY,     SES_GAME } },
+	{ "game",    MP_ONGOING, SESSION_DEAD_US,    1, game_enter,    send_ping,    SESSION_PING_US, { STAY,        STAY,        STAY,       STAY,       STAY,     STAY,     STAY,        SES_LEFT, SES_ENDED, STAY,      SES_LOST,    SES_IDLE, STAY,     STAY } },
+	{ "left",    MP_ENDED,   SESSION_DEAD_US,    1, left_enter,    NULL,         0,               { STAY,        STAY,        STAY,       STAY,       STAY,     STAY,     STAY,        STAY,     STAY,      SES_IDLE,  SES_IDLE,    SES_IDLE, STAY,     STAY } },
+	{ "ended",   MP_ENDED,   0,                  0, gone_enter,    NULL,         0,               { STAY,        STAY,        STAY,       STAY,       STAY,     STAY,     STAY,        STAY,     STAY,      STAY,      STAY,        SES_IDLE, STAY,     STAY } },
+	{ "lost",    MP_ENDED,   0,                  0, gone_enter,    NULL,         0,               { STAY,        STAY,        STAY,       STAY,       STAY,     STAY,     STAY,        STAY,     STAY,      STAY,      STAY,        SES_IDLE, STAY,     STAY } }
+};
+#undef STAY
+
+static session_t session = SES_IDLE;
+static uint64_t entered_us = 0;		// When the session entered its state
+static uint64_t heard_us = 0;		// When a frame from the other end last arrived
+static uint64_t resend_at_us = 0;	// When the state sends again
+static unsigned long resend_gap_us = 0;	// Time until the next one after that
+static uint64_t left_connect_us = 0;	// When the last handshake started
+static SessionStats_t stats = { 0, 0, 0, SESSION_RTO_INIT_US, 0, 0, 0, 0 };
+
+static const unsigned long rates[] = { 1200, 2400, 4800, 9600, 19200, 38400,
+		57600, 115200 };
+#define NUM_RATES	(sizeof(rates) / sizeof(rates[0]))
+
+static const unsigned char test_pattern[MP_TEST_LEN] = { 0x55, 0xAA, 0x00,
+		0xFF, 0x0F, 0xF0, 0x33, 0xCC, 0x01, 0x80, 0x7E, 0x81, 0x12, 0x34, 0x56,
+		0x78 };
+
+static unsigned link_rate = 0;		// Index of the rate agreed
+static unsigned rate_cap = 0;		// Index of the fastest rate still worth trying
+static unsigned long link_errors = 0;	// Line errors counted when the test was last sent
+static int test_seen = 0;			// Player 0 had the pattern, or player 1 had MP_READY
+static unsigned char hello[MP_HELLO_LEN];	// Answer of player 0, sent until MP_RATE arrives
+
+// A ring of nodes: COM1 from the one before, COM2 to the one after. 0 nodes for two ends on COM1
+static unsigned ring_nodes = 0;
+static unsigned ring_index = 0;		// This node, the leader is 0
+static unsigned ring_rate = 0;		// Index of the rate of every hop
+static unsigned out_link = SERIAL_COM1;	// Link the game sends on: COM1, or downstream in a ring
+static RingStats_t ring_stats;
+
+static int watch_wanted = 0;				// This end asks to watch
+static com_mode_t mode = COM_MODE_ROLLBACK;	// Agreed in the handshake
+
+// Steps of a watched game: the one being received, and the ones received in full
+static unsigned char delta_buf[COM_DELTA_MAX];
+static unsigned delta_len = 0;
+static unsigned char delta_ring[COM_DELTA_RING];	// Each step: length (u16), bytes
+static unsigned delta_head = 0;		// Bytes ever pushed
+static unsigned delta_tail = 0;		// Bytes ever popped
+static unsigned delta_count = 0;	// Steps in the ring
+static int delta_lost = 0;			// Steps were dropped since the last one read
+
+// Private Method -- Index of the fastest rate this end offers
+static unsigned max_rate() {
+	unsigned idx = NUM_RATES - 1;
+	while (idx > 0 && rates[idx] > SERIAL_MAX_BIT_RATE)
+		--idx;
+	return idx;
+}
+
+// Private Method -- Writes a little endian u32
+static void put_u32(unsigned char * msg, uint32_t value) {
+	unsigned i;
+	for (i = 0; i < 4; ++i)
+		msg[i] = (value >> (8 * i)) & 0xFF;
+}
+
+// Private Method -- Reads a little endian u32
+static uint32_t get_u32(const unsigned char * msg) {
+	return msg[0] | (msg[1] << 8) | (msg[2] << 16) | ((uint32_t) msg[3] << 24);
+}
+
+// Private Method -- Takes the round trip time of a stamp echoed
+static void rtt_sample(uint32_t stamp) {
+	unsigned long rtt = (uint32_t) now_us() - stamp, err, rto;
+
+	if (0 == stats.rtt_samples++) {
+		stats.srtt_us = rtt;
+		stats.rttvar_us = rtt / 2;
+	} else {
+		err = rtt > stats.srtt_us ? rtt - stats.srtt_us : stats.srtt_us - rtt;
+		stats.rttvar_us = (3 * stats.rttvar_us + err) / 4;
+		stats.srtt_us = (7 * stats.srtt_us + rtt) / 8;
+	}
+
+	rto = stats.srtt_us + 4 * stats.rttvar_us;
+	if (rto < SESSION_RTO_MIN_US)
+		rto = SESSION_RTO_MIN_US;
+	else if (rto > SESSION_RTO_MAX_US)
+		rto = SESSION_RTO_MAX_US;
+	stats.rto_us = rto;
+}
+
+// Private Method -- Sends a frame with when it was sent, and what it answers if anything
+static void send_stamped(unsigned link, unsigned char type,
+		const unsigned char * echo) {
+	unsigned char msg[MP_STAMP_LEN];
+
+	put_u32(msg, (uint32_t) now_us());
+	if (NULL != echo)
+		memcpy(msg, echo, MP_STAMP_LEN);
+	frame_send(link, type, msg, MP_STAMP_LEN);
+}
+
+// Private Method -- Whether a frame of a player, come from upstream, goes on around the ring
+static int ring_passes_on(unsigned origin) {
+	return (ring_index + 1) % ring_nodes != origin;
+}
+
+// Private Method -- Moves the session with an event, by session_table
+static void session_fire(session_event_t event) {
+	session_t from = session, next = session_table[session].next[event];
+	uint64_t now = now_us();
+
+	if (SES_SAME == next)
+		return;
+
+	printf("Session: %s -> %s\n", session_table[session].name,
+			session_table[next].name);
+	if (SES_CONNECT == session && SES_IDLE != next)
+		left_connect_us = now;
+	if (EV_TIMEOUT == event)
+		++stats.timeouts;
+
+	session = next;
+	entered_us = heard_us = now;
+	resend_gap_us = session_table[next].resend_us ?
+			session_table[next].resend_us : stats.rto_us;
+	resend_at_us = now + resend_gap_us;
+	if (NULL != session_table[next].enter)
+		session_table[next].enter(from);
+}
+
+// Private Method -- Both ends start slow, and after a rate failed, start over with a slower one
+static void connect_enter(session_t from) {
+	if (SES_IDLE != from) {
+		printf("Link at %lu bit/s failed, starting over\n", rates[link_rate]);
+		rate_cap = link_rate > 0 ? link_rate - 1 : 0;
+		++stats.failures;
+	}
+	link_rate = rate_cap;
+	serial_set_rate(out_link, SERIAL_BIT_RATE);
+	frame_reset(out_link);
+	test_seen = 0;
+	send_waiting();
+}
+
+static void offered_enter(session_t from) {
+	send_hello();
+}
 
-	unsigned long iir = 0;
-	unsigned char proceed = 0;
+// Private Method -- Player 1 tells the rate chosen
+static void switch_enter(session_t from) {
+	unsigned char chosen[MP_RATE_LEN];
 
-	sys_inb(COM1_PORT + IIR, &iir);
+	if (1 != player)
+		return;
+	chosen[0] = link_rate;
+	chosen[1] = watch_wanted ? COM_FLAG_WATCH : 0;
+	frame_send(out_link, MP_RATE, chosen, MP_RATE_LEN);
+}
+
+static void test_enter(session_t from) {
+	serial_set_rate(out_link, rates[link_rate]);
+	frame_reset(out_link); // Reliable frames are numbered from the new rate on
+	stats.rtt_samples = 0; // Times at the old rate say little of the new one
+	test_seen = 0;
+	send_test();
+}
+
+// Private Method -- Every hop at the configured rate, numbered from 0. The leader picks the seed
+static void ring_enter(session_t from) {
+	unsigned link;
+
+	left_connect_us = now_us(); // No handshake, the ring comes up from here
+	link_rate = ring_rate;
+	player = ring_index;
+	mode = COM_MODE_ROLLBACK;
+	for (link = 0; link < FRAME_LINKS; ++link) {
+		serial_set_rate(link, rates[ring_rate]);
+		frame_reset(link);
+	}
+	memset(ring_stats.inputs, 0, sizeof(ring_stats.inputs));
+	ring_stats.forwarded = 0;
+
+	if (0 == ring_index) {
+		seed = rng_next(rng_stream(RNG_COSMETIC));
+		send_ring();
+	}
+}
+
+// Private Method -- The rate works, the game starts
+static void game_enter(session_t from) {
+	if (ring_nodes)
+		printf("Ring of %u up at %lu bit/s, player %u\n", ring_nodes,
+				rates[link_rate], player);
+	else
+		printf("Link up at %lu bit/s, player %u, mode %d\n", rates[link_rate],
+				player, (int) mode);
+
+	stats.handshake_us = now_us() - left_connect_us;
+	delta_len = 0;
+	delta_head = delta_tail = delta_count = 0;
+	delta_lost = 0;
+	if (COM_MODE_ROLLBACK == mode)
+		rollback_start(player, ring_nodes ? ring_nodes : 2);
+}
+
+// Private Method -- The end of the game, until the other end has it
+static void left_enter(session_t from) {
+	unsigned char origin = player;
+	frame_send_reliable(out_link, MP_ENDED, &origin, MP_ENDED_LEN);
+}
+
+static void gone_enter(session_t from) {
+	printf("The other end %s\n", SES_LOST == session ? "stopped answering" : "left");
+
+	// The ring is broken: the nodes downstream end too, without waiting for their timeout
+	if (ring_nodes && SES_LOST == session && ring_passes_on(player)) {
+		unsigned char origin = player;
+		frame_send_reliable(out_link, MP_ENDED, &origin, MP_ENDED_LEN);
+	}
+}
+
+static void send_waiting() {
+	send_stamped(out_link, MP_WAITING, NULL);
+}
 
-	if ( iir & IIR_NPI ) {
+static void send_hello() {
+	frame_send(out_link, MP_ONGOING, hello, MP_HELLO_LEN);
+}
+
+// Private Method -- The leader sends the seed around, until it comes back
+static void send_ring() {
+	unsigned char msg[MP_RING_LEN];
+
+	if (0 != ring_index)
+		return;
+	put_u32(msg, seed);
+	msg[4] = ring_nodes;
+	msg[5] = 0; // Hops made
+	put_u32(msg + 6, (uint32_t) now_us());
+	frame_send(SERIAL_COM2, MP_RING, msg, MP_RING_LEN);
+}
 
-		//This should not happen
-		printf("Serial Handler Interrupt error: No pending interrupts!\n");
+// Private Method -- Player 0 tells it is ready until the pattern arrives, then player 1 sends it until echoed
+static void send_test() {
+	if (0 == player && !test_seen)
+		frame_send(out_link, MP_READY, NULL, 0);
+	else if (1 == player && test_seen)
+		frame_send(out_link, MP_TEST, test_pattern, MP_TEST_LEN);
+	else
 		return;
 
+	// Errors from before, bytes that arrived at the other rate, are no fault of the new one
+	link_errors = serial_get_stats(out_link)->line_errors;
+}
+
+static void send_ping() {
+	send_stamped(out_link, MP_PING, NULL);
+}
+
+// Private Method -- How the game is shared, from the flags of both ends
+static com_mode_t agree_mode(int local_watch, int remote_watch, unsigned local) {
+	if (local_watch && remote_watch) // Both ask, player 1 watches
+		return 1 == local ? COM_MODE_WATCH : COM_MODE_HOST;
+	if (local_watch)
+		return COM_MODE_WATCH;
+	if (remote_watch)
+		return COM_MODE_HOST;
+	return COM_MODE_ROLLBACK;
+}
+
+// Private Method -- Keeps a chunk of a step of a watched game
+static void delta_chunk(const unsigned char * msg, unsigned len) {
+	unsigned i;
+
+	if (delta_len + len - 1 > COM_DELTA_MAX) { // Drops the rest of the step too
+		delta_len = msg[0] ? 0 : COM_DELTA_MAX + 1;
+		delta_lost = 1;
+		return;
+	}
+	memcpy(delta_buf + delta_len, msg + 1, len - 1);
+	delta_len += len - 1;
+	if (!msg[0])
+		return; // More chunks to come
+
+	if (COM_DELTA_RING - (delta_head - delta_tail) < 2 + delta_len) {
+		delta_lost = 1; // Not read fast enough
 	} else {
+		delta_ring[delta_head++ % COM_DELTA_RING] = delta_len & 0xFF;
+		delta_ring[delta_head++ % COM_DELTA_RING] = delta_len >> 8;
+		for (i = 0; i < delta_len; ++i)
+			delta_ring[delta_head++ % COM_DELTA_RING] = delta_buf[i];
+		++delta_count;
+	}
+	delta_len = 0;
+}
+
+// Private Method -- Handles a game input, passing it on around a ring
+static void com_input(const unsigned char * msg) {
+	unsigned origin = msg[7];
+	NetInput_t input;
+	uint16_t wire = msg[0] | (msg[1] << 8);
+	unsigned long base = rollback_frame();
+
+	// Only the low 16 bits of the step are sent, it is close to the local one
+	unsigned long frame = base + (int16_t) (wire - (uint16_t) base);
+
+	input.pos[0] = (int16_t) (msg[2] | (msg[3] << 8));
+	input.pos[1] = (int16_t) (msg[4] | (msg[5] << 8));
+	input.fire = msg[6];
+	if (origin >= NET_PLAYERS)
+		return;
+	rollback_remote_input(origin, frame, &input);
+	++ring_stats.inputs[origin];
 
-		if ( (iir & IIR_LSR) == IIR_LSR) {
-			unsigned long error;
-			sys_inb(COM1_PORT + LSR, &error);
-			printf("RECEIVED ERROR INTERRUPT. It was: 0x%x.\n", (unsigned char) error & 0xff);
+	if (ring_nodes && ring_passes_on(origin)) {
+		if (OK == frame_send_reliable(SERIAL_COM2, MP_INPUT, msg, MP_INPUT_LEN))
+			++ring_stats.forwarded;
+		else
+			printf("com_input -> FAILED to pass step %lu of player %u on\n",
+					frame, origin);
+	}
+}
+
+// Private Method -- Handles the frames of a ring coming up, all from upstream
+static void session_ring_frame(unsigned char type, const unsigned char * msg,
+		unsigned len) {
+	if ( MP_RING == type && MP_RING_LEN == len && ring_nodes == msg[4] ) {
+		unsigned char hops = msg[5];
+
+		if (0 == ring_index && ring_nodes - 1 == hops && get_u32(msg) == seed) {
+			// Back around: every node has the seed and is listening, start them
+			rtt_sample(get_u32(msg + 6));
+			frame_send_reliable(SERIAL_COM2, MP_GO, msg, MP_GO_LEN);
+			session_fire(EV_CLOSED);
+		} else if (0 != ring_index && ring_index == hops + 1) {
+			unsigned char next[MP_RING_LEN];
+
+			memcpy(next, msg, MP_RING_LEN);
+			next[5] = hops + 1;
+			frame_send(SERIAL_COM2, MP_RING, next, MP_RING_LEN);
 		}
+	} else if ( MP_GO == type && MP_GO_LEN == len && 0 != ring_index ) {
+		seed = get_u32(msg);
+		if (ring_passes_on(0))
+			frame_send_reliable(SERIAL_COM2, MP_GO, msg, MP_GO_LEN);
+		session_fire(EV_CLOSED);
+	} else {
+		printf("*serial handler-NOT cool* ");
+	}
+}
+
+// Private Method -- When both ends answered, whether the other end stays player 0: the larger
+// seed wins, then the larger stamp of the announcements answered
+static int hello_wins(const unsigned char * msg) {
+	uint32_t remote = get_u32(msg);
+
+	if (remote != seed)
+		return remote > seed;
+	return get_u32(hello + 6) > get_u32(msg + 6);
+}
 
-		if ( (iir & IIR_RX) == IIR_RX) {
-			proceed = 1;
-			printf("Serial Interrupt: Received!!\n");
+// Private Method -- Handles the frames of the link coming up
+static void session_link_frame(unsigned char type, const unsigned char * msg,
+		unsigned len) {
+	if ( MP_WAITING == type && MP_STAMP_LEN == len
+			&& (SES_CONNECT == session || SES_OFFERED == session) ) {
+		// Answer at once: be player 0, choose the seed and offer the rates
+		if (SES_CONNECT == session) {
+			seed = rng_next(rng_stream(RNG_COSMETIC));
+			player = 0;
+			put_u32(hello, seed);
+			hello[4] = rate_cap;
+			hello[5] = watch_wanted ? COM_FLAG_WATCH : 0;
 		}
+		memcpy(hello + 6, msg, MP_STAMP_LEN);
+		if (SES_CONNECT == session)
+			session_fire(EV_ANNOUNCED);
+		else
+			send_hello(); // Announced again, the answer was lost
+	} else if ( MP_ONGOING == type && MP_HELLO_LEN == len
+			&& (SES_CONNECT == session || (SES_OFFERED == session && hello_wins(msg))) ) {
+		// Seed and rates of the other end, player 0
+		seed = get_u32(msg);
+		player = 1;
+		link_rate = msg[4] < rate_cap ? msg[4] : rate_cap;
+		mode = agree_mode(watch_wanted, msg[5] & COM_FLAG_WATCH, player);
+		rtt_sample(get_u32(msg + 6));
+		session_fire(EV_HELLO);
+	} else if ( MP_ONGOING == type && MP_HELLO_LEN == len && SES_OFFERED == session ) {
+		// Both answered, and this end stays player 0: the other one gives in
+	} else if ( MP_RATE == type && MP_RATE_LEN == len && SES_OFFERED == session ) {
+		link_rate = msg[0] < rate_cap ? msg[0] : rate_cap;
+		mode = agree_mode(watch_wanted, msg[1] & COM_FLAG_WATCH, player);
+		session_fire(EV_RATE);
+	} else if ( MP_READY == type && SES_TEST == session && 1 == player ) {
+		test_seen = 1;
+		send_test();
+	} else if ( MP_TEST == type && MP_TEST_LEN == len && SES_TEST == session ) {
+		if (0 != memcmp(msg, test_pattern, MP_TEST_LEN)
+				|| serial_get_stats(out_link)->line_errors != link_errors) {
+			session_fire(EV_FAILED);
+		} else if (0 == player) {
+			test_seen = 1;
+			frame_send(out_link, MP_TEST, msg, MP_TEST_LEN); // Echo, player 1 acknowledges it
+		} else {
+			// The first reliable frame: sent until player 0 has it
+			frame_send_reliable(out_link, MP_ACK, NULL, 0);
+			session_fire(EV_TESTED);
+		}
+	} else if ( MP_ACK == type && SES_TEST == session && 0 == player ) {
+		session_fire(EV_TESTED);
+	} else {
+		printf("*serial handler-NOT cool* ");
 	}
+}
 
-	if (!proceed)
-		return;
+// Private Method -- Handles a frame received from the other end, or the node upstream
+static void com_frame(unsigned link, unsigned char type,
+		const unsigned char * msg, unsigned len) {
+	if (MP_INPUT != type && MP_DELTA != type && MP_PING != type && MP_PONG != type)
+		printf("-SH- Session: %s. Received: %x.\n", session_table[session].name, type);
 
-	unsigned char received = serial_read();
+	// Announcements of an end starting over say nothing of the game. In a ring, only what
+	// comes from upstream tells it is whole: the node downstream answers pings all the same
+	if (MP_WAITING != type && SERIAL_COM1 == link)
+		heard_us = now_us();
 
-	printf("-SH- State: %x. Received: %x.\n", (int) comState, received);
+	if ( MP_PING == type && MP_STAMP_LEN == len ) {
+		if (SES_IDLE != session)
+			send_stamped(link, MP_PONG, msg);
+		return;
+	} else if ( MP_PONG == type && MP_STAMP_LEN == len ) {
+		rtt_sample(get_u32(msg));
+		return;
+	}
 
-	switch (comState) {
+	switch (session_table[session].com) {
 	case MP_WAITING:
-		if ( MP_WAITING == received ) {
-			serial_write(MP_ONGOING);
-			comState = MP_ONGOING;
-		} else if ( MP_ONGOING == received ) {
-			serial_write(MP_ACK);
-			comState = MP_ONGOING;
-		} else {
-			printf("*serial handler-NOT cool* ");
-		}
+		if (ring_nodes)
+			session_ring_frame(type, msg, len);
+		else
+			session_link_frame(type, msg, len);
 		break;
 	case MP_ONGOING:
-		if ( MP_ENDED == received ) {
-			serial_write(MP_ACK);
-			comState = MP_ENDED;
-		} else if ( MP_ACK == received ) {
-			printf("*serial handler-COOL* ");
+		if ( MP_ENDED == type ) {
+			if (ring_nodes && MP_ENDED_LEN == len && ring_passes_on(msg[0]))
+				frame_send_reliable(SERIAL_COM2, MP_ENDED, msg, MP_ENDED_LEN);
+			session_fire(EV_BYE);
+		} else if ( MP_INPUT == type && MP_INPUT_LEN == len ) {
+			com_input(msg);
+		} else if ( MP_DELTA == type && len > 1 ) {
+			delta_chunk(msg, len);
 		} else {
 			printf("*serial handler-NOT cool?* ");
 		}
@@ -91,18 +572,200 @@ void serial_handler() {
 		}
 }
 
+void serial_handler() {
+	unsigned char received, errors;
+	unsigned port;
+
+	// Drain the UARTs to the rings, then handle everything they received
+	for (port = 0; port < com_ports(); ++port) {
+		serial_irq_handler(port);
+		while (OK == serial_read(port, &received, &errors))
+			frame_receive(port, received, 0 != errors);
+	}
+}
+
+void com_update() {
+	const SessionRow_t * row = &session_table[session];
+	uint64_t now = now_us(), since;
+	unsigned link;
+
+	if (SES_IDLE == session)
+		return;
+	for (link = 0; link < com_ports(); ++link)
+		frame_update(link);
+
+	if (SES_SWITCH == session && serial_tx_drained(out_link))
+		session_fire(EV_DRAINED);
+	else if (SES_LEFT == session && 0 == frame_pending(out_link))
+		session_fire(EV_DELIVERED);
+	if (row != &session_table[session])
+		return; // Time in the new state starts now
+
+	since = row->quiet ? heard_us : entered_us;
+	if (row->timeout_us && now - since >= row->timeout_us) {
+		session_fire(EV_TIMEOUT);
+	} else if (NULL != row->resend && now >= resend_at_us) {
+		row->resend();
+		++stats.resent;
+		if (0 == row->resend_us) // Backs off
+			resend_gap_us = 2 * resend_gap_us < SESSION_RETRY_MAX_US ?
+					2 * resend_gap_us : SESSION_RETRY_MAX_US;
+		resend_at_us = now + resend_gap_us;
+	}
+}
+
 void setComState(serial_state_t state) {
 	printf("SetComState called. State: %x.\n", (char) state);
 
-	// appropriately write to serial on state change
-	comState = state;
-	serial_write((char)state);
+	switch (state) {
+	case MP_WAITING:
+		rate_cap = max_rate();
+		frame_attach(com_frame);
+		session_fire(EV_STOP); // Whatever was going on
+		session_fire(ring_nodes ? EV_RING : EV_START);
+		break;
+	case MP_ENDED:
+		session_fire(EV_LEAVE);
+		break;
+	case NONE:
+		session_fire(EV_STOP);
+		break;
+	default:
+		break;
+	}
 }
 
 serial_state_t getComState() {
-	return comState;
+	return session_table[session].com;
+}
+
+const SessionStats_t * com_get_stats() {
+	return &stats;
+}
+
+int com_set_ring(unsigned nodes, unsigned index, unsigned long rate) {
+	unsigned idx;
+
+	if (0 == nodes) {
+		ring_nodes = 0;
+		out_link = SERIAL_COM1;
+		return OK;
+	}
+
+	for (idx = 0; idx < NUM_RATES && rates[idx] != rate; ++idx)
+		;
+	if (nodes < 3 || nodes > NET_PLAYERS || index >= nodes || NUM_RATES == idx) {
+		printf("com_set_ring -> FAILED node %u of %u at %lu bit/s\n", index,
+				nodes, rate);
+		return 1;
+	}
+
+	ring_nodes = nodes;
+	ring_index = index;
+	ring_rate = idx;
+	out_link = SERIAL_COM2;
+	return OK;
+}
+
+unsigned com_ports() {
+	return ring_nodes ? SERIAL_PORTS : 1;
+}
+
+int com_ring_sustains(unsigned steps_per_s) {
+	unsigned long need, capacity;
+
+	if (0 == ring_nodes)
+		return 1;
+
+	// Each hop carries the inputs of every player but the one downstream, and the pings
+	ring_stats.hop_bytes = (ring_nodes - 1) * (FRAME_OVERHEAD + MP_INPUT_LEN);
+	need = ring_stats.hop_bytes * steps_per_s
+			+ (FRAME_OVERHEAD + MP_STAMP_LEN) * (1000000 / SESSION_PING_US);
+	capacity = rates[ring_rate] / 10; // 8N1: 10 bits a byte
+	ring_stats.hop_capacity = capacity;
+
+	printf("Ring of %u at %lu bit/s: %lu bytes/s a hop of %lu (%lu%%), %s %u steps/s\n",
+			ring_nodes, rates[ring_rate], need, capacity, 100 * need / capacity,
+			need <= capacity ? "sustains" : "does NOT sustain", steps_per_s);
+	return need <= capacity;
+}
+
+const RingStats_t * com_get_ring_stats() {
+	return &ring_stats;
 }
 
 int getflag() {
 	return flag;
 }
+
+void com_send_input(unsigned long frame, const NetInput_t * input) {
+	unsigned char msg[MP_INPUT_LEN];
+
+	msg[0] = frame & 0xFF;
+	msg[1] = (frame >> 8) & 0xFF;
+	msg[2] = input->pos[0] & 0xFF;
+	msg[3] = (input->pos[0] >> 8) & 0xFF;
+	msg[4] = input->pos[1] & 0xFF;
+	msg[5] = (input->pos[1] >> 8) & 0xFF;
+	msg[6] = input->fire;
+	msg[7] = player;
+	if (OK != frame_send_reliable(out_link, MP_INPUT, msg, MP_INPUT_LEN))
+		printf("com_send_input -> FAILED to queue step %lu\n", frame);
+}
+
+unsigned com_get_player() {
+	return player;
+}
+
+uint32_t com_get_seed() {
+	return seed;
+}
+
+void com_set_watch(int watch) {
+	watch_wanted = watch;
+}
+
+com_mode_t com_get_mode() {
+	return mode;
+}
+
+int com_send_delta(const unsigned char * step, unsigned len) {
+	unsigned char chunk[FRAME_MAX_PAYLOAD];
+	unsigned chunks = (len + COM_DELTA_CHUNK - 1) / COM_DELTA_CHUNK, sent = 0;
+
+	if (0 == len || len > COM_DELTA_MAX || FRAME_QUEUE - frame_pending(out_link) < chunks)
+		return 1;
+
+	while (sent < len) {
+		unsigned size = len - sent < COM_DELTA_CHUNK ? len - sent : COM_DELTA_CHUNK;
+
+		chunk[0] = (sent + size == len); // Last chunk
+		memcpy(chunk + 1, step + sent, size);
+		if (OK != frame_send_reliable(out_link, MP_DELTA, chunk, size + 1))
+			return 1;
+		sent += size;
+	}
+	return OK;
+}
+
+int com_read_delta(unsigned char * step) {
+	unsigned len, i;
+
+	if (delta_lost) {
+		delta_lost = 0;
+		return -1;
+	}
+	if (0 == delta_count)
+		return 0;
+
+	len = delta_ring[delta_tail++ % COM_DELTA_RING];
+	len |= delta_ring[delta_tail++ % COM_DELTA_RING] << 8;
+	for (i = 0; i < len; ++i)
+		step[i] = delta_ring[delta_tail++ % COM_DELTA_RING];
+	--delta_count;
+	return len;
+}
+
+unsigned com_delta_queued() {
+	return delta_count;
+}
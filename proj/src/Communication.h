@@ -1,33 +1,115 @@
 #ifndef __COMMUNICATION_H
 #define __COMMUNICATION_H
 
+#include <stdint.h>
 #include "Serial.h"
+#include "Frame.h"
+#include "Rollback.h"
 
 /** @defgroup Input Input
  * @{
  * Functions for manipulating all the Inputs from the user/ player
  */
 
-/* Codes for communication between Computers */
+/* Codes for communication between Computers, sent as the types of Frames */
 /*
 #define MP_WAITING		0x01
 #define MP_ONGOING		0x02
 #define	MP_ENDED		0x03
 */
 static const char MP_ACK = 0x06; // 0xFF;
+static const char MP_INPUT = 0x10; // Step (u16), x, y (i16), fire (u8) and player (u8)
+static const char MP_RATE = 0x11; // Index of the rate chosen (u8)
+static const char MP_TEST = 0x12; // The test pattern
+static const char MP_DELTA = 0x13; // Last chunk flag (u8), then a chunk of a step of a watched game
+static const char MP_READY = 0x14; // Player 0 is at the new rate, for the test pattern
+static const char MP_PING = 0x15; // When it was sent (u32, us)
+static const char MP_PONG = 0x16; // The MP_PING answered, echoed
+static const char MP_RING = 0x17; // Seed (u32), nodes (u8), hops made (u8), when the leader sent it (u32)
+static const char MP_GO = 0x18; // Seed (u32): the ring is closed, the game starts
+
+#define MP_INPUT_LEN	8	/**< @brief Payload of MP_INPUT */
+#define MP_ENDED_LEN	1	/**< @brief Payload of MP_ENDED: the player who left */
+#define MP_RING_LEN		10	/**< @brief Payload of MP_RING */
+#define MP_GO_LEN		4	/**< @brief Payload of MP_GO */
+#define MP_STAMP_LEN	4	/**< @brief Payload of MP_WAITING, MP_PING and MP_PONG: when the first two were sent (u32, us) */
+#define MP_HELLO_LEN	10	/**< @brief Payload of the MP_ONGOING that answers MP_WAITING: seed (u32), fastest rate index (u8), flags (u8), the MP_WAITING echoed */
+#define MP_RATE_LEN		2	/**< @brief Payload of MP_RATE: rate index (u8), flags (u8) */
+#define MP_TEST_LEN		16	/**< @brief Payload of MP_TEST */
+
+#define SESSION_CONNECT_US	60000000	/**< @brief Time waiting for another end before giving up */
+#define SESSION_LINK_US		1500000		/**< @brief Time each step of the link coming up has, before the rate is given up */
+#define SESSION_DEAD_US		2000000		/**< @brief Time without a frame from the other end before it is gone, while playing */
+#define SESSION_PING_US		500000		/**< @brief Time between two MP_PING, while playing */
+#define SESSION_RTO_INIT_US	500000		/**< @brief Retransmission timeout before a round trip was measured */
+#define SESSION_RTO_MIN_US	50000		/**< @brief Shortest retransmission timeout */
+#define SESSION_RTO_MAX_US	1000000		/**< @brief Longest retransmission timeout */
+#define SESSION_RETRY_MAX_US	2000000		/**< @brief Longest time between two retries, backing off */
+
+#define COM_FLAG_WATCH	0x01	/**< @brief Handshake flag: this end wants to watch the other one play */
+
+#define COM_DELTA_MAX	2048	/**< @brief Largest step of a watched game */
+#define COM_DELTA_RING	8192	/**< @brief Bytes of steps received and not read yet, at most */
+#define COM_DELTA_CHUNK	(FRAME_MAX_PAYLOAD - 1)	/**< @brief Bytes of a step in each MP_DELTA */
+
+/** @brief Bytes a step of len bytes takes on the wire */
+#define COM_DELTA_WIRE(len)	((len) + ((len) + COM_DELTA_CHUNK - 1) / COM_DELTA_CHUNK * (FRAME_OVERHEAD + 1))
 
 
 typedef enum {
 	EXCLUDE, MP_WAITING, MP_ONGOING, MP_ENDED, NONE
 } serial_state_t;
 
+/**
+ * @brief How the two ends share a multiplayer game
+ */
+typedef enum {
+	COM_MODE_ROLLBACK,	///> Both play, each simulating the game (Rollback)
+	COM_MODE_HOST,		///> This end plays, and sends each step to the other end
+	COM_MODE_WATCH		///> The other end plays, this one shows the steps it sends
+} com_mode_t;
+
+/**
+ * @brief Counters of the session, and round trip times
+ */
+typedef struct {
+	unsigned long handshake_us;	///> Time the link last took to come up, from the first answer
+	unsigned long srtt_us;		///> Smoothed round trip time
+	unsigned long rttvar_us;	///> Its mean deviation
+	unsigned long rto_us;		///> Retransmission timeout: time before sending again what was not answered
+	unsigned long rtt_samples;	///> Round trips measured, since the rate last changed
+	unsigned long resent;		///> Announcements, answers, tests and pings sent again
+	unsigned long timeouts;		///> States left because their time was up
+	unsigned long failures;		///> Rates given up
+} SessionStats_t;
+
+/**
+ * @brief Counters of a ring, and what each hop carries
+ */
+typedef struct {
+	unsigned long inputs[NET_PLAYERS];	///> Inputs received of each player
+	unsigned long forwarded;	///> Inputs passed on downstream
+	unsigned long hop_bytes;	///> Bytes of inputs each step puts on every hop
+	unsigned long hop_capacity;	///> Bytes a hop carries in a second
+} RingStats_t;
+
 /**
  * @brief Serial Port interrupt handler.
  */
 void serial_handler();
 
+/**
+ * @brief Does the work of the session that waits on time: sends the frames due again,
+ * announces this end and retries the handshake backing off, changes the rate once the
+ * bytes sent at the old one are out, pings the other end and times the states out.
+ * Call once per frame while in multiplayer
+ */
+void com_update();
+
 /**
  * @brief Sets the Communication State. Used for multiplayer state.
+ * MP_WAITING starts over from SERIAL_BIT_RATE, MP_ENDED leaves (the game, or waiting),
+ * NONE is done with multiplayer. Only the states entered send anything
  */
 void setComState(serial_state_t state);
 
@@ -37,8 +119,97 @@ void setComState(serial_state_t state);
  */
 serial_state_t getComState();
 
+/**
+ * @brief Gets the counters of the session
+ */
+const SessionStats_t * com_get_stats();
+
+/**
+ * @brief Plays the next multiplayer games in a ring of nodes, from the next MP_WAITING on:
+ * COM1 to the node before, COM2 to the node after, both at a fixed rate. Node 0 leads
+ *
+ * @param nodes Nodes of the ring, 3 to NET_PLAYERS. 0 goes back to two ends on COM1
+ * @param index This node
+ * @param rate Bit rate of every hop, one of those the handshake offers
+ *
+ * @return 0 on success, non-zero if the ring is invalid
+ */
+int com_set_ring(unsigned nodes, unsigned index, unsigned long rate);
+
+/**
+ * @brief Number of serial ports multiplayer uses, from SERIAL_COM1 on
+ */
+unsigned com_ports();
+
+/**
+ * @brief Tells whether every hop of the ring carries the inputs of all players at a number
+ * of steps a second, at the rate configured
+ *
+ * @return Non-zero if it does, or if there is no ring
+ */
+int com_ring_sustains(unsigned steps_per_s);
+
+/**
+ * @brief Gets the counters of the ring
+ */
+const RingStats_t * com_get_ring_stats();
+
 int getflag();
 
+/**
+ * @brief Sends the local input of a step to the other player
+ *
+ * @param frame Step of the input
+ * @param input Input to send
+ */
+void com_send_input(unsigned long frame, const NetInput_t * input);
+
+/**
+ * @brief Index of the local player in a multiplayer game: 0 if this end answered
+ * the other's MP_WAITING, 1 otherwise. The node in a ring
+ */
+unsigned com_get_player();
+
+/**
+ * @brief Seed of the random streams of a multiplayer game, chosen by player 0
+ */
+uint32_t com_get_seed();
+
+/**
+ * @brief Asks to watch the other end play, from the next handshake on.
+ * If both ends ask, player 1 watches
+ */
+void com_set_watch(int watch);
+
+/**
+ * @brief How the current multiplayer game is shared, agreed in the handshake
+ */
+com_mode_t com_get_mode();
+
+/**
+ * @brief Sends a step of a watched game, whole or not at all
+ *
+ * @param step Encoded step
+ * @param len Bytes of the step, COM_DELTA_MAX at most
+ *
+ * @return 0 on success, non-zero if the frames queued leave no room for it
+ */
+int com_send_delta(const unsigned char * step, unsigned len);
+
+/**
+ * @brief Takes the next step of a watched game received
+ *
+ * @param step Buffer for the step, COM_DELTA_MAX bytes
+ *
+ * @return Bytes of the step, 0 if there is none, -1 if steps were lost before the next one
+ */
+int com_read_delta(unsigned char * step);
+
+/**
+ * @brief Number of steps received and not read yet
+ */
+unsigned com_delta_queued();
+
 
 /**@}*/
 
@@ -0,0 +1,54 @@
+#include "Fixed.h"
+
+// Right shifts of negative numbers are implementation defined, so avoid them
+int fixed_to_int(fixed_t f) {
+	if (f >= 0)
+		return f >> FIXED_SHIFT;
+	else
+		return -(int) (((uint32_t) -(int64_t) f + FIXED_ONE - 1) >> FIXED_SHIFT);
+}
+
+int fixed_round(fixed_t f) {
+	return fixed_to_int(f + FIXED_HALF);
+}
+
+fixed_t fixed_mul(fixed_t a, fixed_t b) {
+	return (fixed_t) (((int64_t) a * b) / FIXED_ONE);
+}
+
+fixed_t fixed_div(fixed_t a, fixed_t b) {
+	return (fixed_t) (((int64_t) a * FIXED_ONE) / b);
+}
+
+// Bit by bit, one result bit per iteration
+uint32_t isqrt64(uint64_t n) {
+	uint64_t root = 0, bit = (uint64_t) 1 << 62;
+
+	while (bit > n)
+		bit >>= 2;
+
+	while (bit != 0) {
+		if (n >= root + bit) {
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		} else
+			root >>= 1;
+		bit >>= 2;
+	}
+
+	return (uint32_t) root;
+}
+
+void fixed_normalize(fixed_t x, fixed_t y, fixed_t length, fixed_t * out) {
+	// sqrt of a sum of squares of 16.16 numbers is already in 16.16
+	fixed_t magnitude = isqrt64((uint64_t) ((int64_t) x * x + (int64_t) y * y));
+
+	if (0 == magnitude) {
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	out[0] = (fixed_t) (((int64_t) length * x) / magnitude);
+	out[1] = (fixed_t) (((int64_t) length * y) / magnitude);
+}
@@ -0,0 +1,75 @@
+#ifndef __FIXED_H
+#define __FIXED_H
+
+/** @defgroup Fixed Fixed
+ * @{
+ * 16.16 fixed point arithmetic.
+ *
+ * Only integer operations with fully defined results are used,
+ * so results are bit-identical on every machine and compiler.
+ */
+
+#include <stdint.h>
+
+typedef int32_t fixed_t;	/**< @brief 16.16 fixed point number */
+
+#define FIXED_SHIFT		16
+#define FIXED_ONE		(1 << FIXED_SHIFT)		/**< @brief 1.0 in 16.16 */
+#define FIXED_HALF		(FIXED_ONE >> 1)		/**< @brief 0.5 in 16.16 */
+
+#define INT_TO_FIXED(i)	((fixed_t) ((i) * FIXED_ONE))
+
+/**
+ * @brief Converts a fixed point number to an integer, rounding down
+ *
+ * @param f Number to convert
+ *
+ * @return Largest integer not greater than f
+ */
+int fixed_to_int(fixed_t f);
+
+/**
+ * @brief Rounds a fixed point number to the nearest integer (halves round up)
+ *
+ * @param f Number to round
+ *
+ * @return Nearest integer
+ */
+int fixed_round(fixed_t f);
+
+/**
+ * @brief Multiplies two fixed point numbers
+ *
+ * @return a * b, truncated towards zero
+ */
+fixed_t fixed_mul(fixed_t a, fixed_t b);
+
+/**
+ * @brief Divides two fixed point numbers
+ *
+ * @return a / b, truncated towards zero
+ */
+fixed_t fixed_div(fixed_t a, fixed_t b);
+
+/**
+ * @brief Integer square root
+ *
+ * @param n Radicand
+ *
+ * @return floor(sqrt(n))
+ */
+uint32_t isqrt64(uint64_t n);
+
+/**
+ * @brief Scales the vector (x, y) so its length becomes length
+ *
+ * @param x Horizontal component of the vector
+ * @param y Vertical component of the vector
+ * @param length Length of the resulting vector
+ * @param out Array where the resulting vector is written (x,y)
+ */
+void fixed_normalize(fixed_t x, fixed_t y, fixed_t length, fixed_t * out);
+
+/**@}*/
+
+#endif /* __FIXED_H */
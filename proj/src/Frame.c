@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <string.h>
+#include "Frame.h"
+#include "Serial.h"
+
+#define FRAME_SIZE		(FRAME_OVERHEAD + FRAME_MAX_PAYLOAD)
+
+// Offsets in a frame
+#define AT_LEN		1
+#define AT_TYPE		2
+#define AT_SEQ		3
+#define AT_ACK		4
+#define AT_MASK		5
+
+typedef struct {
+	unsigned char type;
+	unsigned char len;
+	unsigned char payload[FRAME_MAX_PAYLOAD];
+} FrameMsg_t;
+
+typedef struct {
+	FrameMsg_t msg;
+	int sent;					// Sent at least once
+	int acked;
+	unsigned long sent_tick;	// Tick it was last sent in
+} TxSlot_t;
+
+typedef struct {
+	unsigned long ticks;		// frame_update() calls
+
+	// Sending side: sequence numbers [tx_base, tx_next) wait for an acknowledgement
+	TxSlot_t tx_slots[FRAME_QUEUE];
+	uint8_t tx_base;
+	uint8_t tx_next;
+
+	// Receiving side: rx_next is expected, the ones after it are kept until it arrives
+	FrameMsg_t rx_slots[FRAME_WINDOW];
+	int rx_have[FRAME_WINDOW];
+	uint8_t rx_next;
+	int ack_due;		// Received a reliable frame not acknowledged yet
+
+	// Frame being received
+	unsigned char rx_buf[FRAME_SIZE];
+	unsigned rx_len;		// Bytes received, 0 while looking for FRAME_START
+	int rx_damaged;		// A byte of it came with a line error
+
+	FrameStats_t stats;
+} FrameLink_t;
+
+static frame_handler_t handler = NULL;
+static FrameLink_t links[FRAME_LINKS];	// Each on the serial port of the same number
+
+// Private Method -- CRC-16/CCITT, polynomial 0x1021, from 0xFFFF
+static uint16_t crc16(const unsigned char * bytes, unsigned len) {
+	uint16_t crc = 0xFFFF;
+	unsigned i, bit;
+
+	for (i = 0; i < len; ++i) {
+		crc ^= bytes[i] << 8;
+		for (bit = 0; bit < 8; ++bit)
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+// Private Method -- Mask of the frames received past rx_next, bit i for rx_next + 1 + i
+static uint16_t rx_mask(const FrameLink_t * l) {
+	uint16_t mask = 0;
+	unsigned i;
+
+	for (i = 0; i + 1 < FRAME_WINDOW; ++i)
+		if (l->rx_have[(uint8_t) (l->rx_next + 1 + i) % FRAME_WINDOW])
+			mask |= 1 << i;
+	return mask;
+}
+
+// Private Method -- Writes a frame to the serial port, with the acknowledgements due
+static int frame_transmit(unsigned link, unsigned char type, uint8_t seq,
+		const FrameMsg_t * msg) {
+	FrameLink_t * l = &links[link];
+	unsigned char buf[FRAME_SIZE];
+	unsigned size = FRAME_HEADER + msg->len, i;
+	uint16_t mask = rx_mask(l), crc;
+
+	buf[0] = FRAME_START;
+	buf[AT_LEN] = msg->len;
+	buf[AT_TYPE] = type;
+	buf[AT_SEQ] = seq;
+	buf[AT_ACK] = l->rx_next;
+	buf[AT_MASK] = mask & 0xFF;
+	buf[AT_MASK + 1] = mask >> 8;
+	memcpy(buf + FRAME_HEADER, msg->payload, msg->len);
+
+	crc = crc16(buf + 1, size - 1);
+	buf[size++] = crc & 0xFF;
+	buf[size++] = crc >> 8;
+
+	// The whole frame or nothing: a part of one would garble the next frame sent
+	if (serial_tx_free(link) < size)
+		return 1;
+	for (i = 0; i < size; ++i)
+		serial_write(link, buf[i]);
+
+	l->ack_due = 0;
+	++l->stats.sent;
+	return OK;
+}
+
+void frame_attach(frame_handler_t h) {
+	handler = h;
+}
+
+void frame_reset(unsigned link) {
+	FrameLink_t * l = &links[link];
+
+	l->tx_base = 0;
+	l->tx_next = 0;
+	l->rx_next = 0;
+	l->ack_due = 0;
+	memset(l->rx_have, 0, sizeof(l->rx_have));
+	memset(l->tx_slots, 0, sizeof(l->tx_slots));
+}
+
+// Private Method -- Marks the frames the other end has
+static void frame_acked(FrameLink_t * l, uint8_t ack, uint16_t mask) {
+	uint8_t seq;
+	unsigned i;
+
+	// Numbers outside the queue are old, from before a reset
+	if ((uint8_t) (ack - l->tx_base) > (uint8_t) (l->tx_next - l->tx_base))
+		return;
+
+	for (seq = l->tx_base; seq != ack; ++seq)
+		l->tx_slots[seq % FRAME_QUEUE].acked = 1;
+
+	for (i = 0; i + 1 < FRAME_WINDOW; ++i) {
+		seq = ack + 1 + i;
+		if ((mask & (1 << i))
+				&& (uint8_t) (seq - l->tx_base) < (uint8_t) (l->tx_next - l->tx_base))
+			l->tx_slots[seq % FRAME_QUEUE].acked = 1;
+	}
+
+	while (l->tx_base != l->tx_next && l->tx_slots[l->tx_base % FRAME_QUEUE].acked)
+		++l->tx_base;
+}
+
+// Private Method -- Hands a reliable frame over in order, once
+static void frame_deliver_reliable(unsigned link, uint8_t seq,
+		const FrameMsg_t * msg) {
+	FrameLink_t * l = &links[link];
+	uint8_t ahead = seq - l->rx_next;
+
+	l->ack_due = 1;
+	if (ahead >= FRAME_WINDOW) { // Had it already, or too far ahead to keep
+		++l->stats.duplicates;
+		return;
+	}
+
+	if (0 != ahead) { // Some before it are missing
+		if (l->rx_have[seq % FRAME_WINDOW])
+			++l->stats.duplicates;
+		else {
+			l->rx_slots[seq % FRAME_WINDOW] = *msg;
+			l->rx_have[seq % FRAME_WINDOW] = 1;
+		}
+		return;
+	}
+
+	++l->rx_next;
+	if (NULL != handler)
+		handler(link, msg->type, msg->payload, msg->len);
+
+	while (l->rx_have[l->rx_next % FRAME_WINDOW]) {
+		FrameMsg_t * kept = &l->rx_slots[l->rx_next % FRAME_WINDOW];
+		l->rx_have[l->rx_next % FRAME_WINDOW] = 0;
+		++l->rx_next;
+		if (NULL != handler)
+			handler(link, kept->type, kept->payload, kept->len);
+	}
+}
+
+// Private Method -- Handles a frame received in full
+static void frame_received(unsigned link) {
+	FrameLink_t * l = &links[link];
+	unsigned size = FRAME_HEADER + l->rx_buf[AT_LEN];
+	uint16_t crc = l->rx_buf[size] | (l->rx_buf[size + 1] << 8);
+	unsigned char type = l->rx_buf[AT_TYPE];
+	FrameMsg_t msg;
+
+	if (l->rx_damaged || crc != crc16(l->rx_buf + 1, size - 1)) {
+		++l->stats.bad;
+		return;
+	}
+	++l->stats.received;
+
+	frame_acked(l, l->rx_buf[AT_ACK],
+			l->rx_buf[AT_MASK] | (l->rx_buf[AT_MASK + 1] << 8));
+	if (FRAME_ACK == type)
+		return;
+
+	msg.type = type & ~FRAME_RELIABLE;
+	msg.len = l->rx_buf[AT_LEN];
+	memcpy(msg.payload, l->rx_buf + FRAME_HEADER, msg.len);
+
+	if (type & FRAME_RELIABLE)
+		frame_deliver_reliable(link, l->rx_buf[AT_SEQ], &msg);
+	else if (NULL != handler)
+		handler(link, msg.type, msg.payload, msg.len);
+}
+
+void frame_receive(unsigned link, unsigned char byte, int damaged) {
+	FrameLink_t * l = &links[link];
+
+	if (0 == l->rx_len) {
+		if (FRAME_START == byte) {
+			l->rx_buf[l->rx_len++] = byte;
+			l->rx_damaged = damaged;
+		}
+		return;
+	}
+
+	l->rx_buf[l->rx_len++] = byte;
+	l->rx_damaged |= damaged;
+	if (AT_LEN + 1 == l->rx_len && byte > FRAME_MAX_PAYLOAD) {
+		++l->stats.bad; // Not a frame, look for the next start
+		l->rx_len = 0;
+	} else if (l->rx_len > AT_LEN && l->rx_len == FRAME_OVERHEAD + l->rx_buf[AT_LEN]) {
+		l->rx_len = 0;
+		frame_received(link);
+	}
+}
+
+// Private Method -- Checks a frame to send, copying it
+static int frame_make(FrameMsg_t * msg, unsigned char type,
+		const void * payload, unsigned len) {
+	if (type >= FRAME_ACK || len > FRAME_MAX_PAYLOAD) {
+		printf("frame_send -> FAILED invalid frame %x of %u bytes\n", type, len);
+		return 1;
+	}
+
+	msg->type = type;
+	msg->len = len;
+	memcpy(msg->payload, payload, len);
+	return OK;
+}
+
+int frame_send(unsigned link, unsigned char type, const void * payload,
+		unsigned len) {
+	FrameMsg_t msg;
+
+	if (OK != frame_make(&msg, type, payload, len))
+		return 1;
+	return frame_transmit(link, type, 0, &msg);
+}
+
+int frame_send_reliable(unsigned link, unsigned char type,
+		const void * payload, unsigned len) {
+	FrameLink_t * l = &links[link];
+	TxSlot_t * slot;
+
+	if ((uint8_t) (l->tx_next - l->tx_base) >= FRAME_QUEUE) {
+		++l->stats.dropped;
+		return 1;
+	}
+
+	slot = &l->tx_slots[l->tx_next % FRAME_QUEUE];
+	if (OK != frame_make(&slot->msg, type, payload, len))
+		return 1;
+	slot->sent = 0;
+	slot->acked = 0;
+
+	// Sent now if it fits the window, by frame_update() otherwise
+	if ((uint8_t) (l->tx_next - l->tx_base) < FRAME_WINDOW
+			&& OK == frame_transmit(link, type | FRAME_RELIABLE, l->tx_next, &slot->msg)) {
+		slot->sent = 1;
+		slot->sent_tick = l->ticks;
+	}
+
+	++l->tx_next;
+	return OK;
+}
+
+void frame_update(unsigned link) {
+	FrameLink_t * l = &links[link];
+	uint8_t seq;
+
+	++l->ticks;
+
+	for (seq = l->tx_base;
+			seq != l->tx_next && (uint8_t) (seq - l->tx_base) < FRAME_WINDOW; ++seq) {
+		TxSlot_t * slot = &l->tx_slots[seq % FRAME_QUEUE];
+
+		if (slot->acked || (slot->sent && l->ticks - slot->sent_tick < FRAME_RETRY_TICKS))
+			continue;
+		if (OK != frame_transmit(link, slot->msg.type | FRAME_RELIABLE, seq, &slot->msg))
+			break; // Transmit ring full, next time
+
+		if (slot->sent)
+			++l->stats.retransmitted;
+		slot->sent = 1;
+		slot->sent_tick = l->ticks;
+	}
+
+	if (l->ack_due) {
+		FrameMsg_t empty;
+		empty.len = 0;
+		frame_transmit(link, FRAME_ACK, 0, &empty);
+	}
+}
+
+unsigned frame_pending(unsigned link) {
+	return (uint8_t) (links[link].tx_next - links[link].tx_base);
+}
+
+const FrameStats_t * frame_get_stats(unsigned link) {
+	return &links[link].stats;
+}
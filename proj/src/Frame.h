@@ -0,0 +1,118 @@
+#ifndef __FRAME_H
+#define __FRAME_H
+
+/** @defgroup Frame Frame
+ * @{
+ * Messages over the serial port, framed and checked, knowing nothing of the game.
+ *
+ * Each frame is: FRAME_START, payload length, type, sequence number, the sequence
+ * number expected next and a mask of the ones received past it, the payload, and a
+ * CRC-16 (CCITT) of everything after FRAME_START. Bytes between frames, frames that
+ * fail the CRC and frames received with line errors are dropped.
+ *
+ * Reliable frames are numbered, and sent again until the other end acknowledges
+ * them: the acknowledgements ride on every frame sent, or on a FRAME_ACK when there is
+ * nothing else to send. Only the frames missing are sent again (selective repeat), and
+ * the receiving end hands them over in order, once, whatever arrives twice.
+ *
+ * Each serial port is a link of its own, with its own numbering and counters: the
+ * sequence numbers and acknowledgements only ever cover one hop.
+ */
+
+#include <stdint.h>
+#include "Serial.h"
+
+#define FRAME_START			0x7E	/**< @brief First byte of every frame */
+#define FRAME_RELIABLE		0x80	/**< @brief Type bit of the frames that are sent until acknowledged */
+#define FRAME_ACK			0x7F	/**< @brief Type of the frames that only acknowledge */
+
+#define FRAME_MAX_PAYLOAD	64		/**< @brief Most bytes a frame carries */
+#define FRAME_HEADER		7		/**< @brief Bytes before the payload */
+#define FRAME_OVERHEAD		(FRAME_HEADER + 2)	/**< @brief Bytes of a frame besides its payload */
+
+#define FRAME_WINDOW		16		/**< @brief Reliable frames sent and not acknowledged at most */
+#define FRAME_QUEUE			64		/**< @brief Reliable frames waiting for an acknowledgement at most */
+#define FRAME_RETRY_TICKS	8		/**< @brief frame_update() calls before a frame not acknowledged is sent again */
+#define FRAME_LINKS			SERIAL_PORTS	/**< @brief Number of links, link i on serial port i */
+
+/**
+ * @brief Function receiving the frames, once each and in order for the reliable ones
+ *
+ * @param link Link the frame came on
+ * @param type Type of the frame, without FRAME_RELIABLE
+ * @param payload Bytes of the frame, valid during the call
+ * @param len Number of bytes
+ */
+typedef void (*frame_handler_t)(unsigned link, unsigned char type,
+		const unsigned char * payload, unsigned len);
+
+/**
+ * @brief Counters of the frames
+ */
+typedef struct {
+	unsigned long sent;				///> Frames sent, retransmissions and acknowledgements included
+	unsigned long received;			///> Frames received intact
+	unsigned long retransmitted;	///> Reliable frames sent again
+	unsigned long duplicates;		///> Reliable frames received again, dropped
+	unsigned long bad;				///> Frames dropped for a wrong CRC, length, or line errors
+	unsigned long dropped;			///> Reliable frames not sent because the queue was full
+} FrameStats_t;
+
+/**
+ * @brief Sets the function the frames received are given to, on every link
+ */
+void frame_attach(frame_handler_t handler);
+
+/**
+ * @brief Starts the numbering over, on both directions. Frames not acknowledged are forgotten.
+ * Both ends must do it before exchanging reliable frames
+ */
+void frame_reset(unsigned link);
+
+/**
+ * @brief Takes a byte received, handing the frame it completes to the handler
+ *
+ * @param damaged Non-zero if the byte came with a line error: its frame is dropped
+ */
+void frame_receive(unsigned link, unsigned char byte, int damaged);
+
+/**
+ * @brief Sends a frame once
+ *
+ * @param link Link to send it on, the serial port of the same number
+ * @param type Type of the frame, below FRAME_ACK
+ * @param payload Bytes to send, copied
+ * @param len Number of bytes, FRAME_MAX_PAYLOAD at most
+ *
+ * @return 0 on success, non-zero otherwise: nothing is sent if the whole frame does not
+ * fit the transmit ring
+ */
+int frame_send(unsigned link, unsigned char type, const void * payload,
+		unsigned len);
+
+/**
+ * @brief Sends a frame until the other end acknowledges it
+ *
+ * @return 0 on success, non-zero if the queue is full or the frame is invalid
+ */
+int frame_send_reliable(unsigned link, unsigned char type,
+		const void * payload, unsigned len);
+
+/**
+ * @brief Sends the frames due again, and the acknowledgements due. Call once per frame
+ */
+void frame_update(unsigned link);
+
+/**
+ * @brief Number of reliable frames not acknowledged yet
+ */
+unsigned frame_pending(unsigned link);
+
+/**
+ * @brief Gets the counters of the frames
+ */
+const FrameStats_t * frame_get_stats(unsigned link);
+
+/**@}*/
+
+#endif /* __FRAME_H */
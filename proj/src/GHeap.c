@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "GHeap.h"
+#include "GVector.h"
+
+struct gheap_t {
+	GVector * elems;	// Elements, stored as an implicit binary tree
+	unsigned el_size;	// size of each element, in bytes
+	gheap_cmp_t cmp;	// Ordering function
+
+	void * swap_buf;	// Scratch space used when swapping elements
+};
+
+GHeap * new_gheap(unsigned el_size, gheap_cmp_t cmp) {
+#if DEBUG
+	printf("\tNEW GHeap called\n");
+#endif
+
+	if (0 == el_size || NULL == cmp)
+		return NULL;
+
+	GHeap * self = (GHeap *) malloc(sizeof(GHeap));
+	if (NULL == self)
+		return NULL;
+
+	self->elems = new_gvector(el_size);
+	self->el_size = el_size;
+	self->cmp = cmp;
+	self->swap_buf = malloc(el_size);
+
+	if (NULL == self->elems || NULL == self->swap_buf) {
+		if (NULL != self->elems)
+			delete_gvector(self->elems);
+		free(self->swap_buf);
+		free(self);
+		return NULL;
+	}
+
+	return self;
+}
+
+void delete_gheap(GHeap * self) {
+#if DEBUG
+	printf("DELETE GHeap called\n");
+#endif
+
+	delete_gvector(self->elems);
+	free(self->swap_buf);
+	free(self);
+}
+
+unsigned gheap_get_size(GHeap * self) {
+	return gvector_get_size(self->elems);
+}
+
+void * gheap_top(GHeap * self) {
+	return gvector_at(self->elems, 0);
+}
+
+// Private Method
+static void gheap_swap(GHeap * self, unsigned i, unsigned j) {
+	void * a = gvector_at(self->elems, i);
+	void * b = gvector_at(self->elems, j);
+
+	memcpy(self->swap_buf, a, self->el_size);
+	memcpy(a, b, self->el_size);
+	memcpy(b, self->swap_buf, self->el_size);
+}
+
+// Private Method
+static int gheap_less(GHeap * self, unsigned i, unsigned j) {
+	return self->cmp(gvector_at(self->elems, i), gvector_at(self->elems, j))
+			< 0;
+}
+
+void gheap_push(GHeap * self, void * elem) {
+#if DEBUG
+	printf("GHeap PUSH called\n");
+#endif
+
+	gvector_push_back(self->elems, elem);
+
+	// Sift up
+	unsigned idx = gvector_get_size(self->elems) - 1;
+	while (idx > 0 && gheap_less(self, idx, (idx - 1) / 2)) {
+		gheap_swap(self, idx, (idx - 1) / 2);
+		idx = (idx - 1) / 2;
+	}
+}
+
+void gheap_pop(GHeap * self) {
+#if DEBUG
+	printf("GHeap POP called\n");
+#endif
+
+	unsigned size = gvector_get_size(self->elems);
+	if (0 == size) {
+		printf("GHeap::pop tried to pop empty heap\n");
+		return;
+	}
+
+	gheap_swap(self, 0, size - 1);
+	gvector_pop_back(self->elems);
+	--size;
+
+	// Sift down
+	unsigned idx = 0;
+	while (1) {
+		unsigned smallest = idx, left = 2 * idx + 1, right = 2 * idx + 2;
+
+		if (left < size && gheap_less(self, left, smallest))
+			smallest = left;
+		if (right < size && gheap_less(self, right, smallest))
+			smallest = right;
+
+		if (smallest == idx)
+			break;
+
+		gheap_swap(self, idx, smallest);
+		idx = smallest;
+	}
+}
+
+const void * gheap_elems(GHeap * self) {
+	return gvector_at(self->elems, 0);
+}
+
+void gheap_assign(GHeap * self, const void * elems, unsigned count) {
+	// Already a heap, so the order is kept as is
+	gvector_resize(self->elems, count);
+	if (0 != count)
+		memcpy(gvector_at(self->elems, 0), elems, count * self->el_size);
+}
+
+void gheap_clear(GHeap * self) {
+#if DEBUG
+	printf("\tGHeap CLEAR called\n");
+#endif
+
+	gvector_clear(self->elems);
+}
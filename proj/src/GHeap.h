@@ -0,0 +1,104 @@
+#ifndef __GHEAP_H
+#define __GHEAP_H
+
+/** @defgroup GHeap GHeap
+ * @{
+ * Functions for the usage of a GHeap - Generic Binary Min-Heap
+ */
+
+/**
+ * Struct for Generic Binary Min-Heap Container
+ */
+struct gheap_t;
+typedef struct gheap_t GHeap;
+
+/**
+ * @brief Comparison function used to order the GHeap
+ *
+ * Must return a negative value if the first element should be popped before the second one,
+ * zero if they are equivalent and a positive value otherwise.
+ */
+typedef int (*gheap_cmp_t)(const void *, const void *);
+
+/**
+ * @brief Constructs a new GHeap
+ *
+ * @param el_size Size, in bytes, of the type being stored in this instance of GHeap
+ * @param cmp Function used to compare two elements
+ *
+ * @return Pointer to the the newly created GHeap
+ */
+GHeap * new_gheap(unsigned el_size, gheap_cmp_t cmp);
+
+/**
+ * @brief Deletes a GHeap, freeing all the allocated memory
+ *
+ * @param self Pointer to the GHeap to be deleted
+ */
+void delete_gheap(GHeap * self);
+
+/**
+ * @brief Gets the size (number of elements) of a GHeap
+ *
+ * @param self Pointer to the GHeap
+ *
+ * @return The number of elements in the GHeap
+ */
+unsigned gheap_get_size(GHeap * self);
+
+/**
+ * @brief Access to the smallest element of the GHeap
+ *
+ * @param self The GHeap to access
+ *
+ * @return Pointer to the smallest element, must be cast to the appropriate type. NULL if empty
+ */
+void * gheap_top(GHeap * self);
+
+/**
+ * @brief Pushes a new element to the GHeap, in O(log n).
+ * Memory reallocation may happen.
+ *
+ * @param self The GHeap to access
+ * @param elem Pointer to the element to be copied
+ */
+void gheap_push(GHeap * self, void * elem);
+
+/**
+ * @brief Erases the smallest element of the GHeap, in O(log n).
+ * Memory reallocation may happen.
+ *
+ * @param self The GHeap to access
+ */
+void gheap_pop(GHeap * self);
+
+/**
+ * @brief Access to the elements of the GHeap, in heap order
+ *
+ * @param self The GHeap to access
+ *
+ * @return Pointer to gheap_get_size() contiguous elements
+ */
+const void * gheap_elems(GHeap * self);
+
+/**
+ * @brief Replaces the elements of the GHeap with a copy of another GHeap's (see gheap_elems()).
+ * Memory reallocation only happens if the GHeap never held as many elements.
+ *
+ * @param self The GHeap to access
+ * @param elems Elements, in heap order
+ * @param count Number of elements
+ */
+void gheap_assign(GHeap * self, const void * elems, unsigned count);
+
+/**
+ * @brief Erases all elements of GHeap.
+ * Memory reallocation may happen.
+ *
+ * @param self The GHeap to access
+ */
+void gheap_clear(GHeap * self);
+
+/**@}*/
+
+#endif /* __GHEAP_H */
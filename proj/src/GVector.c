@@ -5,6 +5,7 @@
 
 
 struct gvector_t {
+    unsigned first;             // index in array of the first element, past the ones popped from the front
     unsigned size;              // number of elements in generic vector
     unsigned el_size;           // size of each element, in bytes
     unsigned capacity;          // Capacity of vector, larger than size to prevent continuous reallocs
@@ -25,6 +26,7 @@ GVector * new_gvector(unsigned el_size) {
     if (NULL == self)
         return NULL;
 
+    self->first = 0;
     self->size = 0;
     self->increments = 10;
     self->capacity = self->increments;
@@ -58,10 +60,10 @@ static void gvector_check_capacity(GVector * self) {
     printf("GVector CHECK CAPACITY called\n");
 #endif
 
-    if ( (self->capacity - self->size) > self->increments ) {
+    if ( (self->capacity - self->first - self->size) > self->increments ) {
         self->capacity -= self->increments;
         self->array = realloc(self->array, self->capacity * self->el_size);
-    } else if ( self->capacity == self->size ) {
+    } else if ( self->capacity == self->first + self->size ) {
         self->capacity += self->increments;
         self->array = realloc(self->array, self->capacity * self->el_size);
     }
@@ -74,7 +76,7 @@ void * gvector_at(GVector * self, unsigned index) {
 	printf("\tGVector AT called\n");
 #endif
 
-    return index < self->size ? self->array + index * self->el_size : NULL;
+    return index < self->size ? self->array + (self->first + index) * self->el_size : NULL;
 }
 
 
@@ -84,7 +86,7 @@ void * gvector_push_back(GVector * self, void * elem) {
 #endif
 
     gvector_check_capacity(self);
-    memcpy(self->array + self->el_size * self->size++, elem, self->el_size);
+    memcpy(self->array + self->el_size * (self->first + self->size++), elem, self->el_size);
 
     return gvector_at(self, self->size - 1);
 }
@@ -114,16 +116,58 @@ void gvector_erase(GVector * self, unsigned index) {
 	}
 
 	--(self->size);
-	memmove(self->array + index * self->el_size, self->array + (index + 1) * self->el_size, (self->size - index) * self->el_size);
+	index += self->first;
+	memmove(self->array + index * self->el_size, self->array + (index + 1) * self->el_size, (self->first + self->size - index) * self->el_size);
 
 	gvector_check_capacity(self);
 }
 
+void gvector_pop_front(GVector * self) {
+#if DEBUG
+	printf("GVector POP FRONT called\n");
+#endif
+
+	if (0 == self->size) {
+		printf("GVector::pop_front tried to pop empty vector\n");
+		return;
+	}
+
+	++(self->first);
+	--(self->size);
+
+	// Moves the elements back to the start once as many were popped: O(1) amortized
+	if (self->first >= self->size) {
+		memmove(self->array, self->array + self->first * self->el_size, self->size * self->el_size);
+		self->first = 0;
+	}
+
+	gvector_check_capacity(self);
+}
+
+void gvector_resize(GVector * self, unsigned size) {
+#if DEBUG
+	printf("\tGVector RESIZE called\n");
+#endif
+
+	if (self->first > 0) {
+		memmove(self->array, self->array + self->first * self->el_size, self->size * self->el_size);
+		self->first = 0;
+	}
+
+	if (size > self->capacity) {
+		self->capacity = size;
+		self->array = realloc(self->array, self->capacity * self->el_size);
+	}
+
+	self->size = size;
+}
+
 void gvector_clear(GVector * self) {
 #if DEBUG
 	printf("\tGVector CLEAR called\n");
 #endif
 
+    self->first = 0;
     self->size = 0;
 
     gvector_check_capacity(self);
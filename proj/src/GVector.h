@@ -77,6 +77,23 @@ void gvector_erase(GVector * self, unsigned idx);
  */
 void gvector_pop_back(GVector * self);
 
+/**
+ * @brief Erases the first element of GVector, in O(1) amortized, for a GVector used as a queue.
+ * Memory reallocation may happen.
+ *
+ * @param self The GVector to access
+ */
+void gvector_pop_front(GVector * self);
+
+/**
+ * @brief Sets the size of a GVector. New elements are left uninitialised.
+ * Memory reallocation only happens when growing beyond the capacity, never when shrinking.
+ *
+ * @param self The GVector to access
+ * @param size New number of elements
+ */
+void gvector_resize(GVector * self, unsigned size);
+
 /**
  * @brief Erases all elements of GVector.
  * Memory reallocation may happen.
@@ -1,87 +1,492 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "Highscores.h"
 
-Score_t * loadScores(const char* filename) {
-	//Score_t scores[HIGHSCORE_NUMBER];
-	Score_t * scores = (Score_t*) malloc(sizeof(Score_t) * HIGHSCORE_NUMBER);
+#define NIL			0xFFFF	// No node
+#define LOAD_BATCH	64		// Records read at once
 
-	// open filename
-	FILE *filePtr;
-	filePtr = fopen(filename, "r");
-	if (filePtr == NULL) {
-		printf("loadScores -> File Non Existent.\n");
-		return NULL;
+/**
+ * @brief A score in the tree
+ */
+typedef struct {
+	Score_t score;		///> The score
+	uint32_t seq;		///> Order it was added in: on equal scores, the older ranks first
+	uint32_t priority;	///> Heap order of the treap, above the ones of its children
+	uint16_t left;		///> Subtree of the scores ranked before it, NIL for none
+	uint16_t right;		///> Subtree of the scores ranked after it, NIL for none
+	uint16_t size;		///> Scores in its subtree, itself included
+} ScoreNode_t;
+
+/**
+ * @brief The scores, and where they are kept
+ */
+typedef struct {
+	int open;						///> Whether highscores_open() was called
+	char path[HIGHSCORE_PATH_MAX];	///> File of the store
+	char tmp_path[HIGHSCORE_PATH_MAX];	///> File it is written to first
+	ScoreNode_t nodes[HIGHSCORE_CAPACITY];	///> Nodes [0, count) are in the tree
+	uint16_t root;					///> Root of the tree, NIL when empty
+	unsigned count;					///> Scores in the store
+	uint32_t seq;					///> Order of the next score added
+	uint32_t rng;					///> State of the priorities, xorshift32
+} ScoreStore_t;
+
+/**
+ * @brief The store waiting to be written, and how far the write is
+ */
+typedef struct {
+	int queued;						///> Whether the store waits to be written
+	FILE * file;					///> Temporary file, NULL until opened
+	unsigned next;					///> Rank of the next score to write to it
+} ScoreQueue_t;
+
+static ScoreStore_t store = { 0 };
+static ScoreQueue_t queue = { 0 };
+
+/** Tree **/
+
+static unsigned size_of(unsigned t) {
+	return NIL == t ? 0 : store.nodes[t].size;
+}
+
+static void resize(unsigned t) {
+	store.nodes[t].size = 1 + size_of(store.nodes[t].left)
+			+ size_of(store.nodes[t].right);
+}
+
+// Private Method -- Whether a score ranks before a node
+static int ranks_before(unsigned score, uint32_t seq, const ScoreNode_t * n) {
+	return score > n->score.score || (score == n->score.score && seq < n->seq);
+}
+
+// Private Method -- Lifts the left child of a node in its place
+static unsigned rotate_right(unsigned t) {
+	unsigned l = store.nodes[t].left;
+
+	store.nodes[t].left = store.nodes[l].right;
+	store.nodes[l].right = t;
+	resize(t);
+	resize(l);
+	return l;
+}
+
+// Private Method -- Lifts the right child of a node in its place
+static unsigned rotate_left(unsigned t) {
+	unsigned r = store.nodes[t].right;
+
+	store.nodes[t].right = store.nodes[r].left;
+	store.nodes[r].left = t;
+	resize(t);
+	resize(r);
+	return r;
+}
+
+// Private Method -- Puts node n in the subtree t, returns the new root of the subtree
+static unsigned tree_insert(unsigned t, unsigned n) {
+	ScoreNode_t * node = &store.nodes[n];
+
+	if (NIL == t)
+		return n;
+
+	if (ranks_before(node->score.score, node->seq, &store.nodes[t])) {
+		store.nodes[t].left = tree_insert(store.nodes[t].left, n);
+		resize(t);
+		if (store.nodes[store.nodes[t].left].priority > store.nodes[t].priority)
+			t = rotate_right(t);
+	} else {
+		store.nodes[t].right = tree_insert(store.nodes[t].right, n);
+		resize(t);
+		if (store.nodes[store.nodes[t].right].priority > store.nodes[t].priority)
+			t = rotate_left(t);
 	}
+	return t;
+}
+
+// Private Method -- Takes the lowest score out of the subtree t, returns the new root of the subtree
+static unsigned tree_remove_last(unsigned t, unsigned * removed) {
+	if (NIL == store.nodes[t].right) {
+		*removed = t;
+		return store.nodes[t].left; // Its priority is below t's, the heap holds
+	}
+	store.nodes[t].right = tree_remove_last(store.nodes[t].right, removed);
+	--store.nodes[t].size;
+	return t;
+}
+
+// Private Method -- Number of scores ranking before a score added with order seq
+static unsigned tree_rank(unsigned score, uint32_t seq) {
+	unsigned t = store.root, rank = 0;
+
+	while (NIL != t) {
+		if (ranks_before(score, seq, &store.nodes[t])) {
+			t = store.nodes[t].left;
+		} else {
+			rank += size_of(store.nodes[t].left) + 1;
+			t = store.nodes[t].right;
+		}
+	}
+	return rank;
+}
+
+static uint32_t next_priority() {
+	store.rng ^= store.rng << 13;
+	store.rng ^= store.rng >> 17;
+	store.rng ^= store.rng << 5;
+	return store.rng;
+}
+
+static void store_clear() {
+	store.root = NIL;
+	store.count = 0;
+	store.seq = 0;
+	store.rng = 2463534242u;
+}
 
+// Private Method -- Sets the empty tree up, when used before highscores_open()
+static void store_ready() {
+	if (0 == store.rng)
+		store_clear();
+}
+
+/** Files **/
+
+// Private Method -- Writes a score as a line of the text file
+static int put_score(FILE * filePtr, const Score_t * score) {
+	return fprintf(filePtr, "%u, %lu:%lu %lu/%lu/%lu\n", score->score,
+			score->hour, score->minute, score->day, score->month,
+			score->year) < 0;
+}
+
+// Private Method -- Names a file next to filename: the one written before taking its place, or the one it is moved to
+static int suffixed_name(char * name, const char * filename, const char * suffix) {
+	if (strlen(filename) + strlen(suffix) >= HIGHSCORE_PATH_MAX) {
+		printf("suffixed_name -> FAILED, name too long: %s\n", filename);
+		return 1;
+	}
+	strcpy(name, filename);
+	strcat(name, suffix);
+	return OK;
+}
+
+// Private Method -- Puts the temporary file on the disk, then in place of filename
+static int commit_file(FILE * filePtr, const char * tmp, const char * filename) {
+	int failed = ferror(filePtr) || 0 != fflush(filePtr)
+			|| 0 != fsync(fileno(filePtr));
+
+	failed = 0 != fclose(filePtr) || failed;
+	if (failed || 0 != rename(tmp, filename)) {
+		remove(tmp); // The file stays as it was
+		return 1;
+	}
+	return OK;
+}
+
+// Private Method -- Writes a little endian u16
+static void put_u16(unsigned char * buf, uint16_t value) {
+	buf[0] = value & 0xFF;
+	buf[1] = value >> 8;
+}
+
+// Private Method -- Writes a little endian u32
+static void put_u32(unsigned char * buf, uint32_t value) {
 	unsigned i;
-	for (i = 0; i < HIGHSCORE_NUMBER; ++i) {
-		//Reading "score, hour:minute day/month/year"
-		fscanf(filePtr, "%u", &scores[i].score);
-		fseek(filePtr, 2, SEEK_CUR);					//Ignoring ", "
+	for (i = 0; i < 4; ++i)
+		buf[i] = (value >> (8 * i)) & 0xFF;
+}
+
+// Private Method -- Reads a little endian u16
+static uint16_t get_u16(const unsigned char * buf) {
+	return buf[0] | (buf[1] << 8);
+}
+
+// Private Method -- Reads a little endian u32
+static uint32_t get_u32(const unsigned char * buf) {
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t) buf[3] << 24);
+}
+
+// Private Method -- Writes a score as a record of the binary file
+static void put_record(unsigned char * record, const Score_t * score) {
+	put_u32(record, score->score);
+	put_u16(record + 4, score->year);
+	record[6] = score->month;
+	record[7] = score->day;
+	record[8] = score->hour;
+	record[9] = score->minute;
+}
 
-		fscanf(filePtr, "%u", &scores[i].hour);
-		fseek(filePtr, 1, SEEK_CUR);					//Ignoring ":"
+// Private Method -- Reads a score from a record of the binary file
+static void get_record(const unsigned char * record, Score_t * score) {
+	score->score = get_u32(record);
+	score->year = get_u16(record + 4);
+	score->month = record[6];
+	score->day = record[7];
+	score->hour = record[8];
+	score->minute = record[9];
+}
 
-		fscanf(filePtr, "%u", &scores[i].minute);
-		fseek(filePtr, 1, SEEK_CUR);					//Ignoring " "
+// Private Method -- Forgets the half written store, to write it from the start
+static void drop_file() {
+	if (NULL != queue.file) {
+		fclose(queue.file);
+		remove(store.tmp_path);
+		queue.file = NULL;
+	}
+	queue.next = 0;
+}
 
-		fscanf(filePtr, "%u", &scores[i].day);
-		fseek(filePtr, 1, SEEK_CUR);					//Ignoring "/"
+// Private Method -- Reads the scores of a binary file into the empty store
+static int load_store(FILE * file) {
+	unsigned char header[HIGHSCORE_HEADER_SIZE];
+	unsigned char records[LOAD_BATCH * HIGHSCORE_RECORD_SIZE];
+	Score_t score;
+	uint32_t count;
+	unsigned i, n;
 
-		fscanf(filePtr, "%u", &scores[i].month);
-		fseek(filePtr, 1, SEEK_CUR);					//Ignoring "/"
+	if (1 != fread(header, sizeof(header), 1, file)
+			|| 0 != memcmp(header, HIGHSCORE_MAGIC, 4)
+			|| HIGHSCORE_VERSION != get_u32(header + 4)
+			|| HIGHSCORE_RECORD_SIZE != get_u32(header + 8)
+			|| (count = get_u32(header + 12)) > HIGHSCORE_CAPACITY)
+		return 1;
 
-		fscanf(filePtr, "%u", &scores[i].year);
-		fseek(filePtr, 1, SEEK_CUR);					//Ignoring \n
+	while (count > 0) {
+		n = count < LOAD_BATCH ? count : LOAD_BATCH;
+		if (n != fread(records, HIGHSCORE_RECORD_SIZE, n, file))
+			return 1;
+		for (i = 0; i < n; ++i) {
+			get_record(records + i * HIGHSCORE_RECORD_SIZE, &score);
+			highscores_insert(&score);
+		}
+		count -= n;
 	}
+	return OK;
+}
+
+/** Store **/
+
+int highscores_open(const char* filename, const char* text) {
+	char bad[HIGHSCORE_PATH_MAX];
+	FILE * file;
+
+	if (store.open)
+		return OK; // Loaded once for the process
+
+	store_clear();
+	if (OK != suffixed_name(store.tmp_path, filename, HIGHSCORE_TMP_SUFFIX))
+		return 1;
+	strcpy(store.path, filename);
+
+	file = fopen(filename, "rb");
+	if (NULL == file) {
+		// No store yet: the table written before it, if any
+		if (NULL != text && OK == highscores_import(text))
+			printf("highscores_open -> Imported %u scores from %s\n",
+					store.count, text);
+		store.open = 1;
+		return OK;
+	}
+
+	if (OK != load_store(file)) {
+		fclose(file);
+		store_clear();
+
+		// Put aside, for the next save not to write over it
+		if (OK != suffixed_name(bad, filename, HIGHSCORE_BAD_SUFFIX)
+				|| 0 != rename(filename, bad)) {
+			printf("highscores_open -> FAILED, %s is not a store of this version, nothing is saved\n",
+					filename);
+			return 1;
+		}
+		printf("highscores_open -> %s is not a store of this version, moved to %s\n",
+				filename, bad);
+		store.open = 1;
+		return 1;
+	}
+	fclose(file);
+
+	store.open = 1;
+	return OK;
+}
+
+int highscores_insert(const Score_t* score) {
+	unsigned rank, n;
+	ScoreNode_t * node;
+
+	store_ready();
+	rank = tree_rank(score->score, store.seq);
+
+	if (HIGHSCORE_CAPACITY == store.count) {
+		if (rank >= HIGHSCORE_CAPACITY)
+			return -1; // Lowest of a full store
+		store.root = tree_remove_last(store.root, &n);
+	} else {
+		n = store.count++;
+	}
+
+	node = &store.nodes[n];
+	node->score = *score;
+	node->seq = store.seq++;
+	node->priority = next_priority();
+	node->left = NIL;
+	node->right = NIL;
+	node->size = 1;
+	store.root = tree_insert(store.root, n);
+
+	if (NULL != queue.file)
+		drop_file(); // The ranks written so far moved
+
+	return rank;
+}
+
+unsigned highscores_rank(unsigned score) {
+	store_ready();
+	return tree_rank(score, store.seq);
+}
+
+const Score_t * highscores_at(unsigned rank) {
+	unsigned t = store.root, left;
+
+	if (rank >= store.count)
+		return NULL;
+
+	for (;;) {
+		left = size_of(store.nodes[t].left);
+		if (rank < left) {
+			t = store.nodes[t].left;
+		} else if (rank == left) {
+			return &store.nodes[t].score;
+		} else {
+			rank -= left + 1;
+			t = store.nodes[t].right;
+		}
+	}
+}
+
+unsigned highscores_count() {
+	return store.count;
+}
+
+int highscores_import(const char* filename) {
+	char line[96];
+	Score_t score;
+	FILE * filePtr = fopen(filename, "r");
+
+	if (filePtr == NULL) {
+		printf("highscores_import -> File Non Existent.\n");
+		return 1;
+	}
+
+	//Reading "score, hour:minute day/month/year" lines
+	while (NULL != fgets(line, sizeof(line), filePtr))
+		if (6 == sscanf(line, "%u, %lu:%lu %lu/%lu/%lu", &score.score,
+						&score.hour, &score.minute, &score.day, &score.month,
+						&score.year))
+			highscores_insert(&score);
 
 	fclose(filePtr);
-	return scores;
+	return OK;
 }
 
-int writeScores(const char* filename, Score_t* scores) {
-	printf("\t\tWRITE SCORES CALLED!\n");
-	// open filename
-	FILE* filePtr;
-	filePtr = fopen(filename, "w");
+int highscores_export(const char* filename, unsigned number) {
+	char tmp[HIGHSCORE_PATH_MAX];
+	FILE * filePtr;
+	unsigned rank;
+	int failed = 0;
+
+	if (OK != suffixed_name(tmp, filename, HIGHSCORE_TMP_SUFFIX))
+		return 1;
+	filePtr = fopen(tmp, "w");
 	if (filePtr == NULL) {
-		printf("writeScores -> File Non Existent.\n");
+		printf("highscores_export -> FAILED to open %s\n", tmp);
 		return 1;
 	}
 
-	unsigned i;
-	for (i = 0; i < HIGHSCORE_NUMBER; ++i) {
-		fprintf(filePtr, "%u, %u:%u %u/%u/%u\n", scores[i].score,
-				scores[i].hour, scores[i].minute, scores[i].day,
-				scores[i].month, scores[i].year);
-		printf("writing score: %u, %u:%u %u/%u/%u\n", scores[i].score,
-				scores[i].hour, scores[i].minute, scores[i].day,
-				scores[i].month, scores[i].year);
+	if (0 == number || number > store.count)
+		number = store.count;
+	for (rank = 0; rank < number; ++rank)
+		failed = put_score(filePtr, highscores_at(rank)) || failed;
+
+	if (failed) {
+		fclose(filePtr);
+		remove(tmp);
+		printf("highscores_export -> FAILED to write %s\n", tmp);
+		return 1;
+	}
+	if (OK != commit_file(filePtr, tmp, filename)) {
+		printf("highscores_export -> FAILED to replace %s\n", filename);
+		return 1;
 	}
-	fclose(filePtr);
 
 	return OK;
 }
 
-int updateScores(Score_t* scores, Score_t newscore) {
-	printf("\t\tUPDATE SCORES CALLED\n");
-	int updated = 0; // updated flag
-	unsigned i;
+/** Writing behind **/
 
-	for (i = 0; i < HIGHSCORE_NUMBER; ++i) {
-		if (scores[i].score < newscore.score) {
-			Score_t helper = scores[i];
+int highscores_save() {
+	if (!store.open)
+		return 1;
 
-			scores[i] = newscore;
-			newscore = helper;
-			updated = 1;
-			printf("updating score: %u, %u:%u %u/%u/%u\n", scores[i].score,
-					scores[i].hour, scores[i].minute, scores[i].day,
-					scores[i].month, scores[i].year);
+	drop_file(); // Only the store as it is at the end counts
+	queue.queued = 1;
+	return OK;
+}
+
+int highscores_idle() {
+	unsigned char header[HIGHSCORE_HEADER_SIZE];
+	unsigned char record[HIGHSCORE_RECORD_SIZE];
+	FILE * filePtr;
+	unsigned end;
+
+	if (!queue.queued)
+		return OK;
+
+	if (NULL == queue.file) {
+		queue.file = fopen(store.tmp_path, "wb");
+		if (NULL == queue.file) {
+			printf("highscores_idle -> FAILED to open %s\n", store.tmp_path);
+			queue.queued = 0;
+			return 1;
+		}
+		memcpy(header, HIGHSCORE_MAGIC, 4);
+		put_u32(header + 4, HIGHSCORE_VERSION);
+		put_u32(header + 8, HIGHSCORE_RECORD_SIZE);
+		put_u32(header + 12, store.count);
+		fwrite(header, sizeof(header), 1, queue.file);
+		queue.next = 0;
+		return OK;
+	}
+
+	if (queue.next < store.count) {
+		end = queue.next + HIGHSCORE_IDLE_SCORES < store.count ?
+				queue.next + HIGHSCORE_IDLE_SCORES : store.count;
+		for (; queue.next < end; ++queue.next) {
+			put_record(record, highscores_at(queue.next));
+			fwrite(record, sizeof(record), 1, queue.file);
 		}
+		return OK;
 	}
 
-	return updated;
+	// All written: on the disk, then in place
+	filePtr = queue.file;
+	queue.file = NULL;
+	queue.queued = 0;
+	if (OK != commit_file(filePtr, store.tmp_path, store.path)) {
+		printf("highscores_idle -> FAILED to replace %s\n", store.path);
+		return 1;
+	}
+
+	return OK;
+}
+
+int highscores_flush() {
+	while (queue.queued)
+		if (OK != highscores_idle())
+			return 1;
+	return OK;
+}
 
+int highscores_pending() {
+	return queue.queued;
 }
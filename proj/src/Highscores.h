@@ -3,11 +3,39 @@
 
 /** @defgroup Highscores Highscores
  * @{
- * Functions for manipulating the HighScores and the files interaction
+ * The leaderboard: every score kept, up to HIGHSCORE_CAPACITY, ranked from the highest.
+ *
+ * The store is loaded once, by the first highscores_open(), and stays in memory for the
+ * whole process: it is the one that counts. The scores are indexed by an order
+ * statistic tree (a treap whose nodes know the size of their subtree), so adding a
+ * score, finding the rank a score would get and fetching the score of a rank take
+ * O(log n). On equal scores, the older one ranks first.
+ *
+ * On the disk, the store is binary and little endian: "PDHS", the version and the size
+ * of a record (u32 each), the number of records (u32), then the records from the highest
+ * score: the score (u32), the year (u16), the month, day, hour and minute (u8). Saving
+ * only queues the store, written behind the game in idle ticks (highscores_idle()), a
+ * few hundred records per tick. The file is written whole under another name, then
+ * renamed over the old one, so a crash or a power cut halfway leaves the old store or
+ * the new one, never a torn file.
+ *
+ * The text format of the first tables, a "score, hour:minute day/month/year" line per
+ * score, is kept to import and export scores.
  */
 
+#include <stdint.h>
+
 #define OK						0
-#define HIGHSCORE_NUMBER		5	/**< @brief Number of high scores saved */
+#define HIGHSCORE_NUMBER		5	/**< @brief Number of high scores shown */
+#define HIGHSCORE_CAPACITY		4096	/**< @brief Scores kept at most, the lowest one goes when full */
+#define HIGHSCORE_MAGIC			"PDHS"	/**< @brief First bytes of the binary store */
+#define HIGHSCORE_VERSION		2	/**< @brief Version of the binary store. Version 1 wrote the records as laid out in memory */
+#define HIGHSCORE_HEADER_SIZE	16	/**< @brief Bytes before the first record */
+#define HIGHSCORE_RECORD_SIZE	10	/**< @brief Bytes of a record */
+#define HIGHSCORE_TMP_SUFFIX	".tmp"	/**< @brief Appended to the file name while it is written */
+#define HIGHSCORE_BAD_SUFFIX	".bad"	/**< @brief Appended to the name of a file that could not be read */
+#define HIGHSCORE_PATH_MAX		256	/**< @brief Longest file name of the store, suffix included */
+#define HIGHSCORE_IDLE_SCORES	256	/**< @brief Scores written by each highscores_idle() */
 
 /**
  * @brief A structure that contains a score's information
@@ -22,35 +50,99 @@ typedef struct {
 } Score_t;
 
 /**
- * @brief Load the 5 Highest Scores from a file into an array
+ * @brief Loads the store from its binary file, once for the process
+ *
+ * Later calls do nothing once it succeeded. Without a binary file, the scores of the
+ * text file are imported, for the tables written before the store; without either, it
+ * starts empty. A binary file that cannot be read is renamed with HIGHSCORE_BAD_SUFFIX,
+ * and the store starts empty; if it cannot be renamed either, it stays, and nothing is
+ * saved (highscores_save() fails) for it to be lost.
+ *
+ * @param filename path of the binary file, where highscores_save() writes it too
+ * @param text path of the text file imported in its place, NULL for none
+ *
+ * @return Return 0 upon success and non-zero otherwise (the store is then empty)
+ */
+int highscores_open(const char* filename, const char* text);
+
+/**
+ * @brief Adds a score to the store
+ *
+ * When the store is full, the lowest score goes to make room, or the new one is not
+ * kept if it is the lowest. A write under way starts over.
+ *
+ * @param score Score to add, copied
+ *
+ * @return Rank of the score, from 0 for the highest; negative if it was not kept
+ */
+int highscores_insert(const Score_t* score);
+
+/**
+ * @brief Rank a score would get if it were added now, from 0 for the highest
+ */
+unsigned highscores_rank(unsigned score);
+
+/**
+ * @brief Gets the score of a rank, from 0 for the highest
  *
- * @param filename path of the location of the file containing the scores
+ * @return The score, valid until the store changes; NULL past the last one
+ */
+const Score_t * highscores_at(unsigned rank);
+
+/**
+ * @brief Number of scores in the store
+ */
+unsigned highscores_count();
+
+/**
+ * @brief Adds the scores of a text file to the store
+ *
+ * @param filename path of the file, a "score, hour:minute day/month/year" line per score
  *
- * @return Array containg the 5 Highest Scores
+ * @return Return 0 upon success and non-zero otherwise
  */
-Score_t * loadScores(const char* filename);
+int highscores_import(const char* filename);
 
 /**
- * @brief Writes the 5 Highest Scores from an array into a file
+ * @brief Writes the highest scores to a text file, at once
  *
- * @param filename path of the location of the file that is going to be written
- * @param scores Array containg the Scores that are going to be written
+ * @param filename path of the file, replaced whole or not at all
+ * @param number Number of scores to write, 0 for all of them
  *
  * @return Return 0 upon success and non-zero otherwise
  */
-int writeScores(const char* filename, Score_t * scores);
+int highscores_export(const char* filename, unsigned number);
 
 /**
- * @brief Updates the array containing the 5 Highest Scores, with a new Score.
+ * @brief Queues the store to be written to its binary file by highscores_idle()
  *
- * If the Score is not bigger than any of the Highest Scores, the array remains intact.
+ * A write under way starts over, only the store as it is at the end is written.
  *
- * @param scores Array containing the 5 Highest Scores
- * @param newscore Score to be added (or not, if not bigger)
+ * @return Return 0 upon success and non-zero otherwise (no file opened)
+ */
+int highscores_save();
+
+/**
+ * @brief Takes the queued store a step further to its file. Call when there is time to spare
+ *
+ * Opens the temporary file, writes HIGHSCORE_IDLE_SCORES scores, or flushes it to the
+ * disk and renames it over the store, one of them per call.
  *
- * @return Return 0 if scores was updated, non-zero otherwise
+ * @return Return 0 while nothing failed, non-zero if the write was given up
+ */
+int highscores_idle();
+
+/**
+ * @brief Writes the queued store at once, before leaving
+ *
+ * @return Return 0 upon success (or with nothing queued) and non-zero otherwise
+ */
+int highscores_flush();
+
+/**
+ * @brief Whether the store waits to be written
  */
-int updateScores(Score_t* scores, Score_t newscore);
+int highscores_pending();
 
 /**@}*/
 
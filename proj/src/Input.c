@@ -1,8 +1,45 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if !HEADLESS
 #include <minix/syslib.h>
+#endif
 #include "Input.h"
+#include "video_gr.h"
+#include "InputRing.h"
+#include "Clock.h"
+#include "Profiler.h"
+#include "Replay.h"
 
 static Input_t * input = NULL;
 
+static InputRing_t events;			// Filled by the interrupt handlers, drained by input_drain()
+static unsigned char buttons_held = 0;	// Buttons held in the last packet, interrupt side
+
+// Bit index of a scancode: make code in the lower 7 bits, bit 7 set for 0xE0 codes
+#define SCANCODE_IDX(code)	((((code) >> 8) == 0xE0 ? 0x80 : 0) | ((code) & 0x7F))
+
+// Set-1 make codes to logical keys. Unlisted scancodes are KEY_NONE
+static const unsigned char scancode_keys[INPUT_SCANCODES] = {
+	[0x01] = KEY_ESC,
+	[0x1C] = KEY_ENTER,
+	[0x39] = KEY_SPACE,
+	[0x11] = KEY_W,
+	[0x1E] = KEY_A,
+	[0x1F] = KEY_S,
+	[0x20] = KEY_D,
+	[0x2A] = KEY_LSHIFT,
+	[0x1D] = KEY_LCTRL,
+	[0x80 | 0x1C] = KEY_ENTER,	// Keypad Enter
+	[0x80 | 0x48] = KEY_UP,
+	[0x80 | 0x50] = KEY_DOWN,
+	[0x80 | 0x4B] = KEY_LEFT,
+	[0x80 | 0x4D] = KEY_RIGHT
+};
+
+// Logical keys are kept in 32 bit masks
+typedef char key_count_check[KEY_COUNT <= 32 ? 1 : -1];
+
 /**
  * Private Constructor- Assures only 1 instance is running.
  *
@@ -12,11 +49,16 @@ static Input_t * new_input() {
 
 	Input_t* Input = (Input_t*) malloc(sizeof(Input_t));
 
-	Input->keycode = NONE;
+	Input->keys_down = 0;
+	Input->keys_pressed = 0;
+	Input->keys_released = 0;
 
-	Input->RMB = 0;
-	Input->LMB = 0;
-	Input->MMB = 0;
+	unsigned button;
+	for (button = 0; button < MOUSE_NUM_BUTTONS; ++button)
+		Input->num_clicks[button] = 0;
+	Input->click_us = 0;
+	Input->motion_us = 0;
+	Input->wheel = 0;
 
 	Input->res[0] = vg_getHorRes();
 	Input->res[1] = vg_getVerRes();
@@ -28,35 +70,185 @@ static Input_t * new_input() {
 }
 
 Input_t * input_instance() {
-	if (NULL == input) {
+	if (NULL == input)
 		input = new_input();
-	} else
-		return input;
+
+	return input;
+}
+
+// Private Method -- Queues an event, stamped with the current time
+static void push_event(input_event_type_t type, uint16_t code, int dx, int dy) {
+	InputEvent_t ev;
+
+	if (REPLAY_PLAYING == replay_mode())
+		return;	// The devices are not listened to during a replay
+
+	ev.time_us = now_us();
+	ev.type = type;
+	ev.code = code;
+	ev.dx = dx;
+	ev.dy = dy;
+
+	if (input_ring_push(&events, &ev))
+		printf("push_event -> Input ring full, event dropped\n");
 }
 
 // Keyboard Handler : to be called on keyboard interrupts
 void keyboard_handler() {
 	static int byteE0 = 0; // flag corresponding to whether first byte 0xE0 was received
 
-	keycode_t tmp;
-	if ((tmp = keyboard_read()) < 0)
+	int tmp;
+	if ((tmp = keyboard_read()) < 0) {
 		printf("keyboard_handler::keyboard_read() failed\n");
+		return;
+	}
 
 	if (0xE0 == tmp) {
 		byteE0 = 1;
-	} else if (byteE0) {
-		byteE0 = 0;
-		input_instance()->keycode = (0xE0 << 8) | tmp;
+		return;
+	}
+
+	uint16_t code = byteE0 ? (0xE0 << 8) | tmp : tmp;
+	byteE0 = 0;
+
+	push_event(tmp & BIT(7) ? EV_KEY_BREAK : EV_KEY_MAKE, code, 0, 0);
+}
+
+// Private Method -- Moves the mouse, stopping at the borders
+static void input_move_mouse(Input_t * Input, int x_value, int y_value) {
+	// Flags to check whether the Border was reached
+	int validX = 1;
+	int validY = 1;
+
+	//Checking the X borders
+	if ((Input->mouse_pos[0] + x_value) < 0) {
+		Input->mouse_pos[0] = 0;
+		validX = 0;
+	} else if (Input->mouse_pos[0] + x_value >= Input->res[0]) {
+		Input->mouse_pos[0] = Input->res[0] - 1;
+		validX = 0;
+	}
+
+	//Checking the Y borders
+	if (Input->mouse_pos[1] + y_value < 0) {
+		Input->mouse_pos[1] = 0;
+		validY = 0;
+	} else if (Input->mouse_pos[1] + y_value >= Input->res[1]) {
+		Input->mouse_pos[1] = Input->res[1] - 1;
+		validY = 0;
+	}
+
+	//Only if not at the borders, should be updated
+	if (validX)
+		Input->mouse_pos[0] += x_value;
+	if (validY)
+		Input->mouse_pos[1] += y_value;
+}
+
+// Private Method -- Updates the logical key bitmaps
+static void input_key_event(Input_t * Input, uint16_t code, int make) {
+	unsigned idx = SCANCODE_IDX(code);
+	uint32_t key_bit = 1UL << scancode_keys[idx];
+
+	if (make) {
+		if (!(Input->keys_down & key_bit)) // Ignore typematic repeats
+			Input->keys_pressed |= key_bit;
+		Input->keys_down |= key_bit;
 	} else {
-		input_instance()->keycode = tmp;
+		Input->keys_released |= key_bit;
+		Input->keys_down &= ~key_bit;
+	}
+}
+
+void input_drain() {
+	Input_t * Input = input_instance();
+	InputEvent_t ev;
+	int acc_dx = 0, acc_dy = 0; // Motion not applied yet
+
+	while (0 == input_ring_pop(&events, &ev)) {
+		replay_log_event(&ev);
+
+		// Presses happen where the motion before them left the cursor
+		if (EV_MOTION != ev.type && (0 != acc_dx || 0 != acc_dy)) {
+			input_move_mouse(Input, acc_dx, acc_dy);
+			acc_dx = acc_dy = 0;
+		}
+
+		switch (ev.type) {
+		case EV_KEY_MAKE:
+			input_key_event(Input, ev.code, 1);
+			break;
+		case EV_KEY_BREAK:
+			input_key_event(Input, ev.code, 0);
+			break;
+		case EV_BUTTON_DOWN:
+			if (Input->num_clicks[ev.code] < INPUT_PENDING_CLICKS)
+				Input->clicks_us[ev.code][Input->num_clicks[ev.code]++] =
+						ev.time_us;
+			break;
+		case EV_BUTTON_UP:
+			break;
+		case EV_WHEEL:
+			Input->wheel += ev.dy;
+			break;
+		case EV_MOTION:
+			acc_dx += ev.dx;
+			acc_dy += ev.dy;
+			if (0 == Input->motion_us)
+				Input->motion_us = ev.time_us;
+			break;
+		}
+	}
+
+	if (0 != acc_dx || 0 != acc_dy)
+		input_move_mouse(Input, acc_dx, acc_dy);
+}
+
+void input_presented() {
+	Input_t * Input = input_instance();
+
+	if (0 != Input->motion_us) {
+		PROF_DELAY(PROF_PACKET_TO_PRESENT, now_us() - Input->motion_us);
+		Input->motion_us = 0;
 	}
 }
 
-// Removes keycode from Input's buffer
-keycode_t input_get_key() {
-	keycode_t tmp = input_instance()->keycode;
-	input_instance()->keycode = NONE;	// Key handled
-	return tmp;
+void input_inject(const InputEvent_t * ev) {
+	InputEvent_t tmp = *ev;
+	tmp.time_us = now_us();
+
+	if (input_ring_push(&events, &tmp))
+		printf("input_inject -> Input ring full, event dropped\n");
+}
+
+unsigned input_get_dropped() {
+	return events.dropped;
+}
+
+void move_mouse_pos(int dx, int dy) {
+	input_move_mouse(input_instance(), dx, dy);
+}
+
+void input_end_frame() {
+	Input_t * Input = input_instance();
+	Input->keys_pressed = 0;
+	Input->keys_released = 0;
+}
+
+logical_key_t scancode_to_key(uint16_t code) {
+	return (logical_key_t) scancode_keys[SCANCODE_IDX(code)];
+}
+
+int key_down(logical_key_t k) {
+	return KEY_NONE != k && 0 != (input_instance()->keys_down & (1UL << k));
+}
+
+int key_pressed_this_frame(logical_key_t k) {
+	return KEY_NONE != k && 0 != (input_instance()->keys_pressed & (1UL << k));
+}
+
+int key_released_this_frame(logical_key_t k) {
+	return KEY_NONE != k && 0 != (input_instance()->keys_released & (1UL << k));
 }
 
 //Destructor
@@ -69,78 +261,64 @@ const int * get_mouse_pos() {
 	return input_instance()->mouse_pos;
 }
 
-int get_mouseRMB() {
-	if (input_instance()->RMB) {
-		input_instance()->RMB = 0;
-		return 1;
-	} else {
+// Private Method -- Takes the oldest press of a button
+static int input_take_click(mouse_button_t button) {
+	Input_t * Input = input_instance();
+	if (0 == Input->num_clicks[button])
 		return 0;
-	}
+
+	Input->click_us = Input->clicks_us[button][0];
+	memmove(Input->clicks_us[button], Input->clicks_us[button] + 1,
+			--(Input->num_clicks[button]) * sizeof(uint64_t));
+	return 1;
+}
+
+int get_mouseRMB() {
+	return input_take_click(MOUSE_RB);
 }
 
 int get_mouseLMB() {
-	if (input_instance()->LMB) {
-		input_instance()->LMB = 0;
-		return 1;
-	} else {
-		return 0;
-	}
+	return input_take_click(MOUSE_LB);
 }
 
 int get_mouseMMB() {
-	if (input_instance()->MMB) {
-		input_instance()->MMB = 0;
-		return 1;
-	} else {
-		return 0;
-	}
+	return input_take_click(MOUSE_MB);
 }
 
-void mouse_packet_handler(unsigned char * packet) {
+int input_take_wheel() {
 	Input_t * Input = input_instance();
+	int wheel = Input->wheel;
 
-	/** Update Buttons **/
-	Input->RMB = packet[0] & BYTE0_RB;
-	Input->LMB = packet[0] & BYTE0_LB;
-	Input->MMB = packet[0] & BYTE0_MB;
+	Input->wheel = 0;
+	return wheel;
+}
 
-	/** Update Position **/
-	int x_value = int_value(packet[1], packet[0] & BYTE0_X_SIGN);
-	int y_value = int_value(packet[2], packet[0] & BYTE0_Y_SIGN);
+uint64_t input_get_click_time() {
+	return input_instance()->click_us;
+}
 
-	// Handle Overflow
-	if ((packet[0] & BYTE0_X_OVF) != 0)
-		x_value += (packet[0] & BYTE0_X_SIGN ? -255 : 255);
-	if ((packet[0] & BYTE0_Y_OVF) != 0)
-		y_value += (packet[0] & BYTE0_Y_SIGN ? -255 : 255);
+void mouse_packet_handler(const MousePacket_t * packet) {
+	static const unsigned char button_bits[MOUSE_NUM_BUTTONS] = { BYTE0_LB,
+			BYTE0_RB, BYTE0_MB };
 
-	// Flags to check whether the Border was reached
-	int validX = 1;
-	int validY = 1;
+	/** Queue Motion **/
+	// Moves first, so presses happen where the packet left the cursor
+	if (0 != packet->dx || 0 != packet->dy)
+		push_event(EV_MOTION, 0, packet->dx, -packet->dy); // PS/2 y grows upwards
+	if (0 != packet->dz)
+		push_event(EV_WHEEL, 0, 0, packet->dz);
 
-	//Checking the X borders
-	if ((Input->mouse_pos[0] + x_value) < 0) {
-		Input->mouse_pos[0] = 0;
-		validX = 0;
-	} else if (Input->mouse_pos[0] + x_value >= Input->res[0]) {
-		Input->mouse_pos[0] = Input->res[0] - 1;
-		validX = 0;
-	}
+	/** Queue Button Changes **/
+	unsigned button;
+	for (button = 0; button < MOUSE_NUM_BUTTONS; ++button) {
+		unsigned char bit = button_bits[button];
 
-	//Checking the Y borders
-	if (Input->mouse_pos[1] - y_value < 0) {
-		Input->mouse_pos[1] = 0;
-		validY = 0;
-	} else if (Input->mouse_pos[1] - y_value >= Input->res[1]) {
-		Input->mouse_pos[1] = Input->res[1] - 1;
-		validY = 0;
+		if ((packet->buttons & bit) && !(buttons_held & bit))
+			push_event(EV_BUTTON_DOWN, button, 0, 0);
+		else if (!(packet->buttons & bit) && (buttons_held & bit))
+			push_event(EV_BUTTON_UP, button, 0, 0);
 	}
-
-	//Only if not at the borders, should be updated
-	if (validX)
-		Input->mouse_pos[0] += x_value;
-	if (validY)
-		Input->mouse_pos[1] -= y_value;
+	buttons_held = packet->buttons;
 }
 
 int mouse_inside_rect(int x_initial, int y_initial, int x_final, int y_final) {
@@ -6,33 +6,61 @@
  * Functions for manipulating all the Inputs from the user/ player
  */
 
+#include <stdint.h>
 #include "i8042.h"
 #include "keyboard.h"
 #include "mouse.h"
+#include "InputRing.h"
 
 /**
- * Keyboard scan codes that should be recognized
+ * Logical keys, translated from the set-1 scancodes by a compile-time table
  */
 typedef enum {
-	ESC_BREAK = ESC_BREAK_CODE,
-	ENTER_BREAK = ENTER_BREAK_CODE,
-	UP_MAKE = UP_MAKE_CODE,
-	DOWN_MAKE = DOWN_MAKE_CODE,
-	NO_KEY = 0x0
-} keycode_t;
+	KEY_NONE,	///> Scancode with no logical key
+	KEY_ESC,
+	KEY_ENTER,
+	KEY_SPACE,
+	KEY_UP,
+	KEY_DOWN,
+	KEY_LEFT,
+	KEY_RIGHT,
+	KEY_W,
+	KEY_A,
+	KEY_S,
+	KEY_D,
+	KEY_LSHIFT,
+	KEY_LCTRL,
+	KEY_COUNT
+} logical_key_t;
+
+#define INPUT_SCANCODES			256	/**< @brief Normal codes in the lower half, 0xE0 codes in the upper one */
+#define INPUT_PENDING_CLICKS	8	/**< @brief Most presses of a button waiting to be handled */
+
+/**
+ * Mouse buttons
+ */
+typedef enum {
+	MOUSE_LB, MOUSE_RB, MOUSE_MB, MOUSE_NUM_BUTTONS
+} mouse_button_t;
 
 /**
  * @brief Structure that keeps record of all the user input information
+ *
+ * Filled from the input events by input_drain(), once per frame
  */
 typedef struct {
 
-	keycode_t keycode; ///> Current keyboard key
+	uint32_t keys_down; ///> Bit per logical key, set while it is held
+	uint32_t keys_pressed; ///> Logical keys pressed since the last input_end_frame()
+	uint32_t keys_released; ///> Logical keys released since the last input_end_frame()
 
-	int RMB; ///> Flag for Right Mouse Button (pressed or not)
-	int LMB; ///> Flag for Left Mouse Button (pressed or not)
-	int MMB; ///> Flag for Middle Mouse Button (pressed or not)
+	uint64_t clicks_us[MOUSE_NUM_BUTTONS][INPUT_PENDING_CLICKS]; ///> Time of the presses not handled yet, oldest first
+	unsigned num_clicks[MOUSE_NUM_BUTTONS]; ///> Number of presses not handled yet, per button
+	uint64_t click_us; ///> Time of the last press handled
 
 	int mouse_pos[2]; ///> Current position of the mouse onn screen (x,y)
+	uint64_t motion_us; ///> Time of the oldest motion not presented yet, 0 if none
+	int wheel; ///> Wheel notches not handled yet
 
 	unsigned res[2]; ///> Resolution of the screen
 } Input_t;
@@ -51,16 +79,81 @@ void delete_input();
 
 /**
  * @brief Keyboard Interrupt Handler
- * Compatible with single and double-byte keycodes
+ * Compatible with single and double-byte keycodes. Queues a timestamped event
  */
 void keyboard_handler();
 
 /**
- * @brief Remove's the key code from the input buffer
+ * @brief Handles every input event queued by the interrupt handlers.
+ * To be called once per frame, before the input is read
+ *
+ * Consecutive motion events are added up and applied at once, so the packets of a
+ * frame move the cursor like a single one
+ */
+void input_drain();
+
+/**
+ * @brief Tells the input a frame was presented, measuring how long the motion it shows waited.
+ * To be called right after the frame buffer is flipped
+ */
+void input_presented();
+
+/**
+ * @brief Queues an event as if an interrupt handler had, stamped with the current time.
+ * Used to play recorded input back
+ *
+ * @param ev Event to queue
+ */
+void input_inject(const InputEvent_t * ev);
+
+/**
+ * @brief Gets the number of input events lost because the frame handler fell behind
  *
- * @return Keycode to be handled
+ * @return Events dropped since the start
  */
-keycode_t input_get_key();
+unsigned input_get_dropped();
+
+/**
+ * @brief Ends the current input frame, clearing the pressed and released keys.
+ * To be called once the input of the frame was read
+ */
+void input_end_frame();
+
+/**
+ * @brief Translates a scancode into a logical key, in O(1)
+ *
+ * @param code Scancode, with the 0xE0 prefix in the upper byte if there is one. Make or break code
+ *
+ * @return Logical key, KEY_NONE if the scancode is not mapped
+ */
+logical_key_t scancode_to_key(uint16_t code);
+
+/**
+ * @brief Checks whether a logical key is being held, in O(1)
+ *
+ * @param k Logical key
+ *
+ * @return Non zero if held, 0 otherwise
+ */
+int key_down(logical_key_t k);
+
+/**
+ * @brief Checks whether a logical key was pressed in the current input frame, in O(1)
+ *
+ * @param k Logical key
+ *
+ * @return Non zero if pressed, 0 otherwise. A key both pressed and released within the frame counts
+ */
+int key_pressed_this_frame(logical_key_t k);
+
+/**
+ * @brief Checks whether a logical key was released in the current input frame, in O(1)
+ *
+ * @param k Logical key
+ *
+ * @return Non zero if released, 0 otherwise
+ */
+int key_released_this_frame(logical_key_t k);
 
 /**
  * @brief Gets the current mouse position on the screen
@@ -70,34 +163,56 @@ keycode_t input_get_key();
 const int * get_mouse_pos();
 
 /**
- * @brief Gets the current state of the mouse right button
+ * @brief Moves the mouse position, as a mouse motion would, stopping at the borders of the screen
  *
- * @return Return 0 if mouse right button is not pressed, non zero otherwise
+ * @param dx Pixels to the right
+ * @param dy Pixels down
+ */
+void move_mouse_pos(int dx, int dy);
+
+/**
+ * @brief Takes the oldest press of the mouse right button not handled yet
+ *
+ * @return Return 0 if mouse right button was not pressed, non zero otherwise
  */
 int get_mouseRMB();
 
 /**
- * @brief Gets the current state of the mouse left button
+ * @brief Takes the oldest press of the mouse left button not handled yet
  *
- * @return Return 0 if mouse left button is not pressed, non zero otherwise
+ * @return Return 0 if mouse left button was not pressed, non zero otherwise
  */
 int get_mouseLMB();
 
 /**
- * @brief Gets the current state of the mouse middle button
+ * @brief Takes the oldest press of the mouse middle button not handled yet
  *
- * @return Return 0 if mouse middle button is not pressed, non zero otherwise
+ * @return Return 0 if mouse middle button was not pressed, non zero otherwise
  */
 int get_mouseMMB();
 
 /**
- * @brief Mouse Interrupt Handler
+ * @brief Takes the wheel motion not handled yet
+ *
+ * @return Notches turned since the last call, positive towards the user
+ */
+int input_take_wheel();
+
+/**
+ * @brief Gets the time of the last press taken by get_mouseLMB(), get_mouseRMB() or get_mouseMMB()
+ *
+ * @return now_us() when the press was received
+ */
+uint64_t input_get_click_time();
+
+/**
+ * @brief Mouse Packet Handler, called for every valid packet
  *
- * Reads the packet received and updates the Input instance accordingly
+ * Queues the button, motion and wheel events the packet holds
  *
  * @param packet mouse packet containing the mouse information
  */
-void mouse_packet_handler(unsigned char * packet);
+void mouse_packet_handler(const MousePacket_t * packet);
 
 /**
  * @brief Verifies if the Mouse is inside a certain rectangle
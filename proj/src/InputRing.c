@@ -0,0 +1,42 @@
+#include "InputRing.h"
+
+#define INPUT_RING_MASK		(INPUT_RING_SIZE - 1)
+
+void input_ring_init(InputRing_t * ring) {
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+}
+
+int input_ring_push(InputRing_t * ring, const InputEvent_t * ev) {
+	unsigned head = ring->head;
+
+	if (head - ring->tail >= INPUT_RING_SIZE) {
+		++(ring->dropped);
+		return 1;
+	}
+
+	ring->events[head & INPUT_RING_MASK] = *ev;
+	INPUT_RING_BARRIER();	// Slot written before it is published
+	ring->head = head + 1;
+
+	return 0;
+}
+
+int input_ring_pop(InputRing_t * ring, InputEvent_t * ev) {
+	unsigned tail = ring->tail;
+
+	if (tail == ring->head)
+		return 1;
+
+	INPUT_RING_BARRIER();	// Head read before the slot it publishes
+	*ev = ring->events[tail & INPUT_RING_MASK];
+	INPUT_RING_BARRIER();	// Slot read before it is released
+	ring->tail = tail + 1;
+
+	return 0;
+}
+
+unsigned input_ring_size(InputRing_t * ring) {
+	return ring->head - ring->tail;
+}
@@ -0,0 +1,95 @@
+#ifndef __INPUT_RING_H
+#define __INPUT_RING_H
+
+/** @defgroup InputRing InputRing
+ * @{
+ * Single-producer/single-consumer ring buffer of timestamped input events.
+ *
+ * The interrupt handlers produce, the frame handler consumes. Neither side ever
+ * writes the other's index, so no lock is needed: the producer fills a slot before
+ * publishing it, the consumer reads a slot before releasing it.
+ */
+
+#include <stdint.h>
+
+#define INPUT_RING_SIZE		256		/**< @brief Capacity of the ring, must be a power of two */
+
+/**
+ * Compiler barrier. Enough on x86, which never reorders stores with other stores
+ * nor loads with other loads
+ */
+#define INPUT_RING_BARRIER()	__asm__ __volatile__("" ::: "memory")
+
+/**
+ * Kinds of input events
+ */
+typedef enum {
+	EV_KEY_MAKE,		///> Key pressed, code holds the scancode
+	EV_KEY_BREAK,		///> Key released, code holds the scancode
+	EV_BUTTON_DOWN,		///> Mouse button pressed, code holds the button
+	EV_BUTTON_UP,		///> Mouse button released, code holds the button
+	EV_MOTION,			///> Mouse moved by (dx, dy), in screen coordinates
+	EV_WHEEL			///> Mouse wheel turned by dy notches, positive towards the user
+} input_event_type_t;
+
+/**
+ * @brief An input event, as seen by the interrupt handler
+ */
+typedef struct {
+	uint64_t time_us;	///> now_us() when the interrupt was handled
+	uint16_t type;		///> One of input_event_type_t
+	uint16_t code;		///> Scancode (0xE0 prefixed codes included) or button
+	int16_t dx;			///> Horizontal motion, positive to the right
+	int16_t dy;			///> Vertical motion, positive downwards
+} InputEvent_t;
+
+/**
+ * @brief The ring itself. Fixed storage, so producing never allocates
+ */
+typedef struct {
+	InputEvent_t events[INPUT_RING_SIZE];
+
+	volatile unsigned head;		///> Events ever pushed, only written by the producer
+	volatile unsigned tail;		///> Events ever popped, only written by the consumer
+	volatile unsigned dropped;	///> Events lost because the ring was full, producer side
+} InputRing_t;
+
+/**
+ * @brief Empties a ring
+ *
+ * @param ring Ring to initialize. No producer nor consumer may be using it
+ */
+void input_ring_init(InputRing_t * ring);
+
+/**
+ * @brief Appends an event. Producer side only
+ *
+ * @param ring Ring in question
+ * @param ev Event to copy
+ *
+ * @return Return 0 upon success, non-zero if the ring was full and the event was dropped
+ */
+int input_ring_push(InputRing_t * ring, const InputEvent_t * ev);
+
+/**
+ * @brief Takes the oldest event. Consumer side only
+ *
+ * @param ring Ring in question
+ * @param ev Where to copy the event to
+ *
+ * @return Return 0 upon success, non-zero if the ring was empty
+ */
+int input_ring_pop(InputRing_t * ring, InputEvent_t * ev);
+
+/**
+ * @brief Gets the number of events waiting in a ring
+ *
+ * @param ring Ring in question
+ *
+ * @return Number of events pushed and not yet popped
+ */
+unsigned input_ring_size(InputRing_t * ring);
+
+/**@}*/
+
+#endif /* __INPUT_RING_H */
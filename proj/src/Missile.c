@@ -1,9 +1,12 @@
-#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include "Missile.h"
+#include "Fixed.h"
 #include "video_gr.h"
 #include "BMPsHolder.h"
+#include "Random.h"
 
 /**
  * Structs
@@ -21,13 +24,15 @@ typedef enum {
  */
 struct missile_t {
 	int init_pos[2]; ///> Initial Position for Missile Trail
-	int pos[2];	///> Current Position
+	fixed_t pos[2];	///> Current Position, 16.16
+	fixed_t prev_pos[2];	///> Position before the last update, for render interpolation
 
-	float velocity[2]; ///> Velocity, in pixels PER frame
-	float pending_movement[2]; ///> Movement left unperformed on the previous frame
+	fixed_t velocity[2]; ///> Velocity, in pixels PER frame, 16.16
 
 	uint16_t color; ///> Color in RGB 5:6:5
 
+	unsigned id; ///> Unique identifier, increasing with creation order
+
 	/* Attributes for Friendly Missile */
 	bool isFriendly;
 	int end_pos[2];
@@ -38,46 +43,39 @@ struct missile_t {
  * Structure used to define explosions
  */
 struct explosion_t {
-	int pos[2]; ///> Center position of Explosion (x,y)
-	int radius; ///> Radius of Explosion
+	fixed_t pos[2]; ///> Center position of Explosion (x,y), 16.16
 
 	Bitmap ** bmps; ///> Explosion Animation
-	unsigned curr_bmp_index; ///> current bitmap being displayed
-	unsigned no_bmps; ///> Explosion ended
-	unsigned frame_count;
-	unsigned frames_per_bmp;
+	unsigned no_bmps; ///> Number of bitmaps in the animation
+	unsigned frames_per_bmp; ///> Frames each bitmap is displayed
+	unsigned long start_frame; ///> Frame in which the animation started
 };
 
 /**
  * END of Structs
  */
 
-/**
- * Rounds float to nearest integer
- */
-int round_float(float f) {
-	return (f > (floor(f) + 0.5)) ? ceil(f) : floor(f);
-}
-
 /**
  * Methods for Missile
  */
 
+static unsigned next_missile_id = 1; // 0 is never a valid id
+
 /**
  * Constructor for Generic Missile
  */
-static Missile * new_missile(const int * init_pos, const float * vel) {
+static Missile * new_missile(const int * init_pos, const fixed_t * vel) {
 	Missile * m_ptr = (Missile *) malloc(sizeof(Missile));
 
 	memmove(m_ptr->init_pos, init_pos, 2 * sizeof(int));
-	memmove(m_ptr->pos, init_pos, 2 * sizeof(int));
-
-	memmove(m_ptr->velocity, vel, 2 * sizeof(float));
+	m_ptr->pos[0] = INT_TO_FIXED(init_pos[0]);
+	m_ptr->pos[1] = INT_TO_FIXED(init_pos[1]);
+	memmove(m_ptr->prev_pos, m_ptr->pos, 2 * sizeof(fixed_t));
 
-	m_ptr->pending_movement[0] = 0.;
-	m_ptr->pending_movement[1] = 0.;
+	memmove(m_ptr->velocity, vel, 2 * sizeof(fixed_t));
 
 	m_ptr->color = WHITE; // White, to be changed on enemy/friendly constructor
+	m_ptr->id = next_missile_id++;
 
 	return m_ptr;
 }
@@ -86,32 +84,36 @@ static Missile * new_missile(const int * init_pos, const float * vel) {
  * Constructor for Enemy Missile
  */
 Missile * new_emissile(const unsigned * bases_pos, const unsigned * bases_hp) {
-	int init_pos[2] = { rand() % (vg_getHorRes() - 100) + 50, 0 };
-	unsigned base_to_attack = rand() % 3;
+	uint32_t draws[EMISSILE_DRAWS];
+
+	rng_fill(rng_stream(RNG_SPAWN), draws, EMISSILE_DRAWS);
+	return new_emissile_from(bases_pos, bases_hp, draws);
+}
+
+Missile * new_emissile_from(const unsigned * bases_pos,
+		const unsigned * bases_hp, const uint32_t * draws) {
+	int init_pos[2] = { RNG_BOUND(draws[0], vg_getHorRes() - 100) + 50, 0 };
+	unsigned base_to_attack = RNG_BOUND(draws[1], 3);
 
 	while (bases_hp[base_to_attack] == 0) // if dead select another
 		base_to_attack = (base_to_attack + 1) % 3;
 
 	// target random position around the base
-	float end_pos[2] = { bases_pos[base_to_attack]
-			+ 0.9 * BUILDING_SIZE_X
-					/ (rand() % 2 ? rand() % 9 - 10 : rand() % 9 + 2),
-			vg_getVerRes() };
-
-	float vel[2];
-	float magnitude = sqrt(
-			(((float) end_pos[0] - (float) init_pos[0])
-					* ((float) end_pos[0] - (float) init_pos[0]))
-					+ (((float) end_pos[0] - (float) init_pos[1])
-							* ((float) end_pos[1] - (float) init_pos[1])));
-
-	float rand_multiplier = (10. + (float) (rand() % 10)) / 10.;
-	vel[0] = (rand_multiplier / magnitude)
-			* ((float) end_pos[0] - (float) init_pos[0]);
-	vel[1] = (rand_multiplier / magnitude)
-			* ((float) end_pos[1] - (float) init_pos[1]);
-
-	printf("New Enemy Missile Vel: %d, %d\n", (int) vel[0], (int) vel[1]);
+	int divisor = RNG_BOUND(draws[2], 2) ?
+			(int) RNG_BOUND(draws[3], 9) - 10 : (int) RNG_BOUND(draws[3], 9) + 2;
+	fixed_t end_pos[2] = { INT_TO_FIXED(bases_pos[base_to_attack])
+			+ INT_TO_FIXED(9 * BUILDING_SIZE_X / 10) / divisor,
+	INT_TO_FIXED(vg_getVerRes()) };
+
+	// Speed between 1.0 and 1.9 pixels per frame
+	fixed_t speed = INT_TO_FIXED(10 + RNG_BOUND(draws[4], 10)) / 10;
+
+	fixed_t vel[2];
+	fixed_normalize(end_pos[0] - INT_TO_FIXED(init_pos[0]),
+			end_pos[1] - INT_TO_FIXED(init_pos[1]), speed, vel);
+
+	printf("New Enemy Missile Vel: %d, %d\n", fixed_to_int(vel[0]),
+			fixed_to_int(vel[1]));
 
 	Missile * m_ptr = new_missile(init_pos, vel);
 	m_ptr->color = RED;
@@ -123,15 +125,10 @@ Missile * new_emissile(const unsigned * bases_pos, const unsigned * bases_hp) {
  * Constructor for Friendly Missile
  */
 Missile * new_fmissile(const int * init_pos, const int * mouse_pos) {
-	float vel[2];
-	float magnitude = sqrt(
-			(((float) mouse_pos[0] - (float) init_pos[0])
-					* ((float) mouse_pos[0] - (float) init_pos[0]))
-					+ (((float) mouse_pos[0] - (float) init_pos[1])
-							* ((float) mouse_pos[1] - (float) init_pos[1])));
-	vel[0] = (4. / magnitude) * ((float) mouse_pos[0] - (float) init_pos[0]);
-	vel[1] = (4. / magnitude) * ((float) mouse_pos[1] - (float) init_pos[1]);
+	fixed_t vel[2];
 	// Velocity for Friendly Missiles is constant -- 4 pixels per frame
+	fixed_normalize(INT_TO_FIXED(mouse_pos[0] - init_pos[0]),
+			INT_TO_FIXED(mouse_pos[1] - init_pos[1]), INT_TO_FIXED(4), vel);
 
 	Missile * m_ptr = new_missile(init_pos, vel);
 	m_ptr->color = YELLOW;
@@ -141,8 +138,10 @@ Missile * new_fmissile(const int * init_pos, const int * mouse_pos) {
 	return m_ptr;
 }
 
+static Explosion * new_explosion_fixed(const fixed_t * position);
+
 Explosion * delete_missile(Missile * m_ptr) {
-	Explosion * exp = new_explosion(m_ptr->pos);
+	Explosion * exp = new_explosion_fixed(m_ptr->pos);
 
 	free(m_ptr);
 
@@ -152,25 +151,15 @@ Explosion * delete_missile(Missile * m_ptr) {
 // Returns 1 if missile is to be deleted
 int missile_update(Missile * m_ptr) {
 
-	//Update Pending Movement
-	m_ptr->pending_movement[0] += m_ptr->velocity[0];
-	m_ptr->pending_movement[1] += m_ptr->velocity[1];
-
 	//Update Position
-	int tmp;
-	if (abs(tmp = round_float(m_ptr->pending_movement[0])) > 1) {
-		m_ptr->pos[0] += tmp;
-		m_ptr->pending_movement[0] -= tmp;
-	}
-	if (abs(tmp = round_float(m_ptr->pending_movement[1])) > 1) {
-		m_ptr->pos[1] += tmp;
-		m_ptr->pending_movement[1] -= tmp;
-	}
+	memmove(m_ptr->prev_pos, m_ptr->pos, 2 * sizeof(fixed_t));
+	m_ptr->pos[0] += m_ptr->velocity[0];
+	m_ptr->pos[1] += m_ptr->velocity[1];
 
 	// IF is Friendly Missile
 	if (m_ptr->isFriendly == TRUE) {
-		if (abs(m_ptr->pos[0] - m_ptr->end_pos[0]) < 4
-				&& abs(m_ptr->pos[1] - m_ptr->end_pos[1]) < 4) {
+		if (abs(missile_getPosX(m_ptr) - m_ptr->end_pos[0]) < 4
+				&& abs(missile_getPosY(m_ptr) - m_ptr->end_pos[1]) < 4) {
 			printf("\tFriendly Missile Reached End-Pos\n");
 			return 1; // Reached End Pos -- Should Explode
 		}
@@ -179,16 +168,23 @@ int missile_update(Missile * m_ptr) {
 	return 0;
 }
 
+void missile_getDrawPos(Missile * m_ptr, fixed_t alpha, int * pos) {
+	pos[0] = fixed_round(m_ptr->prev_pos[0]
+			+ fixed_mul(m_ptr->pos[0] - m_ptr->prev_pos[0], alpha));
+	pos[1] = fixed_round(m_ptr->prev_pos[1]
+			+ fixed_mul(m_ptr->pos[1] - m_ptr->prev_pos[1], alpha));
+}
+
 int missile_isFriendly(Missile * m_ptr) {
 	return (m_ptr->isFriendly == TRUE ? 1 : 0);
 }
 
 int missile_getPosX(Missile * m_ptr) {
-	return m_ptr->pos[0];
+	return fixed_round(m_ptr->pos[0]);
 }
 
 int missile_getPosY(Missile * m_ptr) {
-	return m_ptr->pos[1];
+	return fixed_round(m_ptr->pos[1]);
 }
 
 int missile_getInitX(Missile * m_ptr) {
@@ -203,56 +199,116 @@ uint16_t missile_getColor(Missile * m_ptr) {
 	return m_ptr->color;
 }
 
+unsigned missile_getId(Missile * m_ptr) {
+	return m_ptr->id;
+}
+
 size_t missile_getSizeOf() {
 	return sizeof(Missile);
 }
 
+void missile_getState(Missile * m_ptr, MissileState_t * state) {
+	memmove(state->pos, m_ptr->pos, 2 * sizeof(fixed_t));
+	memmove(state->prev_pos, m_ptr->prev_pos, 2 * sizeof(fixed_t));
+	memmove(state->velocity, m_ptr->velocity, 2 * sizeof(fixed_t));
+	state->init_pos[0] = m_ptr->init_pos[0];
+	state->init_pos[1] = m_ptr->init_pos[1];
+	state->end_pos[0] = m_ptr->isFriendly == TRUE ? m_ptr->end_pos[0] : 0;
+	state->end_pos[1] = m_ptr->isFriendly == TRUE ? m_ptr->end_pos[1] : 0;
+	state->id = m_ptr->id;
+	state->color = m_ptr->color;
+	state->friendly = m_ptr->isFriendly == TRUE;
+}
+
+void missile_setState(Missile * m_ptr, const MissileState_t * state) {
+	memmove(m_ptr->pos, state->pos, 2 * sizeof(fixed_t));
+	memmove(m_ptr->prev_pos, state->prev_pos, 2 * sizeof(fixed_t));
+	memmove(m_ptr->velocity, state->velocity, 2 * sizeof(fixed_t));
+	m_ptr->init_pos[0] = state->init_pos[0];
+	m_ptr->init_pos[1] = state->init_pos[1];
+	m_ptr->end_pos[0] = state->end_pos[0];
+	m_ptr->end_pos[1] = state->end_pos[1];
+	m_ptr->id = state->id;
+	m_ptr->color = state->color;
+	m_ptr->isFriendly = state->friendly ? TRUE : FALSE;
+}
+
+unsigned missile_getNextId() {
+	return next_missile_id;
+}
+
+void missile_setNextId(unsigned id) {
+	next_missile_id = id;
+}
+
 /**
  * Methods for Explosion
  */
 
-Explosion * new_explosion(const int * position) {
+static Explosion * new_explosion_fixed(const fixed_t * position) {
 	Explosion * self = (Explosion *) malloc(sizeof(Explosion));
+	ExplosionState_t state;
 
-	memmove(self->pos, position, 2 * sizeof(int));
-	self->frame_count = 0;
-	self->curr_bmp_index = 0;
-	self->frames_per_bmp = 5;
-	self->no_bmps = 16;
-	self->radius = 28;
-
-	self->bmps = BMPsHolder()->explosion;
+	memmove(state.pos, position, 2 * sizeof(fixed_t));
+	state.start_frame = 0;
+	explosion_setState(self, &state);
 
 	return self;
 }
 
+void explosion_getState(Explosion * e_ptr, ExplosionState_t * state) {
+	memmove(state->pos, e_ptr->pos, 2 * sizeof(fixed_t));
+	state->start_frame = e_ptr->start_frame;
+}
+
+void explosion_setState(Explosion * e_ptr, const ExplosionState_t * state) {
+	memmove(e_ptr->pos, state->pos, 2 * sizeof(fixed_t));
+	e_ptr->frames_per_bmp = 6;
+	e_ptr->no_bmps = 16;
+	e_ptr->start_frame = state->start_frame;
+
+	e_ptr->bmps = BMPsHolder()->explosion;
+}
+
+Explosion * new_explosion(const int * position) {
+	fixed_t pos[2] = { INT_TO_FIXED(position[0]), INT_TO_FIXED(position[1]) };
+
+	return new_explosion_fixed(pos);
+}
+
 void delete_explosion(Explosion * e_ptr) {
 	free(e_ptr);
 }
 
-int explosion_update(Explosion * e_ptr) {
-	if (++(e_ptr->frame_count) > e_ptr->frames_per_bmp) {
-		e_ptr->frame_count = 0;
-		--(e_ptr->radius);	// Update radius (!)
-							// Radius diminishes roughly proportionally to the increase of bmp idx
-		if (++(e_ptr->curr_bmp_index) >= e_ptr->no_bmps) {
-			return 1; // return 1 indicates the animation finished, e_ptr should be deleted
-		}
-	}
+void explosion_setStartFrame(Explosion * e_ptr, unsigned long frame) {
+	e_ptr->start_frame = frame;
+}
 
-	return 0;
+unsigned long explosion_getEndFrame(Explosion * e_ptr) {
+	return e_ptr->start_frame + e_ptr->no_bmps * e_ptr->frames_per_bmp;
+}
+
+// Animation state is a function of the explosion's age, nothing is updated per frame
+static unsigned explosion_bmpIndex(Explosion * e_ptr, unsigned long frame) {
+	unsigned long idx = (frame - e_ptr->start_frame) / e_ptr->frames_per_bmp;
+	return idx < e_ptr->no_bmps ? idx : e_ptr->no_bmps - 1;
+}
+
+int explosion_getRadius(Explosion * e_ptr, unsigned long frame) {
+	// Radius diminishes roughly proportionally to the increase of bmp idx
+	return EXPLOSION_RADIUS - (int) explosion_bmpIndex(e_ptr, frame);
 }
 
-Bitmap * explosion_getBitmap(Explosion * e_ptr) {
-	return e_ptr->bmps[e_ptr->curr_bmp_index];
+Bitmap * explosion_getBitmap(Explosion * e_ptr, unsigned long frame) {
+	return e_ptr->bmps[explosion_bmpIndex(e_ptr, frame)];
 }
 
 int explosion_getPosX(Explosion * e_ptr) {
-	return e_ptr->pos[0];
+	return fixed_round(e_ptr->pos[0]);
 }
 
 int explosion_getPosY(Explosion * e_ptr) {
-	return e_ptr->pos[1];
+	return fixed_round(e_ptr->pos[1]);
 }
 
 size_t explosion_getSizeOf() {
@@ -261,21 +317,85 @@ size_t explosion_getSizeOf() {
 
 /* Collisions */
 
-int missile_collidedWithExplosion(Missile * m_ptr, Explosion * e_ptr) {
-	int x_var = (m_ptr->pos[0] - e_ptr->pos[0]);
-	int y_var = (m_ptr->pos[1] - e_ptr->pos[1]);
+int missile_collidedWithExplosion(Missile * m_ptr, Explosion * e_ptr,
+		unsigned long frame) {
+	int64_t x_var = (m_ptr->pos[0] - e_ptr->pos[0]);
+	int64_t y_var = (m_ptr->pos[1] - e_ptr->pos[1]);
+	int64_t radius = INT_TO_FIXED(explosion_getRadius(e_ptr, frame));
 
-	if (x_var * x_var + y_var * y_var <= e_ptr->radius * e_ptr->radius)	//x²+y² <= r²
+	if (x_var * x_var + y_var * y_var <= radius * radius)	//x²+y² <= r²
 		return 1;
 	else
 		return 0;
 }
 
+/* Impact Prediction */
+
+/**
+ * Pixels added around every predicted target, so the prediction stays conservative.
+ * Collisions are checked with the rounded pixel position, not the exact one.
+ */
+#define IMPACT_MARGIN	2
+
+/**
+ * Intersects the trajectory, on one axis, with the interval [lo, hi].
+ * Narrows [*enter, *exit] (in 16.16 frames) accordingly; returns 0 if it never intersects.
+ */
+static int clip_axis(fixed_t pos, fixed_t vel, fixed_t lo, fixed_t hi,
+		int64_t * enter, int64_t * exit) {
+	if (0 == vel)
+		return (pos >= lo && pos <= hi);
+
+	int64_t t1 = ((int64_t) (lo - pos) * FIXED_ONE) / vel;
+	int64_t t2 = ((int64_t) (hi - pos) * FIXED_ONE) / vel;
+	if (t1 > t2) {
+		int64_t tmp = t1;
+		t1 = t2;
+		t2 = tmp;
+	}
+
+	if (t1 > *enter)
+		*enter = t1;
+	if (t2 < *exit)
+		*exit = t2;
+
+	return *enter <= *exit;
+}
+
+long missile_framesToRect(Missile * ptr, unsigned posX, unsigned posY,
+		unsigned sizeX, unsigned sizeY) {
+	int64_t enter = 0, exit = INT64_MAX;
+
+	if (!clip_axis(ptr->pos[0], ptr->velocity[0],
+			INT_TO_FIXED((int) posX - IMPACT_MARGIN),
+			INT_TO_FIXED((int) (posX + sizeX) + IMPACT_MARGIN), &enter, &exit))
+		return -1;
+	if (!clip_axis(ptr->pos[1], ptr->velocity[1],
+			INT_TO_FIXED((int) (posY - sizeY) - IMPACT_MARGIN),
+			INT_TO_FIXED((int) posY + IMPACT_MARGIN), &enter, &exit))
+		return -1;
+
+	return (long) (enter / FIXED_ONE);	// enter >= 0, rounds down
+}
+
+long missile_framesToGround(Missile * ptr, unsigned groundY) {
+	fixed_t ground = INT_TO_FIXED((int) groundY - IMPACT_MARGIN);
+
+	if (ptr->pos[1] > ground)
+		return 0;
+	if (ptr->velocity[1] <= 0)
+		return -1;	// Never reaches the ground
+
+	return (long) ((ground - ptr->pos[1]) / ptr->velocity[1]);
+}
+
 // (posX, posY) indicates the lower-left point of the rectangle
 int missile_collidedWithRect(Missile * ptr, unsigned posX, unsigned posY,
 		unsigned sizeX, unsigned sizeY) {
-	if (ptr->pos[0] > posX && ptr->pos[0] < (posX + sizeX) && ptr->pos[1] < posY
-			&& ptr->pos[1] > posY - sizeY) {
+	int x = missile_getPosX(ptr), y = missile_getPosY(ptr);
+
+	if (x > (int) posX && x < (int) (posX + sizeX) && y < (int) posY
+			&& y > (int) (posY - sizeY)) {
 		return 1;
 	} else {
 		return 0;
@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include "Bitmap.h"
+#include "Fixed.h"
 
 struct missile_t;
 typedef struct missile_t Missile;
@@ -15,6 +16,31 @@ typedef struct missile_t Missile;
 struct explosion_t;
 typedef struct explosion_t Explosion;
 
+/**
+ * @brief Plain copy of the state of a Missile, for snapshots
+ */
+typedef struct {
+	fixed_t pos[2];			///> Current Position, 16.16
+	fixed_t prev_pos[2];	///> Position before the last update
+	fixed_t velocity[2];	///> Velocity, in pixels per frame, 16.16
+	int16_t init_pos[2];	///> Initial Position
+	int16_t end_pos[2];		///> Target, friendly missiles only
+	uint32_t id;			///> Unique identifier
+	uint16_t color;			///> Color in RGB 5:6:5
+	uint16_t friendly;		///> Non zero for friendly missiles
+} MissileState_t;
+
+/**
+ * @brief Plain copy of the state of an Explosion, for snapshots
+ */
+typedef struct {
+	fixed_t pos[2];			///> Center position, 16.16
+	uint32_t start_frame;	///> Frame in which the animation started
+} ExplosionState_t;
+
+#define EMISSILE_DRAWS		5	/**< @brief Random values an enemy missile is built from */
+#define EXPLOSION_RADIUS	28	/**< @brief Initial radius of an Explosion, shrinks along the animation */
+
 /* Missile's Methods */
 
 /**
@@ -27,6 +53,18 @@ typedef struct explosion_t Explosion;
  */
 Missile * new_emissile(const unsigned * bases_pos, const unsigned * bases_hp);
 
+/**
+ * @brief Generates a new enemy missile from values already drawn, for spawning in bulk
+ *
+ * @param bases_pos Array containing the bases' positions, so the missile can randomly target one
+ * @param bases_hp Array containing the bases' Health Points, to avoid dead bases
+ * @param draws EMISSILE_DRAWS values drawn from the RNG_SPAWN stream
+ *
+ * @return Pointer to the the newly created enemy missile
+ */
+Missile * new_emissile_from(const unsigned * bases_pos,
+		const unsigned * bases_hp, const uint32_t * draws);
+
 /**
  * @brief Generates a new friendly missile
  *
@@ -53,6 +91,36 @@ Missile * new_fmissile(const int * init_pos, const int * mouse_pos);
  */
 size_t missile_getSizeOf();
 
+/**
+ * @brief Copies the state of a Missile
+ *
+ * @param ptr Pointer to the Missile in question
+ * @param state Filled with its state
+ */
+void missile_getState(Missile * ptr, MissileState_t * state);
+
+/**
+ * @brief Overwrites a Missile with a copied state
+ *
+ * @param ptr Pointer to the Missile, or to missile_getSizeOf() bytes of uninitialised memory
+ * @param state State to copy
+ */
+void missile_setState(Missile * ptr, const MissileState_t * state);
+
+/**
+ * @brief Gets the id the next Missile created will have
+ *
+ * @return Next id
+ */
+unsigned missile_getNextId();
+
+/**
+ * @brief Sets the id the next Missile created will have, when restoring a snapshot
+ *
+ * @param id Next id
+ */
+void missile_setNextId(unsigned id);
+
 /**
  * @brief Gets the position in the horizontal axis of the Missile, on the screen
  *
@@ -98,6 +166,17 @@ int missile_getInitY(Missile * ptr);
  */
 uint16_t missile_getColor(Missile * ptr);
 
+/**
+ * @brief Gets the unique identifier of the Missile
+ *
+ * Identifiers grow with creation order, so a container filled in spawn order stays sorted by id
+ *
+ * @param ptr Pointer to the Missile in question
+ *
+ * @return Identifier of the Missile, never 0
+ */
+unsigned missile_getId(Missile * ptr);
+
 /**
  * @brief Updates the Missile,  more specifically its position on the screen
  *
@@ -107,6 +186,15 @@ uint16_t missile_getColor(Missile * ptr);
  */
 int missile_update(Missile * ptr);
 
+/**
+ * @brief Gets the on-screen position of the Missile, between its last two updates
+ *
+ * @param ptr Pointer to the Missile in question
+ * @param alpha Fraction of an update elapsed since the last one, in [0, 1), 16.16
+ * @param pos Array to fill with the interpolated position (x,y)
+ */
+void missile_getDrawPos(Missile * ptr, fixed_t alpha, int * pos);
+
 /**
  * @brief Checks if a Missile is friendly
  *
@@ -137,22 +225,41 @@ Explosion * delete_missile(Missile * ptr);
 Explosion * new_explosion(const int * position);
 
 /**
- * @brief Updates the Explosion, more specifically the radius of the explosion its animation
+ * @brief Sets the frame in which the Explosion's animation starts
  *
  * @param ptr Pointer to the Explosion in question
+ * @param frame Current frame
+ */
+void explosion_setStartFrame(Explosion * ptr, unsigned long frame);
+
+/**
+ * @brief Gets the frame in which the Explosion's animation ends
  *
- * @return Return 1 if explosion has ended, 0 otherwise
+ * @param ptr Pointer to the Explosion in question
+ *
+ * @return First frame after the last bitmap of the animation
  */
-int explosion_update(Explosion * ptr);
+unsigned long explosion_getEndFrame(Explosion * ptr);
 
 /**
- * @brief Gets the current Bitmap of the Explosion
+ * @brief Gets the radius of the Explosion at a given frame
  *
  * @param ptr Pointer to the Explosion in question
+ * @param frame Current frame
+ *
+ * @return Radius of the Explosion
+ */
+int explosion_getRadius(Explosion * ptr, unsigned long frame);
+
+/**
+ * @brief Gets the Bitmap of the Explosion at a given frame
+ *
+ * @param ptr Pointer to the Explosion in question
+ * @param frame Current frame
  *
  * @return Return the current Bitmap of the Explosion
  */
-Bitmap * explosion_getBitmap(Explosion * ptr);
+Bitmap * explosion_getBitmap(Explosion * ptr, unsigned long frame);
 
 /**
  * @brief Gets the position in the horizontal axis of the Explosion, on the screen
@@ -179,6 +286,22 @@ int explosion_getPosY(Explosion * ptr);
  */
 size_t explosion_getSizeOf();
 
+/**
+ * @brief Copies the state of an Explosion
+ *
+ * @param ptr Pointer to the Explosion in question
+ * @param state Filled with its state
+ */
+void explosion_getState(Explosion * ptr, ExplosionState_t * state);
+
+/**
+ * @brief Overwrites an Explosion with a copied state
+ *
+ * @param ptr Pointer to the Explosion, or to explosion_getSizeOf() bytes of uninitialised memory
+ * @param state State to copy
+ */
+void explosion_setState(Explosion * ptr, const ExplosionState_t * state);
+
 /**
  * @brief Destroys an Explosion, freeing all the resources used by it
  *
@@ -193,10 +316,12 @@ void delete_explosion(Explosion * ptr);
  *
  * @param ptr Pointer to the Missile in question
  * @param e_ptr Pointer to the Explosion in question
+ * @param frame Current frame
  *
  * @return Return 1 if Collision happened, 0 otherwise
  */
-int missile_collidedWithExplosion(Missile * ptr, Explosion * e_ptr);
+int missile_collidedWithExplosion(Missile * ptr, Explosion * e_ptr,
+		unsigned long frame);
 
 /**
  * @brief Check if a Missile collided with a Rectangle
@@ -212,6 +337,37 @@ int missile_collidedWithExplosion(Missile * ptr, Explosion * e_ptr);
 int missile_collidedWithRect(Missile * ptr, unsigned posX, unsigned posY,
 		unsigned sizeX, unsigned sizeY);
 
+/* Impact Prediction */
+
+/**
+ * @brief Predicts how many updates the Missile needs to (possibly) reach a Rectangle
+ *
+ * Missiles fly in straight lines at constant velocity, so the earliest contact can be solved analytically.
+ * The prediction is conservative: it may be early by a couple of frames, never late.
+ *
+ * @param ptr Pointer to the Missile in question
+ * @param posX Lower left position of the rectangle in the horizontal axis
+ * @param posY Lower left position of the rectangle in the vertical axis
+ * @param sizeX Width of the rectangle
+ * @param sizeY Height of the rectangle
+ *
+ * @return Number of updates until contact (0 if already there), negative if the rectangle is never reached
+ */
+long missile_framesToRect(Missile * ptr, unsigned posX, unsigned posY,
+		unsigned sizeX, unsigned sizeY);
+
+/**
+ * @brief Predicts how many updates the Missile needs to (possibly) go below the ground
+ *
+ * Conservative, as missile_framesToRect()
+ *
+ * @param ptr Pointer to the Missile in question
+ * @param groundY Position of the ground in the vertical axis
+ *
+ * @return Number of updates until contact (0 if already there), negative if the ground is never reached
+ */
+long missile_framesToGround(Missile * ptr, unsigned groundY);
+
 /**@}*/
 
 #endif
@@ -0,0 +1,93 @@
+#include <string.h>
+#include "MouseParser.h"
+#include "mouse.h"
+
+void mouse_parser_init(MouseParser_t * self, unsigned size) {
+	self->state = PARSER_BYTE0;
+	self->size = MOUSE_PACKET_MAX == size ? MOUSE_PACKET_MAX : PACKET_NELEMENTS;
+	memset(self->bytes_us, 0, sizeof(self->bytes_us));
+	self->synced = 1;
+
+	self->packets = 0;
+	self->dropped = 0;
+	self->resyncs = 0;
+}
+
+// Private Method -- Counts a loss of alignment, once until a valid packet comes
+static void mouse_parser_lost_sync(MouseParser_t * self) {
+	if (self->synced) {
+		++(self->resyncs);
+		self->synced = 0;
+	}
+}
+
+// Private Method -- Whether the bytes held form a plausible packet
+static int mouse_parser_valid(MouseParser_t * self) {
+	if ((self->bytes[0] & (BYTE0_X_OVF | BYTE0_Y_OVF)) != 0)
+		return 0;	// Motion lost, and a shifted packet often looks like this
+
+	// IntelliMouse wheel motion is -8 to 7, the high bits only extend its sign
+	if (MOUSE_PACKET_MAX == self->size && (self->bytes[3] & 0xF8) != 0
+			&& (self->bytes[3] & 0xF8) != 0xF8)
+		return 0;
+
+	return 1;
+}
+
+// Private Method -- Drops the packet held, keeping the bytes after the first one that may start another
+static void mouse_parser_realign(MouseParser_t * self) {
+	unsigned held = self->state, first;
+
+	++(self->dropped);
+	mouse_parser_lost_sync(self);
+
+	for (first = 1; first < held; ++first)
+		if ((self->bytes[first] & BYTE0_SYNC_BIT) != 0)
+			break;
+
+	// The bytes kept bring their times: the timeout runs from the new first one
+	memmove(self->bytes, self->bytes + first, held - first);
+	memmove(self->bytes_us, self->bytes_us + first,
+			(held - first) * sizeof(self->bytes_us[0]));
+	self->state = (mouse_parser_state_t) (held - first);
+}
+
+int mouse_parser_feed(MouseParser_t * self, unsigned char byte,
+		uint64_t time_us, MousePacket_t * packet) {
+	// Bytes of a packet come back to back: a stale one lost its last bytes
+	if (PARSER_BYTE0 != self->state
+			&& time_us - self->bytes_us[0] > MOUSE_PACKET_TIMEOUT_US) {
+		++(self->dropped);
+		mouse_parser_lost_sync(self);
+		self->state = PARSER_BYTE0;
+	}
+
+	if (PARSER_BYTE0 == self->state && (byte & BYTE0_SYNC_BIT) == 0) {
+		mouse_parser_lost_sync(self);
+		return 0;	// Not a first byte, wait for one
+	}
+
+	self->bytes[self->state] = byte;
+	self->bytes_us[self->state] = time_us;
+	self->state = (mouse_parser_state_t) (self->state + 1);
+	if (self->state < self->size)
+		return 0;
+
+	if (!mouse_parser_valid(self)) {
+		mouse_parser_realign(self);
+		return 0;
+	}
+	self->state = PARSER_BYTE0;
+	self->synced = 1;
+	++(self->packets);
+
+	packet->buttons = self->bytes[0] & (BYTE0_LB | BYTE0_RB | BYTE0_MB);
+	packet->dx = self->bytes[0] & BYTE0_X_SIGN ?
+			(int) self->bytes[1] - 256 : (int) self->bytes[1];
+	packet->dy = self->bytes[0] & BYTE0_Y_SIGN ?
+			(int) self->bytes[2] - 256 : (int) self->bytes[2];
+	packet->dz = MOUSE_PACKET_MAX == self->size ?
+			(int) (signed char) self->bytes[3] : 0;
+
+	return 1;
+}
@@ -0,0 +1,74 @@
+#ifndef __MOUSE_PARSER_H
+#define __MOUSE_PARSER_H
+
+/** @defgroup MouseParser MouseParser
+ * @{
+ * State machine assembling PS/2 mouse bytes into packets.
+ *
+ * Every packet is checked (bit 3 of the first byte, overflow bits, wheel byte range)
+ * before being accepted. When a byte is lost the parser realigns on the next byte that
+ * may start a packet, instead of reading shifted packets until restart.
+ * Supports the standard 3 byte packets and the IntelliMouse 4 byte ones.
+ */
+
+#include <stdint.h>
+
+#define MOUSE_PACKET_MAX			4		/**< @brief Bytes in the largest packet (IntelliMouse) */
+#define MOUSE_PACKET_TIMEOUT_US		20000	/**< @brief Longest gap between bytes of the same packet */
+
+/**
+ * @brief A validated mouse packet
+ */
+typedef struct {
+	unsigned char buttons;	///> Buttons held (BYTE0_LB, BYTE0_RB, BYTE0_MB)
+	int dx;		///> Horizontal motion, positive to the right
+	int dy;		///> Vertical motion, positive upwards
+	int dz;		///> Wheel motion, 0 without a wheel
+} MousePacket_t;
+
+/**
+ * Parser states: the byte of the packet expected next
+ */
+typedef enum {
+	PARSER_BYTE0, PARSER_BYTE1, PARSER_BYTE2, PARSER_BYTE3
+} mouse_parser_state_t;
+
+/**
+ * @brief Packet assembly state and error statistics
+ */
+typedef struct {
+	mouse_parser_state_t state; ///> Next byte expected
+	unsigned size; ///> Bytes per packet, 3 or 4
+	unsigned char bytes[MOUSE_PACKET_MAX]; ///> Bytes of the packet being assembled
+	uint64_t bytes_us[MOUSE_PACKET_MAX]; ///> Time each byte held was received
+	int synced; ///> Whether the last packet was valid
+
+	unsigned long packets; ///> Valid packets assembled
+	unsigned long dropped; ///> Packets thrown away as invalid or incomplete
+	unsigned long resyncs; ///> Times the parser lost the packet alignment
+} MouseParser_t;
+
+/**
+ * @brief Resets a parser, clearing its statistics
+ *
+ * @param self Parser to reset
+ * @param size Bytes per packet: 3, or 4 for an IntelliMouse
+ */
+void mouse_parser_init(MouseParser_t * self, unsigned size);
+
+/**
+ * @brief Feeds a byte to the parser
+ *
+ * @param self Parser
+ * @param byte Byte read from the mouse
+ * @param time_us now_us() when the byte was read
+ * @param packet Filled with the packet completed by the byte, if any
+ *
+ * @return Return 1 if the byte completed a valid packet, 0 otherwise
+ */
+int mouse_parser_feed(MouseParser_t * self, unsigned char byte,
+		uint64_t time_us, MousePacket_t * packet);
+
+/**@}*/
+
+#endif /* __MOUSE_PARSER_H */
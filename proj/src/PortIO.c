@@ -0,0 +1,16 @@
+#include <minix/syslib.h>
+#include <minix/drivers.h>
+
+#include "PortIO.h"
+
+int port_inb(unsigned long port, unsigned long * value) {
+	return sys_inb(port, value);
+}
+
+int port_outb(unsigned long port, unsigned long value) {
+	return sys_outb(port, value);
+}
+
+void port_delay(unsigned long us) {
+	tickdelay(micros_to_ticks(us));
+}
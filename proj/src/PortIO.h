@@ -0,0 +1,39 @@
+#ifndef __PORTIO_H
+#define __PORTIO_H
+
+/** @defgroup PortIO PortIO
+ * @{
+ * I/O ports of the devices, behind functions, so a driver runs wherever they lead: to
+ * the hardware through the MINIX kernel, or to an emulation of the device (HEADLESS).
+ */
+
+/**
+ * @brief Reads a byte from an I/O port
+ *
+ * @param port Address of the port
+ * @param value Where to store the byte read
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int port_inb(unsigned long port, unsigned long * value);
+
+/**
+ * @brief Writes a byte to an I/O port
+ *
+ * @param port Address of the port
+ * @param value Byte to write, in the lower 8 bits
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int port_outb(unsigned long port, unsigned long value);
+
+/**
+ * @brief Waits for a device to settle
+ *
+ * @param us Microseconds to wait, at least
+ */
+void port_delay(unsigned long us);
+
+/**@}*/
+
+#endif /* __PORTIO_H */
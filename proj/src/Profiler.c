@@ -0,0 +1,93 @@
+#include <string.h>
+#include "Profiler.h"
+#include "Clock.h"
+
+static uint64_t start_us[PROF_NUM_SECTIONS];	// Time the running section was entered
+static uint64_t total_us[PROF_NUM_SECTIONS];
+static unsigned long calls[PROF_NUM_SECTIONS];
+
+static unsigned values[PROF_NUM_GAUGES];
+static unsigned peaks[PROF_NUM_GAUGES];
+
+static unsigned long delay_samples[PROF_NUM_DELAYS];
+static uint64_t delay_total_us[PROF_NUM_DELAYS];
+static uint64_t delay_max_us[PROF_NUM_DELAYS];
+
+static const char * section_names[PROF_NUM_SECTIONS] = { "update",
+		"collision", "draw", "snapshot", "restore" };
+static const char * gauge_names[PROF_NUM_GAUGES] = { "enemy missiles",
+		"friendly missiles", "explosions" };
+static const char * delay_names[PROF_NUM_DELAYS] = { "click to missile",
+		"packet to present" };
+
+void prof_begin(prof_section_t s) {
+	start_us[s] = now_us();
+}
+
+void prof_end(prof_section_t s) {
+	total_us[s] += now_us() - start_us[s];
+	++calls[s];
+}
+
+void prof_gauge(prof_gauge_t g, unsigned value) {
+	values[g] = value;
+	if (value > peaks[g])
+		peaks[g] = value;
+}
+
+void prof_delay(prof_delay_t d, uint64_t us) {
+	++delay_samples[d];
+	delay_total_us[d] += us;
+	if (us > delay_max_us[d])
+		delay_max_us[d] = us;
+}
+
+uint64_t prof_get_total_us(prof_section_t s) {
+	return total_us[s];
+}
+
+unsigned long prof_get_calls(prof_section_t s) {
+	return calls[s];
+}
+
+unsigned prof_get_value(prof_gauge_t g) {
+	return values[g];
+}
+
+unsigned prof_get_peak(prof_gauge_t g) {
+	return peaks[g];
+}
+
+unsigned long prof_get_delay_samples(prof_delay_t d) {
+	return delay_samples[d];
+}
+
+uint64_t prof_get_delay_avg_us(prof_delay_t d) {
+	return delay_samples[d] ? delay_total_us[d] / delay_samples[d] : 0;
+}
+
+uint64_t prof_get_delay_max_us(prof_delay_t d) {
+	return delay_max_us[d];
+}
+
+const char * prof_section_name(prof_section_t s) {
+	return section_names[s];
+}
+
+const char * prof_gauge_name(prof_gauge_t g) {
+	return gauge_names[g];
+}
+
+const char * prof_delay_name(prof_delay_t d) {
+	return delay_names[d];
+}
+
+void prof_reset() {
+	memset(total_us, 0, sizeof(total_us));
+	memset(calls, 0, sizeof(calls));
+	memset(values, 0, sizeof(values));
+	memset(peaks, 0, sizeof(peaks));
+	memset(delay_samples, 0, sizeof(delay_samples));
+	memset(delay_total_us, 0, sizeof(delay_total_us));
+	memset(delay_max_us, 0, sizeof(delay_max_us));
+}
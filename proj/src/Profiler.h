@@ -0,0 +1,184 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+/** @defgroup Profiler Profiler
+ * @{
+ * Accumulates the time spent in each part of a frame, and the peak entity counts.
+ *
+ * Only compiled in when PROFILE is set. Otherwise the PROF_* macros expand to nothing,
+ * so the game pays nothing for them.
+ */
+
+#include <stdint.h>
+
+/**
+ * Timed parts of a frame
+ */
+typedef enum {
+	PROF_UPDATE,		///> Input, scheduled events and missile movement
+	PROF_COLLISION,		///> Impacts and explosions
+	PROF_DRAW,			///> Drawing a frame to the buffer
+	PROF_SNAPSHOT,		///> Saving the game to a Snapshot
+	PROF_RESTORE,		///> Restoring the game from a Snapshot
+	PROF_NUM_SECTIONS
+} prof_section_t;
+
+/**
+ * Counted entities
+ */
+typedef enum {
+	PROF_E_MISSILES,	///> Enemy missiles alive
+	PROF_F_MISSILES,	///> Friendly missiles alive
+	PROF_EXPLOSIONS,	///> Explosions on screen
+	PROF_NUM_GAUGES
+} prof_gauge_t;
+
+/**
+ * Measured delays
+ */
+typedef enum {
+	PROF_CLICK_TO_MISSILE,	///> From the mouse interrupt to the missile being fired
+	PROF_PACKET_TO_PRESENT,	///> From a mouse motion packet to the first frame showing it
+	PROF_NUM_DELAYS
+} prof_delay_t;
+
+#if PROFILE
+#define PROF_BEGIN(s)		prof_begin(s)
+#define PROF_END(s)			prof_end(s)
+#define PROF_GAUGE(g, v)	prof_gauge(g, v)
+#define PROF_DELAY(d, us)	prof_delay(d, us)
+#else
+#define PROF_BEGIN(s)
+#define PROF_END(s)
+#define PROF_GAUGE(g, v)
+#define PROF_DELAY(d, us)
+#endif
+
+/**
+ * @brief Starts timing a section. Sections must not be nested within themselves
+ *
+ * @param s Section being entered
+ */
+void prof_begin(prof_section_t s);
+
+/**
+ * @brief Stops timing a section, adding the elapsed time to its total
+ *
+ * @param s Section being left
+ */
+void prof_end(prof_section_t s);
+
+/**
+ * @brief Records the current value of a gauge, keeping its peak
+ *
+ * @param g Gauge to update
+ * @param value Current value
+ */
+void prof_gauge(prof_gauge_t g, unsigned value);
+
+/**
+ * @brief Records a sample of a delay
+ *
+ * @param d Delay measured
+ * @param us Its duration, in microseconds
+ */
+void prof_delay(prof_delay_t d, uint64_t us);
+
+/**
+ * @brief Gets the time spent in a section, since the last reset
+ *
+ * @param s Section in question
+ *
+ * @return Total time, in microseconds
+ */
+uint64_t prof_get_total_us(prof_section_t s);
+
+/**
+ * @brief Gets how many times a section was timed, since the last reset
+ *
+ * @param s Section in question
+ *
+ * @return Number of prof_end() calls
+ */
+unsigned long prof_get_calls(prof_section_t s);
+
+/**
+ * @brief Gets the last value recorded for a gauge
+ *
+ * @param g Gauge in question
+ *
+ * @return Last value
+ */
+unsigned prof_get_value(prof_gauge_t g);
+
+/**
+ * @brief Gets the highest value of a gauge, since the last reset
+ *
+ * @param g Gauge in question
+ *
+ * @return Peak value
+ */
+unsigned prof_get_peak(prof_gauge_t g);
+
+/**
+ * @brief Gets the number of samples of a delay, since the last reset
+ *
+ * @param d Delay in question
+ *
+ * @return Number of prof_delay() calls
+ */
+unsigned long prof_get_delay_samples(prof_delay_t d);
+
+/**
+ * @brief Gets the average of a delay, since the last reset
+ *
+ * @param d Delay in question
+ *
+ * @return Average duration, in microseconds. 0 without samples
+ */
+uint64_t prof_get_delay_avg_us(prof_delay_t d);
+
+/**
+ * @brief Gets the longest sample of a delay, since the last reset
+ *
+ * @param d Delay in question
+ *
+ * @return Longest duration, in microseconds
+ */
+uint64_t prof_get_delay_max_us(prof_delay_t d);
+
+/**
+ * @brief Gets the printable name of a section
+ *
+ * @param s Section in question
+ *
+ * @return Name of the section
+ */
+const char * prof_section_name(prof_section_t s);
+
+/**
+ * @brief Gets the printable name of a gauge
+ *
+ * @param g Gauge in question
+ *
+ * @return Name of the gauge
+ */
+const char * prof_gauge_name(prof_gauge_t g);
+
+/**
+ * @brief Gets the printable name of a delay
+ *
+ * @param d Delay in question
+ *
+ * @return Name of the delay
+ */
+const char * prof_delay_name(prof_delay_t d);
+
+/**
+ * @brief Clears every total, count and peak
+ */
+void prof_reset();
+
+/**@}*/
+
+#endif /* __PROFILER_H */
@@ -1,9 +1,13 @@
 #include <minix/syslib.h>
-#include <stdlib.h>
 #include "RTC.h"
 
 static int rtc_hook_id = RTC_INITIAL_HOOK_ID;
 
+static Date_t cached_date = { 0 };		// Date as of the last update
+static volatile unsigned date_seq = 0;	// Odd while cached_date is written
+static int binary = 0;					// Whether the registers are in binary, not BCD
+static volatile unsigned long periodic_count = 0;	// Periodic interrupts handled
+
 int rtc_subscribe_int(void) {
 	if (sys_irqsetpolicy(RTC_IRQ, IRQ_REENABLE, &rtc_hook_id) != OK) {
 		printf("rtc_subscribe_int() -> FAILED sys_irqsetpolicy().\n");
@@ -57,39 +61,145 @@ int rtc_updating(void) {
 	return OK;
 }
 
-Date_t * rtc_read_date(void) {
-	//Date Initialization
-	Date_t * date = malloc(sizeof(Date_t));
-	date->year = 3;
+// Private Method -- Reads a date register, in binary
+static int rtc_read_field(int reg, unsigned long * field) {
+	int value = rtc_read_register(reg);
 
-	if (rtc_updating()) {
+	if (-1 == value)
+		return 1;
+	*field = binary ? (unsigned long) value : (unsigned long) parserBCD(value);
+	return OK;
+}
+
+// Private Method -- Reads the date registers into date. Safe out of an update only
+static int rtc_fetch_date(Date_t * date) {
+	int failed = 0;
+
+	if (OK != rtc_read_field(AL_MINUTES, &date->minute)) {
+		printf("rtc_fetch_date -> Failed rtc_read_register() - minute.\n");
+		failed = 1;
+	}
+	if (OK != rtc_read_field(AL_HOURS, &date->hour)) {
+		printf("rtc_fetch_date -> Failed rtc_read_register() - hour.\n");
+		failed = 1;
+	}
+	if (OK != rtc_read_field(AL_DAY, &date->day)) {
+		printf("rtc_fetch_date -> Failed rtc_read_register() - day.\n");
+		failed = 1;
+	}
+	if (OK != rtc_read_field(AL_MONTH, &date->month)) {
+		printf("rtc_fetch_date -> Failed rtc_read_register() - month.\n");
+		failed = 1;
+	}
+	if (OK != rtc_read_field(AL_YEAR, &date->year)) {
+		printf("rtc_fetch_date -> Failed rtc_read_register() - year.\n");
+		failed = 1;
+	}
+
+	return failed;
+}
+
+// Private Method -- Replaces the date copied by rtc_read_date()
+static void rtc_publish_date(const Date_t * date) {
+	++date_seq; // Odd: being written
+	cached_date = *date;
+	++date_seq;
+}
+
+int rtc_enable_int(unsigned long bits) {
+	Date_t date;
+	int regB;
+
+	if ((regB = rtc_read_register(AL_REGB)) == -1) {
+		printf("rtc_enable_int -> Failed rtc_read_register() - B.\n");
+		return 1;
+	}
+	binary = regB & B_DM;
+
+	if (bits & B_UEI) {
+		// The first date, unless the RTC is updating it: then the interrupt comes at once
+		if (rtc_updating() && OK == rtc_fetch_date(&date))
+			rtc_publish_date(&date);
+	}
+
+	if (OK != rtc_write_register(AL_REGB, regB | bits))
+		return 1;
+	rtc_read_register(AL_REGC); // Drops what was pending
+
+	return OK;
+}
 
-		if ((date->minute = parserBCD(rtc_read_register(AL_MINUTES))) == -1) {
-			printf("rtc_read_date -> Failed rtc_read_register() - minute.\n");
-			date->year = 0;
-		}
+int rtc_disable_int(unsigned long bits) {
+	int regB;
 
-		if ((date->hour = parserBCD(rtc_read_register(AL_HOURS))) == -1) {
-			printf("rtc_read_date -> Failed rtc_read_register() - hour.\n");
-			date->year = 0;
-		}
+	if ((regB = rtc_read_register(AL_REGB)) == -1) {
+		printf("rtc_disable_int -> Failed rtc_read_register() - B.\n");
+		return 1;
+	}
 
-		if ((date->day = parserBCD(rtc_read_register(AL_DAY))) == -1) {
-			printf("rtc_read_date -> Failed rtc_read_register() - day.\n");
-			date->year = 0;
-		}
+	return rtc_write_register(AL_REGB, regB & ~bits);
+}
 
-		if ((date->month = parserBCD(rtc_read_register(AL_MONTH))) == -1) {
-			printf("rtc_read_date -> Failed rtc_read_register() - month.\n");
-			date->year = 1;
-		}
+int rtc_set_periodic(unsigned long hz) {
+	unsigned long rs;
+	int regA;
 
-		if ((date->year = parserBCD(rtc_read_register(AL_YEAR))) == -1) {
-			printf("rtc_read_date -> Failed rtc_read_register() - year.\n");
-			date->year = 2;
-		}
+	// Rate selectors 3 to 15 divide the time base by 2^(rs - 1)
+	for (rs = 3; rs <= 15 && (RTC_BASE_HZ >> (rs - 1)) != hz; ++rs)
+		;
+	if (rs > 15) {
+		printf("rtc_set_periodic -> %lu Hz is not a rate of the RTC.\n", hz);
+		return 1;
+	}
 
+	if ((regA = rtc_read_register(AL_REGA)) == -1) {
+		printf("rtc_set_periodic -> Failed rtc_read_register() - A.\n");
+		return 1;
 	}
-	return date;
+	if (OK != rtc_write_register(AL_REGA, (regA & ~(A_UIP | A_RS_MASK)) | rs))
+		return 1;
+
+	periodic_count = 0;
+	return rtc_enable_int(B_PIE);
 }
 
+unsigned long rtc_periodic_count(void) {
+	return periodic_count;
+}
+
+// Private Method -- Handles the flags of register C, which reading it cleared
+static void rtc_dispatch(int regC) {
+	Date_t date;
+
+	if (regC & C_PF)
+		++periodic_count;
+
+	// Updated: the registers hold still for the next 999 ms
+	if ((regC & C_UE) && OK == rtc_fetch_date(&date))
+		rtc_publish_date(&date);
+}
+
+unsigned long rtc_poll(void) {
+	int regC = rtc_read_register(AL_REGC);
+
+	if (-1 != regC)
+		rtc_dispatch(regC);
+
+	return periodic_count;
+}
+
+void rtc_ih(void) {
+	int regC = rtc_read_register(AL_REGC); // Reading C acknowledges the interrupt
+
+	if (-1 != regC)
+		rtc_dispatch(regC);
+}
+
+void rtc_read_date(Date_t * date) {
+	unsigned seq;
+
+	do {
+		seq = date_seq;
+		*date = cached_date;
+	} while ((seq & 1) || seq != date_seq);
+}
@@ -5,6 +5,14 @@
  * @{
  *
  * Functions for using the RTC - Real Time Clock
+ *
+ * The date is not read from the RTC when asked for: with the update-ended interrupt on
+ * (rtc_enable_int(B_UEI)), rtc_ih() reads it once a second, right after the RTC
+ * updated it, when the registers hold still for the next 999 ms. rtc_read_date() only
+ * copies that date, without port I/O.
+ *
+ * The periodic interrupt (rtc_set_periodic()) only counts its periods, for Clock to
+ * tell the time with.
  */
 
 /* Useful Macros for the RTC */
@@ -15,6 +23,9 @@
 /* RTC Macros */
 #define RTC_IRQ					8	/**< @brief RTC IRQ line */
 #define RTC_INITIAL_HOOK_ID		8	/**< @brief RTC Initial hook_id */
+#define RTC_BASE_HZ				32768	/**< @brief Frequency of the time base */
+#define RTC_PERIODIC_MIN_HZ		2		/**< @brief Slowest periodic interrupt, rate selector 15 */
+#define RTC_PERIODIC_MAX_HZ		8192	/**< @brief Fastest periodic interrupt, rate selector 3 */
 
 #define RTC_ADDR_REG			0x70
 #define RTC_DATA_REG			0x71
@@ -27,7 +38,8 @@
 #define A_RS3		BIT(3)		/**< @brief RS3-RS0 : Rate selector */
 #define A_RS2		BIT(2)
 #define A_RS1		BIT(1)
-#define A_RS0		BIT(O)
+#define A_RS0		BIT(0)
+#define A_RS_MASK	0x0F		/**< @brief Rate selector bits */
 
 /* Control/ Status Register B */
 #define B_SET		BIT(7)		/**< @brief Inhibit updates of time/date registers */
@@ -37,7 +49,7 @@
 #define B_SQWE		BIT(3)		/**< @brief Enable square-wave generation */
 #define B_DM		BIT(2)		/**< @brief Set registers in Binary or BCD*/
 #define B_24_12		BIT(1)		/**< @brief Set hours range from [0,23] or [0,12] */
-#define B_DSE		BIT(O)		/**< @brief Enable Daylight Savings Time */
+#define B_DSE		BIT(0)		/**< @brief Enable Daylight Savings Time */
 
 /* Control/ Status Register C */
 #define	C_IRQF		BIT(7)		/**< @brief IRQ Line Active */
@@ -125,12 +137,69 @@ int rtc_write_register(unsigned long reg, unsigned long value);
  */
 int rtc_updating(void);
 
+/**
+ * @brief Turns interrupts of the RTC on, the ones of register B in bits
+ *
+ * Turning B_UEI on first reads the date, so rtc_read_date() has one from then on.
+ *
+ * @param bits B_UEI, B_AEI and B_PIE, or'ed
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int rtc_enable_int(unsigned long bits);
+
+/**
+ * @brief Turns interrupts of the RTC off, the ones of register B in bits
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int rtc_disable_int(unsigned long bits);
+
+/**
+ * @brief Turns the periodic interrupt on, at a rate of the RTC: a power of two Hz
+ *
+ * The count of periods starts over from 0.
+ *
+ * @param hz Frequency, from RTC_PERIODIC_MIN_HZ to RTC_PERIODIC_MAX_HZ
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int rtc_set_periodic(unsigned long hz);
+
+/**
+ * @brief Periodic interrupts handled since rtc_set_periodic()
+ *
+ * Periods that went by while an interrupt waited to be handled count as one: the
+ * RTC raises no other before register C is read.
+ */
+unsigned long rtc_periodic_count(void);
+
+/**
+ * @brief Reads register C out of an interrupt, and handles its flags as rtc_ih() does
+ *
+ * Counts the period that ended since C was last read, and reads the date after an
+ * update, so neither is lost to the interrupt that then finds C clear. Lets the count
+ * move on inside a long handler, polled at least once a period.
+ *
+ * @return Periods counted since rtc_set_periodic(), as rtc_periodic_count()
+ */
+unsigned long rtc_poll(void);
+
+/**
+ * @brief RTC interrupt handler: acknowledges the interrupt (register C), counts a
+ * period, and after an update reads the date into the one rtc_read_date() copies
+ */
+void rtc_ih(void);
+
 /*
- * @brief Gets Date from the RTC
+ * @brief Gets the Date of the RTC, as of its last update
+ *
+ * A copy of the date read by rtc_ih(), no port I/O. The copy is taken again if the
+ * handler wrote the date meanwhile, so it is never half of two dates.
  *
- * @return Return a pointer to a date containing a day, a month and a year. If year is 0, function failed.
+ * @param date Where to copy it. Without the update interrupt on, the year is 0
  */
-Date_t * rtc_read_date(void);
+void rtc_read_date(Date_t * date);
 
 /**@}*/
 
@@ -0,0 +1,74 @@
+#include "Random.h"
+
+static Rng_t streams[RNG_NUM_STREAMS];
+
+#define ROTL(x, k)	(((x) << (k)) | ((x) >> (32 - (k))))
+
+// Private Method -- splitmix64 step, spreads a seed over the whole state
+static uint64_t splitmix64(uint64_t * x) {
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+void rng_seed(Rng_t * self, uint64_t seed) {
+	uint64_t a = splitmix64(&seed), b = splitmix64(&seed);
+
+	self->s[0] = (uint32_t) a;
+	self->s[1] = (uint32_t) (a >> 32);
+	self->s[2] = (uint32_t) b;
+	self->s[3] = (uint32_t) (b >> 32);
+}
+
+uint32_t rng_next(Rng_t * self) {
+	uint32_t * s = self->s;
+	uint32_t result = ROTL(s[1] * 5, 7) * 9;
+	uint32_t t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = ROTL(s[3], 11);
+
+	return result;
+}
+
+uint32_t rng_below(Rng_t * self, uint32_t n) {
+	return RNG_BOUND(rng_next(self), n);
+}
+
+void rng_fill(Rng_t * self, uint32_t * out, unsigned count) {
+	// Works on a local copy, so the state stays in registers
+	uint32_t s0 = self->s[0], s1 = self->s[1], s2 = self->s[2], s3 = self->s[3];
+	unsigned i;
+
+	for (i = 0; i < count; ++i) {
+		uint32_t t = s1 << 9;
+		out[i] = ROTL(s1 * 5, 7) * 9;
+
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = ROTL(s3, 11);
+	}
+
+	self->s[0] = s0;
+	self->s[1] = s1;
+	self->s[2] = s2;
+	self->s[3] = s3;
+}
+
+void rng_seed_streams(uint64_t seed) {
+	unsigned stream;
+	for (stream = 0; stream < RNG_NUM_STREAMS; ++stream)
+		rng_seed(&streams[stream], seed ^ ((uint64_t) stream << 56));
+}
+
+Rng_t * rng_stream(rng_stream_t stream) {
+	return &streams[stream];
+}
@@ -0,0 +1,91 @@
+#ifndef __RANDOM_H
+#define __RANDOM_H
+
+/** @defgroup Random Random
+ * @{
+ * Seedable pseudo-random number generators (xoshiro128**), replacing rand().
+ *
+ * Each generator has its own state, so drawing from one never shifts another, and the
+ * sequence is the same on every libc. The game draws from a few named streams, all
+ * seeded from a single seed.
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief Generator state
+ */
+typedef struct {
+	uint32_t s[4];
+} Rng_t;
+
+/**
+ * Streams used by the game
+ */
+typedef enum {
+	RNG_SPAWN,		///> Enemy missile origins, targets and speeds
+	RNG_COSMETIC,	///> Effects that do not change the outcome
+	RNG_AI,			///> Decisions of computer-controlled players
+	RNG_NUM_STREAMS
+} rng_stream_t;
+
+/**
+ * @brief Maps a random 32 bit value to [0, n), without a division
+ */
+#define RNG_BOUND(r, n)		((uint32_t) (((uint64_t) (r) * (n)) >> 32))
+
+/**
+ * @brief Seeds a generator. Different seeds give unrelated sequences
+ *
+ * @param self Generator to seed
+ * @param seed Any value, 0 included
+ */
+void rng_seed(Rng_t * self, uint64_t seed);
+
+/**
+ * @brief Draws the next value of a generator
+ *
+ * @param self Generator
+ *
+ * @return Uniformly distributed 32 bit value
+ */
+uint32_t rng_next(Rng_t * self);
+
+/**
+ * @brief Draws a value in [0, n)
+ *
+ * @param self Generator
+ * @param n Number of possible values, not 0
+ *
+ * @return Value drawn
+ */
+uint32_t rng_below(Rng_t * self, uint32_t n);
+
+/**
+ * @brief Draws many values at once, as a sequence of rng_next() calls would
+ *
+ * @param self Generator
+ * @param out Filled with the values drawn
+ * @param count Number of values to draw
+ */
+void rng_fill(Rng_t * self, uint32_t * out, unsigned count);
+
+/**
+ * @brief Seeds every stream of the game, each with a different sequence
+ *
+ * @param seed Seed of the session
+ */
+void rng_seed_streams(uint64_t seed);
+
+/**
+ * @brief Gets one of the game's streams
+ *
+ * @param stream Stream in question
+ *
+ * @return Pointer to its generator
+ */
+Rng_t * rng_stream(rng_stream_t stream);
+
+/**@}*/
+
+#endif /* __RANDOM_H */
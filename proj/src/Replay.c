@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <string.h>
+#include "Replay.h"
+#include "Input.h"
+
+static replay_mode_t mode = REPLAY_OFF;
+static FILE * file = NULL;
+
+static unsigned frame_steps;	// Steps of the interrupt being recorded
+static InputEvent_t frame_events[INPUT_RING_SIZE];	// Events of the interrupt being recorded
+static unsigned frame_num_events;
+static int frame_pending = 0;	// Whether an interrupt is waiting to be written
+static unsigned idle_run = 0;	// Idle interrupts recorded but not written yet, or left to play
+static int play_over = 0;		// Whether playback read the REPLAY_END tag
+
+/** Little endian I/O **/
+
+static void write_u8(unsigned value) {
+	fputc(value & 0xFF, file);
+}
+
+static void write_u16(unsigned value) {
+	write_u8(value);
+	write_u8(value >> 8);
+}
+
+static void write_u32(uint32_t value) {
+	write_u16(value & 0xFFFF);
+	write_u16(value >> 16);
+}
+
+// Returns 0 on end of file, as if the record was REPLAY_END
+static unsigned read_u8() {
+	int c = fgetc(file);
+	return EOF == c ? 0 : (unsigned) c;
+}
+
+static unsigned read_u16() {
+	unsigned low = read_u8();
+	return low | (read_u8() << 8);
+}
+
+static uint32_t read_u32() {
+	uint32_t low = read_u16();
+	return low | ((uint32_t) read_u16() << 16);
+}
+
+/** Recording **/
+
+int replay_record(const char * path, unsigned long seed) {
+	if (NULL == (file = fopen(path, "wb"))) {
+		printf("replay_record -> FAILED to open %s\n", path);
+		return 1;
+	}
+
+	fwrite("PDRP", 1, 4, file);
+	write_u8(REPLAY_VERSION);
+	write_u32(seed);
+
+	mode = REPLAY_RECORDING;
+	frame_pending = 0;
+	idle_run = 0;
+	return OK;
+}
+
+// Private Method -- Writes the run of idle interrupts recorded so far
+static void replay_flush_idle() {
+	if (0 == idle_run)
+		return;
+
+	write_u8(REPLAY_IDLE);
+	write_u8(idle_run);
+	idle_run = 0;
+}
+
+// Private Method -- Writes the interrupt being recorded, folding idle ones into a run
+static void replay_commit_frame() {
+	unsigned i;
+
+	if (!frame_pending)
+		return;
+	frame_pending = 0;
+
+	if (1 == frame_steps && 0 == frame_num_events) {
+		if (0xFF == ++idle_run)
+			replay_flush_idle();
+		return;
+	}
+
+	replay_flush_idle();
+	write_u8(REPLAY_FRAME);
+	write_u8(frame_steps);
+	write_u16(frame_num_events);
+	for (i = 0; i < frame_num_events; ++i) {
+		write_u8(frame_events[i].type);
+		write_u16(frame_events[i].code);
+		write_u16((uint16_t) frame_events[i].dx);
+		write_u16((uint16_t) frame_events[i].dy);
+	}
+}
+
+void replay_log_event(const InputEvent_t * ev) {
+	if (REPLAY_RECORDING != mode)
+		return;
+
+	if (INPUT_RING_SIZE == frame_num_events) {
+		printf("replay_log_event -> Too many events in a frame, event lost\n");
+		return;
+	}
+	frame_events[frame_num_events++] = *ev;
+}
+
+/** Playing **/
+
+int replay_play(const char * path, unsigned long * seed) {
+	char magic[4];
+
+	if (NULL == (file = fopen(path, "rb"))) {
+		printf("replay_play -> FAILED to open %s\n", path);
+		return 1;
+	}
+
+	if (4 != fread(magic, 1, 4, file) || 0 != memcmp(magic, "PDRP", 4)
+			|| REPLAY_VERSION != read_u8()) {
+		printf("replay_play -> %s is not a replay of this version\n", path);
+		fclose(file);
+		file = NULL;
+		return 1;
+	}
+	*seed = read_u32();
+
+	mode = REPLAY_PLAYING;
+	idle_run = 0;
+	play_over = 0;
+	return OK;
+}
+
+// Private Method -- Queues the events of a REPLAY_FRAME record
+static void replay_feed_events() {
+	unsigned count = read_u16(), i;
+
+	for (i = 0; i < count; ++i) {
+		InputEvent_t ev;
+		ev.type = read_u8();
+		ev.code = read_u16();
+		ev.dx = (int16_t) read_u16();
+		ev.dy = (int16_t) read_u16();
+		input_inject(&ev);
+	}
+}
+
+/** **/
+
+int replay_begin_frame(unsigned * sim_steps) {
+	switch (mode) {
+	case REPLAY_RECORDING:
+		replay_commit_frame();
+		frame_steps = *sim_steps;
+		frame_num_events = 0;
+		frame_pending = 1;
+		return OK;
+	case REPLAY_PLAYING:
+		if (0 != idle_run) {
+			--idle_run;
+			*sim_steps = 1;
+			return OK;
+		}
+
+		switch (read_u8()) {
+		case REPLAY_IDLE:
+			idle_run = read_u8() - 1;
+			*sim_steps = 1;
+			return OK;
+		case REPLAY_FRAME:
+			*sim_steps = read_u8();
+			replay_feed_events();
+			return OK;
+		case REPLAY_DATE:
+			printf("replay_begin_frame -> Unexpected date, replay diverged\n");
+			return 1;
+		default:
+			play_over = 1;	// End of the session
+			return 1;
+		}
+	default:
+		return OK;
+	}
+}
+
+void replay_date(Date_t * date) {
+	switch (mode) {
+	case REPLAY_RECORDING:
+		replay_commit_frame();
+		replay_flush_idle();
+		write_u8(REPLAY_DATE);
+		write_u8(date->minute);
+		write_u8(date->hour);
+		write_u8(date->day);
+		write_u8(date->month);
+		write_u8(date->year);
+		break;
+	case REPLAY_PLAYING:
+		if (0 != idle_run || REPLAY_DATE != read_u8()) {
+			printf("replay_date -> No date recorded here, replay diverged\n");
+			return;
+		}
+		date->minute = read_u8();
+		date->hour = read_u8();
+		date->day = read_u8();
+		date->month = read_u8();
+		date->year = read_u8();
+		break;
+	default:
+		break;
+	}
+}
+
+replay_mode_t replay_mode() {
+	return mode;
+}
+
+// Private Method -- Compares the check at the end of the file with the session's
+static int replay_compare(const ReplayCheck_t * check) {
+	ReplayCheck_t recorded;
+	unsigned tag;
+
+	// Playback may have been stopped early: skip to the end
+	while (!play_over && (REPLAY_IDLE == (tag = read_u8())
+			|| REPLAY_FRAME == tag || REPLAY_DATE == tag)) {
+		if (REPLAY_IDLE == tag)
+			read_u8();
+		else if (REPLAY_DATE == tag)
+			fseek(file, 5, SEEK_CUR);
+		else {
+			read_u8();
+			fseek(file, 7L * read_u16(), SEEK_CUR);
+		}
+	}
+
+	recorded.frames = read_u32();
+	recorded.score = read_u32();
+	recorded.e_missiles = read_u32();
+	recorded.f_missiles = read_u32();
+	recorded.explosions = read_u32();
+
+	if (0 != memcmp(&recorded, check, sizeof(ReplayCheck_t))) {
+		printf("replay_stop -> Replay diverged: recorded %lu frames, score %lu, "
+				"%lu/%lu missiles, %lu explosions\n",
+				(unsigned long) recorded.frames, (unsigned long) recorded.score,
+				(unsigned long) recorded.e_missiles,
+				(unsigned long) recorded.f_missiles,
+				(unsigned long) recorded.explosions);
+		return 1;
+	}
+
+	return OK;
+}
+
+int replay_stop(const ReplayCheck_t * check) {
+	int ret = OK;
+
+	switch (mode) {
+	case REPLAY_RECORDING:
+		replay_commit_frame();
+		replay_flush_idle();
+		write_u8(REPLAY_END);
+		write_u32(check->frames);
+		write_u32(check->score);
+		write_u32(check->e_missiles);
+		write_u32(check->f_missiles);
+		write_u32(check->explosions);
+		if (ferror(file)) {
+			printf("replay_stop -> FAILED to write the replay\n");
+			ret = 1;
+		}
+		break;
+	case REPLAY_PLAYING:
+		ret = replay_compare(check);
+		break;
+	default:
+		return OK;
+	}
+
+	fclose(file);
+	file = NULL;
+	mode = REPLAY_OFF;
+	return ret;
+}
@@ -0,0 +1,121 @@
+#ifndef __REPLAY_H
+#define __REPLAY_H
+
+/** @defgroup Replay Replay
+ * @{
+ * Records a session's input to a file, and plays it back through the same code paths.
+ *
+ * Everything the simulation depends on is logged per timer interrupt: the simulation
+ * steps due, every input event drained, the seed of the random streams and the RTC date read at the
+ * end of a game. Playing the file back feeds the events to the input ring instead of
+ * the devices, so the session is simulated again step by step.
+ * Serial traffic is not recorded, multiplayer sessions do not replay.
+ *
+ * File format, little endian:
+ *  header  "PDRP", version (u8), seed (u32)
+ *  records tag (u8) followed by
+ *   REPLAY_IDLE   count (u8): count interrupts with one step and no events
+ *   REPLAY_FRAME  steps (u8), events (u16), each type (u8), code (u16), dx (i16), dy (i16)
+ *   REPLAY_DATE   minute, hour, day, month, year (u8 each)
+ *   REPLAY_END    frames, score, enemy missiles, friendly missiles, explosions (u32 each)
+ */
+
+#include <stdint.h>
+#include "InputRing.h"
+#include "RTC.h"
+
+#define REPLAY_VERSION	2		/**< @brief Version 1 replays were seeded for rand() */
+
+/**
+ * Record tags
+ */
+typedef enum {
+	REPLAY_END, REPLAY_IDLE, REPLAY_FRAME, REPLAY_DATE
+} replay_tag_t;
+
+/**
+ * What the replay module is doing
+ */
+typedef enum {
+	REPLAY_OFF, REPLAY_RECORDING, REPLAY_PLAYING
+} replay_mode_t;
+
+/**
+ * @brief State of the simulation at the end of a session, a replay must end the same
+ */
+typedef struct {
+	uint32_t frames;		///> Steps simulated in the last game
+	uint32_t score;			///> Score of the last game
+	uint32_t e_missiles;	///> Enemy missiles alive
+	uint32_t f_missiles;	///> Friendly missiles alive
+	uint32_t explosions;	///> Explosions on screen
+} ReplayCheck_t;
+
+/**
+ * @brief Starts recording to a file
+ *
+ * @param path File to write, truncated
+ * @param seed Seed given to rng_seed_streams()
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int replay_record(const char * path, unsigned long seed);
+
+/**
+ * @brief Starts playing a file back
+ *
+ * @param path File to read
+ * @param seed Filled with the seed to give to rng_seed_streams()
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int replay_play(const char * path, unsigned long * seed);
+
+/**
+ * @brief Stops recording or playing, closing the file
+ *
+ * When recording, check is saved at the end of the file. When playing, it is compared
+ * with the one saved.
+ *
+ * @param check State of the simulation at the end of the session
+ *
+ * @return Return 0 upon success, non-zero on a file error or if the replay diverged
+ */
+int replay_stop(const ReplayCheck_t * check);
+
+/**
+ * @brief Gets what the replay module is doing
+ *
+ * @return Current mode
+ */
+replay_mode_t replay_mode();
+
+/**
+ * @brief Starts a timer interrupt. To be called before the input is drained
+ *
+ * When recording, remembers the steps due. When playing, replaces them with the recorded
+ * ones and queues the recorded events.
+ *
+ * @param sim_steps Simulation steps due in this interrupt
+ *
+ * @return Return 0 upon success, non-zero when a playback reached its end
+ */
+int replay_begin_frame(unsigned * sim_steps);
+
+/**
+ * @brief Records an input event drained in the current interrupt. Does nothing unless recording
+ *
+ * @param ev Event drained
+ */
+void replay_log_event(const InputEvent_t * ev);
+
+/**
+ * @brief Records a date read from the RTC, or replaces it with the recorded one
+ *
+ * @param date Date read, overwritten when playing
+ */
+void replay_date(Date_t * date);
+
+/**@}*/
+
+#endif /* __REPLAY_H */
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <string.h>
+#include "Rollback.h"
+
+#define OK			0
+#define NO_FRAME	((unsigned long) -1)
+
+// Inputs are kept from the oldest step that may be simulated again, to the newest remote one
+#define ROLLBACK_RING	(2 * ROLLBACK_WINDOW + 1)
+
+static int active = 0;
+static int attached = 0;		// Whether cb holds the simulation
+static RollbackCb_t cb;
+static unsigned local;			// Index of the local player in the inputs
+static unsigned players = NET_PLAYERS;
+
+static unsigned long current;		// Next step to simulate
+static unsigned long remote_next[NET_PLAYERS];	// Next step whose input is expected, of each remote player
+static unsigned long mispredicted;	// Oldest step simulated with a wrong prediction, or NO_FRAME
+static unsigned long over_frame;	// Step that ended the simulation, or NO_FRAME
+static int over_ret;			// Value that step returned
+
+static NetInput_t inputs[ROLLBACK_RING][NET_PLAYERS];	// Inputs each step was simulated with
+static NetInput_t last_remote[NET_PLAYERS];	// Last input received of each player, what the predictions repeat
+
+static RollbackStats_t stats;
+
+void rollback_start(unsigned local_player, unsigned num_players) {
+	local = local_player;
+	players = num_players;
+
+	current = 0;
+	memset(remote_next, 0, sizeof(remote_next));
+	mispredicted = NO_FRAME;
+	over_frame = NO_FRAME;
+	over_ret = OK;
+
+	memset(inputs, 0, sizeof(inputs));
+	memset(last_remote, 0, sizeof(last_remote));
+	memset(&stats, 0, sizeof(stats));
+
+	active = 1;
+	attached = 0;
+}
+
+unsigned rollback_players() {
+	return players;
+}
+
+void rollback_attach(const RollbackCb_t * callbacks) {
+	cb = *callbacks;
+	attached = 1;
+}
+
+void rollback_stop() {
+	active = 0;
+	attached = 0;
+}
+
+int rollback_active() {
+	return active;
+}
+
+unsigned long rollback_frame() {
+	return current;
+}
+
+// Private Method -- Next step whose input is expected from some remote player: all of them are known before it
+static unsigned long remote_known() {
+	unsigned long known = NO_FRAME;
+	unsigned player;
+
+	for (player = 0; player < players; ++player)
+		if (player != local && remote_next[player] < known)
+			known = remote_next[player];
+	return known;
+}
+
+int rollback_ready() {
+	return active && attached && NO_FRAME == over_frame
+			&& current < remote_known() + ROLLBACK_WINDOW;
+}
+
+// Private Method -- Simulates a step, saving the state before it if asked to
+static int simulate(unsigned long frame, int save) {
+	NetInput_t * in = inputs[frame % ROLLBACK_RING];
+	unsigned player;
+	int ret;
+
+	// Clicks are rare, so predicting none is right far more often than repeating the last one
+	for (player = 0; player < players; ++player) {
+		if (player != local && frame >= remote_next[player]) {
+			in[player] = last_remote[player];
+			in[player].fire = 0;
+		}
+	}
+
+	if (save && OK != cb.save(frame % ROLLBACK_WINDOW)) {
+		printf("rollback -> FAILED to save step %lu\n", frame);
+		return ROLLBACK_FAILED;
+	}
+
+	if (OK != (ret = cb.step(in))) {
+		over_frame = frame;
+		over_ret = ret;
+	}
+	return ret;
+}
+
+// Private Method -- Value to return once the step that ended the simulation is confirmed
+static int confirmed_over() {
+	if (NO_FRAME != over_frame && remote_known() > over_frame)
+		return over_ret;
+	return OK;
+}
+
+int rollback_update() {
+	unsigned long frame;
+
+	if (!active || !attached)
+		return OK;
+
+	if (NO_FRAME != mispredicted) {
+		unsigned long from = mispredicted;
+		mispredicted = NO_FRAME;
+
+		if (OK != cb.load(from % ROLLBACK_WINDOW)) {
+			printf("rollback -> FAILED to load step %lu\n", from);
+			return ROLLBACK_FAILED;
+		}
+
+		// The steps after from are simulated again, with the inputs known now
+		over_frame = NO_FRAME;
+		for (frame = from; frame < current; ++frame) {
+			int ret = simulate(frame, frame != from);
+			if (ROLLBACK_FAILED == ret)
+				return ret;
+			if (OK != ret)
+				break; // Ends sooner now, the later steps are kept for another rollback
+		}
+
+		++stats.rollbacks;
+		stats.resimulated += frame - from;
+		if (frame - from > stats.max_depth)
+			stats.max_depth = frame - from;
+	}
+
+	if (!rollback_ready() && NO_FRAME == over_frame)
+		++stats.stalls;
+
+	return confirmed_over();
+}
+
+int rollback_step(const NetInput_t * input) {
+	int ret;
+
+	if (!rollback_ready())
+		return confirmed_over();
+
+	inputs[current % ROLLBACK_RING][local] = *input;
+	ret = simulate(current, 1);
+	if (ROLLBACK_FAILED == ret)
+		return ret;
+
+	stats.frames = ++current;
+	return confirmed_over();
+}
+
+void rollback_remote_input(unsigned player, unsigned long frame,
+		const NetInput_t * input) {
+	NetInput_t * in;
+	unsigned long simulated;
+
+	if (!active || player >= players || player == local
+			|| frame != remote_next[player])
+		return; // Repeated, out of order, or not a remote player
+	if (frame >= current + ROLLBACK_WINDOW) {
+		printf("rollback -> Remote step %lu too far ahead of %lu\n", frame,
+				current);
+		return;
+	}
+
+	// Steps after the one that ended the simulation were not simulated in this history
+	simulated = NO_FRAME != over_frame ? over_frame + 1 : current;
+
+	// Predicted no clicks, the position alone changes nothing. Players arrive out of step, so the oldest one counts
+	in = &inputs[frame % ROLLBACK_RING][player];
+	if (frame < simulated && 0 != input->fire
+			&& (NO_FRAME == mispredicted || frame < mispredicted))
+		mispredicted = frame;
+
+	*in = *input;
+	last_remote[player] = *input;
+	++remote_next[player];
+}
+
+const NetInput_t * rollback_last_remote(unsigned player) {
+	return &last_remote[player];
+}
+
+const RollbackStats_t * rollback_get_stats() {
+	return &stats;
+}
@@ -0,0 +1,143 @@
+#ifndef __ROLLBACK_H
+#define __ROLLBACK_H
+
+/** @defgroup Rollback Rollback
+ * @{
+ * Keeps the simulations of two to NET_PLAYERS ends in lockstep over slow links,
+ * without waiting for them.
+ *
+ * Every step runs at once with the local input, and a prediction of the remote one:
+ * the last known mouse position, no clicks. The state before each step is saved.
+ * When a remote input of a step arrives and the prediction was wrong, the
+ * simulation goes back to that step and simulates the steps since again, within the
+ * same call. Local clicks thus show up on the next frame, however slow the link.
+ *
+ * The simulation only waits (stalls) when the input of a remote player falls
+ * ROLLBACK_WINDOW steps behind, and when it ended on a step whose remote inputs are not
+ * all known yet. The inputs of the players past those of the session stay zero.
+ */
+
+#include <stdint.h>
+
+#define NET_PLAYERS		4		/**< @brief Players of a session at most */
+#define ROLLBACK_WINDOW	16		/**< @brief Steps simulated ahead of the remote input at most, ~270 ms */
+
+#define NET_FIRE_LEFT	0x01	/**< @brief Clicked the right button: fires from the left cannon */
+#define NET_FIRE_RIGHT	0x02	/**< @brief Clicked the left button: fires from the right cannon */
+
+/**
+ * @brief Input of a player for one simulation step
+ */
+typedef struct {
+	int16_t pos[2];		///> Mouse position
+	uint8_t fire;		///> NET_FIRE_* clicks taken in the step
+} NetInput_t;
+
+/**
+ * @brief Functions the simulation provides
+ */
+typedef struct {
+	int (*save)(unsigned slot);	///> Saves the state to a slot (< ROLLBACK_WINDOW). Returns 0 on success
+	int (*load)(unsigned slot);	///> Goes back to the state saved in a slot. Returns 0 on success
+	int (*step)(const NetInput_t inputs[NET_PLAYERS]);	///> Simulates a step. Non-zero ends the simulation
+} RollbackCb_t;
+
+/**
+ * @brief Counters of a session
+ */
+typedef struct {
+	unsigned long frames;		///> Steps confirmed or predicted
+	unsigned long rollbacks;	///> Mispredictions corrected
+	unsigned long resimulated;	///> Steps simulated again
+	unsigned long stalls;		///> Calls that had to wait for the remote input
+	unsigned max_depth;			///> Most steps simulated again at once
+} RollbackStats_t;
+
+/**
+ * Value of rollback_step() when the saves fail, so the two ends can't be kept equal
+ */
+#define ROLLBACK_FAILED		-1
+
+/**
+ * @brief Starts a session, from step 0. Remote inputs are kept from now on,
+ * steps are simulated once a simulation is attached
+ *
+ * @param local_player Index of the local player in the inputs, below players
+ * @param players Players of the session, 2 to NET_PLAYERS
+ */
+void rollback_start(unsigned local_player, unsigned players);
+
+/**
+ * @brief Players of the current, or last, session
+ */
+unsigned rollback_players();
+
+/**
+ * @brief Attaches the simulation of the session
+ *
+ * @param cb Functions of the simulation, copied
+ */
+void rollback_attach(const RollbackCb_t * cb);
+
+/**
+ * @brief Ends the session. Remote inputs arriving later are ignored
+ */
+void rollback_stop();
+
+/**
+ * @brief Whether a session is running
+ */
+int rollback_active();
+
+/**
+ * @brief Step the next call to rollback_step() simulates
+ */
+unsigned long rollback_frame();
+
+/**
+ * @brief Whether rollback_step() can simulate a step now. If not, the simulation stalls
+ */
+int rollback_ready();
+
+/**
+ * @brief Applies the remote inputs received since the last call, simulating again
+ * the steps they were mispredicted in
+ *
+ * @return 0 while the simulation goes on, the non-zero value of the step that
+ * ended it once the remote input confirmed that step, ROLLBACK_FAILED if a save or load failed
+ */
+int rollback_update();
+
+/**
+ * @brief Simulates the next step. Only call when rollback_ready()
+ *
+ * @param local Local input of the step, sent to the remote end along with rollback_frame()
+ *
+ * @return As rollback_update()
+ */
+int rollback_step(const NetInput_t * local);
+
+/**
+ * @brief Gives the input of a remote player for a step. The steps of each player must
+ * arrive in order
+ *
+ * @param player Index of the remote player
+ * @param frame Step the input belongs to
+ * @param input Remote input, copied
+ */
+void rollback_remote_input(unsigned player, unsigned long frame,
+		const NetInput_t * input);
+
+/**
+ * @brief Last input of a remote player known, to show its cursor
+ */
+const NetInput_t * rollback_last_remote(unsigned player);
+
+/**
+ * @brief Gets the counters of the current, or last, session
+ */
+const RollbackStats_t * rollback_get_stats();
+
+/**@}*/
+
+#endif /* __ROLLBACK_H */
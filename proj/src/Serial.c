@@ -1,36 +1,89 @@
+#if HEADLESS
+#include <stdio.h>
+#else
 #include <minix/syslib.h>
 #include <minix/drivers.h>
+#endif
 
 #include "Serial.h"
+#include "PortIO.h"
+
+/** Rings **/
+
+#define SERIAL_RING_MASK	(SERIAL_RING_SIZE - 1)
+
+typedef struct {
+	unsigned char bytes[SERIAL_RING_SIZE];
+	unsigned head;	// Bytes ever pushed
+	unsigned tail;	// Bytes ever popped
+} ByteRing_t;
+
+typedef struct {
+	unsigned long base;		// First register of the UART
+	unsigned irq;
+	int hook_id;
+	unsigned long bit_rate_now;
+	int tx_idle;			// Transmit FIFO empty, no THR empty interrupt to come
+	ByteRing_t rx_ring;		// Received, not read yet
+	unsigned char rx_errors[SERIAL_RING_SIZE];	// LSR error bits of each byte in rx_ring, at the same index
+	unsigned char rx_pending;	// Errors read from LSR before the byte they came with
+	ByteRing_t tx_ring;		// Written, not handed to the UART yet
+	SerialStats_t stats;
+} SerialPort_t;
+
+static SerialPort_t ports[SERIAL_PORTS] = {
+	{ COM1_PORT, COM1_IRQ, SERIAL_INITIAL_HOOK_ID, SERIAL_BIT_RATE, 1 },
+	{ COM2_PORT, COM2_IRQ, SERIAL_INITIAL_HOOK_ID + 1, SERIAL_BIT_RATE, 1 }
+};
+
+static int ring_push(ByteRing_t * ring, unsigned char byte) {
+	if (ring->head - ring->tail >= SERIAL_RING_SIZE)
+		return 1;
+
+	ring->bytes[ring->head++ & SERIAL_RING_MASK] = byte;
+	return OK;
+}
+
+static int ring_pop(ByteRing_t * ring, unsigned char * byte) {
+	if (ring->tail == ring->head)
+		return 1;
+
+	*byte = ring->bytes[ring->tail++ & SERIAL_RING_MASK];
+	return OK;
+}
+
+/** **/
 
-static int serial_hook_id = SERIAL_INITIAL_HOOK_ID;
+#if !HEADLESS
+int serial_subscribe_int(unsigned port) {
+	int hook = SERIAL_INITIAL_HOOK_ID + port;
 
-int serial_subscribe_int(void) {
-	if (sys_irqsetpolicy(COM1_IRQ, IRQ_REENABLE | IRQ_EXCLUSIVE,
-			&serial_hook_id) != OK) {
+	if (sys_irqsetpolicy(ports[port].irq, IRQ_REENABLE | IRQ_EXCLUSIVE,
+			&ports[port].hook_id) != OK) {
 		printf("serial_subscribe_int() -> FAILED sys_irqsetpolicy()\n");
 		return -1;
 	}
-	if (sys_irqenable(&serial_hook_id) != OK) {
+	if (sys_irqenable(&ports[port].hook_id) != OK) {
 		printf("serial_subscribe_int() -> FAILED sys_irqenable()\n");
 		return -1;
 	}
 
-	return SERIAL_INITIAL_HOOK_ID;
+	return hook;
 }
 
-int serial_unsubscribe_int(void) {
-	if (sys_irqdisable(&serial_hook_id) != OK) {
+int serial_unsubscribe_int(unsigned port) {
+	if (sys_irqdisable(&ports[port].hook_id) != OK) {
 		printf("serial_unsubscribe_int() -> FAILED sys_irqdisable()\n");
 		return -1;
 	}
-	if (sys_irqrmpolicy(&serial_hook_id) != OK) {
+	if (sys_irqrmpolicy(&ports[port].hook_id) != OK) {
 		printf("serial_unsubscribe_int() -> FAILED sys_irqrmpolicy()\n");
 		return -1;
 	}
 
-	return SERIAL_INITIAL_HOOK_ID;
+	return SERIAL_INITIAL_HOOK_ID + port;
 }
+#endif
 
 /* Interrupt Handling */
 
@@ -38,48 +91,49 @@ int serial_unsubscribe_int(void) {
  * "The use of bits 0 and 1 should be obvious: if set, the UART will generate an interrupt whenever
  * a character is received and whenever it is ready to accept a new character for transmission, respectively."
  */
-int serial_enable_interrupts() {
+int serial_enable_interrupts(unsigned port) {
 
 	unsigned long helper_IER = 0;
 
-	if (sys_inb((COM1_PORT + IER), &helper_IER) != OK) {
-		printf("serial_enable_interrupt -> Failed sys_inb.\n");
+	if (port_inb((ports[port].base + IER), &helper_IER) != OK) {
+		printf("serial_enable_interrupt -> Failed port_inb.\n");
 		return 1;
 	}
 
-	//Setting Bit 0 and 1 of the IIR
-	helper_IER = helper_IER | (IER_RDA | IER_RLS);
+	//Setting Bit 0, 1 and 2 of the IER. THR empty fires at once if nothing is being sent
+	helper_IER = helper_IER | (IER_RDA | IER_THRE | IER_RLS);
 
-	if (sys_outb((COM1_PORT + IER), helper_IER) != OK) {
-		printf("serial_enable_interrupt -> Failed sys_outb.\n");
+	if (port_outb((ports[port].base + IER), helper_IER) != OK) {
+		printf("serial_enable_interrupt -> Failed port_outb.\n");
 		return 1;
 	}
 
-	tickdelay(micros_to_ticks(10000));
+	port_delay(10000);
 
 	return OK;
 }
 
 //Opposite purpose of serial_enable_interrupt
-int serial_disable_interrupts() {
+int serial_disable_interrupts(unsigned port) {
 
 	unsigned long helper_IER = 0;
 
-	if (sys_inb((COM1_PORT + IER), &helper_IER) != OK) {
-		printf("serial_disable_interrupt -> Failed sys_inb.\n");
+	if (port_inb((ports[port].base + IER), &helper_IER) != OK) {
+		printf("serial_disable_interrupt -> Failed port_inb.\n");
 		return 1;
 	}
 
-	//Changing Bit 0 and 1 of the IIR to 0.
+	//Changing Bit 0, 1 and 2 of the IER to 0.
 	helper_IER = helper_IER & (~IER_RDA) ;
+	helper_IER = helper_IER & (~IER_THRE) ;
 	helper_IER = helper_IER & (~IER_RLS) ;
 
-	if (sys_outb((COM1_PORT + IER), helper_IER) != OK) {
-		printf("serial_disable_interrupt -> Failed sys_outb.\n");
+	if (port_outb((ports[port].base + IER), helper_IER) != OK) {
+		printf("serial_disable_interrupt -> Failed port_outb.\n");
 		return 1;
 	}
 
-	tickdelay(micros_to_ticks(10000));
+	port_delay(10000);
 
 	return OK;
 }
@@ -89,18 +143,18 @@ int serial_disable_interrupts() {
  * In the case of asynchronous communication these include the bit rate,
  * the number of bits per character, the number of stop bits and the parity.
  */
-int serial_set_conf() {
+int serial_set_conf(unsigned port) {
 
 	unsigned long configuration = 0;
 
-	if (serial_disable_interrupts() != OK) {
+	if (serial_disable_interrupts(port) != OK) {
 		printf("FAILED serial_enable_interrupts()\n");
 		return 1;
 	}
 
 	//Fetching LCR
-	if (sys_inb((COM1_PORT + LCR), &configuration) != OK) {
-		printf(" serial_set_conf -> Failed sys_inb for configuration.\n");
+	if (port_inb((ports[port].base + LCR), &configuration) != OK) {
+		printf(" serial_set_conf -> Failed port_inb for configuration.\n");
 		return 1;
 	}
 
@@ -120,84 +174,183 @@ int serial_set_conf() {
 	//configuration |= 0;
 
 	//Updating Configuration
-	if (sys_outb((COM1_PORT + LCR), configuration) != OK) {
-		printf(" serial_set_conf -> Failed sys_outb for configuration.\n");
+	if (port_outb((ports[port].base + LCR), configuration) != OK) {
+		printf(" serial_set_conf -> Failed port_outb for configuration.\n");
+		return 1;
+	}
+
+	if (serial_set_rate(port, SERIAL_BIT_RATE) != OK)
+		return 1;
+
+	//Enabling and clearing both FIFOs
+	if (port_outb((ports[port].base + FCR),
+			FIFO_EN | FIFO_CR | FIFO_CX | FIFO_TRIGGER_8) != OK) {
+		printf(" serial_set_conf -> Failed port_outb for FCR.\n");
+		return 1;
+	}
+
+	ports[port].rx_ring.head = ports[port].rx_ring.tail = 0;
+	ports[port].rx_pending = 0;
+	ports[port].tx_ring.head = ports[port].tx_ring.tail = 0;
+	ports[port].tx_idle = 1;
+
+	return OK;
+}
+
+int serial_set_rate(unsigned port, unsigned long rate) {
+
+	if (0 == rate || rate > SERIAL_BASE_BR || 0 != SERIAL_BASE_BR % rate) {
+		printf(" serial_set_rate -> %lu is not a rate the UART can use.\n", rate);
 		return 1;
 	}
 
 	//Setting the bit-rate frequency dividor
-	unsigned long bit_rate = SERIAL_BASE_BR / SERIAL_BIT_RATE;
+	unsigned long bit_rate = SERIAL_BASE_BR / rate;
 	char msb = (bit_rate >> 8) & 0xFF;
 	char lsb = bit_rate & 0xFF;
 
 	//Setting DLAB to 1
 	unsigned long helper_DLAB = 0;
 
-	if (sys_inb((COM1_PORT + LCR), &helper_DLAB) != OK) {
-		printf(" serial_set_conf -> Failed sys_inb for DLAB.\n");
+	if (port_inb((ports[port].base + LCR), &helper_DLAB) != OK) {
+		printf(" serial_set_rate -> Failed port_inb for DLAB.\n");
 		return 1;
 	}
 
 	helper_DLAB = helper_DLAB | LCR_DLAB;
 
-	if (sys_outb((COM1_PORT + LCR), helper_DLAB) != OK) {
-		printf(" serial_set_conf -> Failed sys_outb for DLAB.\n");
+	if (port_outb((ports[port].base + LCR), helper_DLAB) != OK) {
+		printf(" serial_set_rate -> Failed port_outb for DLAB.\n");
 		return 1;
 	}
 
 	//Writing MSB to DLM register
-	if (sys_outb((COM1_PORT + DLM), msb) != OK) {
-		printf(" serial_set_conf -> Failed sys_outb for DLM.\n");
+	if (port_outb((ports[port].base + DLM), msb) != OK) {
+		printf(" serial_set_rate -> Failed port_outb for DLM.\n");
 		return 1;
 	}
 
 	//Writing LSB to DLL register
-	if (sys_outb((COM1_PORT + DLL), lsb) != OK) {
-		printf(" serial_set_conf -> Failed sys_outb for DLL.\n");
+	if (port_outb((ports[port].base + DLL), lsb) != OK) {
+		printf(" serial_set_rate -> Failed port_outb for DLL.\n");
 		return 1;
 	}
 
 	//Re setting the DLAB register to 0
 	helper_DLAB ^= LCR_DLAB;
 
-	if (sys_outb((COM1_PORT + LCR), helper_DLAB) != OK) {
-		printf(" serial_set_conf -> Failed sys_outb for DLAB.\n");
+	if (port_outb((ports[port].base + LCR), helper_DLAB) != OK) {
+		printf(" serial_set_rate -> Failed port_outb for DLAB.\n");
 		return 1;
 	}
 
+	ports[port].bit_rate_now = rate;
 	return OK;
 }
 
-unsigned char serial_read() {
-	unsigned long received = 0;
+unsigned long serial_get_rate(unsigned port) {
+	return ports[port].bit_rate_now;
+}
+
+int serial_tx_drained(unsigned port) {
 	unsigned long status = 0;
 
-	sys_inb(COM1_PORT + LSR, &status);
+	if (ports[port].tx_ring.head != ports[port].tx_ring.tail)
+		return 0;
+
+	return OK == port_inb(ports[port].base + LSR, &status) && (status & LSR_TER);
+}
+
+// Private Method -- Moves everything in the receive FIFO to the receive ring, with the
+// errors of each byte. Reading LSR clears them, so they are kept as the byte is read
+static void serial_rx_drain(SerialPort_t * p) {
+	unsigned long status = 0, received = 0;
+
+	while (OK == port_inb(p->base + LSR, &status) && (status & LSR_RD)) {
+		if (status & SERIAL_LINE_ERRORS)
+			++p->stats.line_errors;
+
+		port_inb(p->base + RBR, &received);
+		++p->stats.rx_bytes;
+		if (OK != ring_push(&p->rx_ring, received & 0xFF)) {
+			++p->stats.rx_dropped;
+			p->rx_pending |= LSR_OE; // The next byte follows a gap
+			continue;
+		}
+		p->rx_errors[(p->rx_ring.head - 1) & SERIAL_RING_MASK] =
+				(status & SERIAL_LINE_ERRORS) | p->rx_pending;
+		p->rx_pending = 0;
+	}
+}
+
+// Private Method -- Fills the (empty) transmit FIFO from the transmit ring
+static void serial_tx_fill(SerialPort_t * p) {
+	unsigned char byte;
+	unsigned sent = 0;
+
+	while (sent < SERIAL_FIFO_SIZE && OK == ring_pop(&p->tx_ring, &byte)) {
+		port_outb(p->base + THR, byte);
+		++sent;
+	}
+
+	p->stats.tx_bytes += sent;
+	p->tx_idle = (0 == sent); // Otherwise THR empty fires once these are out
+}
 
-	if (status & SERIAL_RECEIVED_DATA) {
-		sys_inb(COM1_PORT + RBR, &received);
-		return (unsigned char) (received & 0xFF);
+void serial_irq_handler(unsigned port) {
+	SerialPort_t * p = &ports[port];
+	unsigned long iir = 0, status = 0;
+
+	while (OK == port_inb(ports[port].base + IIR, &iir) && !(iir & IIR_NPI)) {
+		switch (iir & IIR_ID) {
+		case IIR_ID_LSR:
+			// Goes with the byte at the head of the FIFO, or the next one after an overrun
+			port_inb(ports[port].base + LSR, &status);
+			if (status & SERIAL_LINE_ERRORS) {
+				++p->stats.line_errors;
+				p->rx_pending |= status & SERIAL_LINE_ERRORS;
+			}
+			break;
+		case IIR_ID_RDA:
+		case IIR_ID_TIMEOUT:
+			serial_rx_drain(p);
+			break;
+		case IIR_ID_THRE:
+			serial_tx_fill(p);
+			break;
+		default: // Modem status, cleared by reading MSR
+			port_inb(ports[port].base + MSR, &status);
+			break;
+		}
 	}
+}
+
+int serial_read(unsigned port, unsigned char * byte, unsigned char * errors) {
+	SerialPort_t * p = &ports[port];
 
-	return 0;
+	*errors = p->rx_errors[p->rx_ring.tail & SERIAL_RING_MASK];
+	return ring_pop(&p->rx_ring, byte);
 }
 
-int serial_write(unsigned char info) {
-	printf("SerialWrite: %x\n", info);
+unsigned serial_tx_free(unsigned port) {
+	return SERIAL_RING_SIZE - (ports[port].tx_ring.head - ports[port].tx_ring.tail);
+}
 
-	// Transmitter Holding Register is empty ?
-	unsigned long received = 0;
-	do {
-		sys_inb(COM1_PORT + LSR, &received);
-		printf("_-_");
-	} while( ! (received & SERIAL_THR_EMPTY) );
+int serial_write(unsigned port, unsigned char info) {
+	SerialPort_t * p = &ports[port];
 
-	if (sys_outb((COM1_PORT + THR), info) != OK) {
-		printf(" serial_write -> Failed sys_outb of information.\n");
+	if (OK != ring_push(&p->tx_ring, info)) {
+		++p->stats.tx_dropped;
 		return 1;
 	}
 
-	tickdelay(micros_to_ticks(10000));
+	// Nothing is being sent, so no THR empty interrupt would pick the byte up
+	if (p->tx_idle)
+		serial_tx_fill(p);
 
 	return OK;
 }
+
+const SerialStats_t * serial_get_stats(unsigned port) {
+	return &ports[port].stats;
+}
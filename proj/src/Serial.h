@@ -5,8 +5,17 @@
  * @{
  *
  * Functions for using the Serial Port
+ *
+ * Bytes go through the 16550 FIFOs and two rings: serial_write() only queues, and the
+ * THR empty interrupt feeds the transmit FIFO; the received data interrupts move
+ * whole FIFOs to the receive ring, serial_read() takes from it. Neither ever waits.
+ *
+ * Every function takes the port: SERIAL_COM1 or SERIAL_COM2, each with its own rings,
+ * rate and counters.
  */
 
+#include <stdint.h>
+
 /* Useful Macros for the Serial Port */
 
 #define BIT(n) (0x01<<(n))
@@ -18,7 +27,11 @@
 #define COM1_PORT 0x3F8
 #define COM2_PORT 0x2F8
 
-#define SERIAL_INITIAL_HOOK_ID	3
+#define SERIAL_INITIAL_HOOK_ID	3	/**< @brief Hook of COM1, COM2 has the next one */
+
+#define SERIAL_COM1		0	/**< @brief The UART at COM1_PORT */
+#define SERIAL_COM2		1	/**< @brief The UART at COM2_PORT */
+#define SERIAL_PORTS	2	/**< @brief Number of serial ports */
 
 
 /* UART Acessible (8-bit) Registers */
@@ -52,8 +65,9 @@
 
 /* Line Control Register (LCR) */
 
-#define SERIAL_BIT_RATE		1200 // Good Value?
-#define SERIAL_BASE_BR		115200
+#define SERIAL_BIT_RATE		1200	/**< @brief Rate both ends start at, and go back to when a faster one fails */
+#define SERIAL_MAX_BIT_RATE	115200	/**< @brief Fastest rate this end offers */
+#define SERIAL_BASE_BR		115200	/**< @brief Rate of a divisor of 1 */
 
 #define LCR_DLAB	BIT(7)	/**< @brief Divisor Latch Access */
 #define LCR_BC		BIT(6)	/**< @brief Break Control */
@@ -74,6 +88,7 @@
 #define LSR_PE		BIT(2)	/**< @brief Parity Error */
 #define LSR_OE		BIT(1)	/**< @brief Overrun Error */
 #define LSR_RD		BIT(0)	/**< @brief Receiver is Ready */
+#define SERIAL_LINE_ERRORS	(LSR_OE | LSR_PE | LSR_FE | LSR_BI)	/**< @brief LSR bits of a byte received wrong */
 
 /* Interrupt Enable Register (IER) - Enables certain Interrupts*/
 
@@ -88,7 +103,13 @@
 #define IIR_RX		BIT(2)	/**< @brief IIR received interrupt */
 #define IIR_NPI		BIT(0)	/**< @brief Non Pending Interrupts */
 #define IIR_LSR		BIT(2)|BIT(1)
-#define IIR_ID		BIT(1) || BIT(2) || BIT(3)	/**< @brief Bits for pending interrupts information */
+#define IIR_ID		(BIT(1) | BIT(2) | BIT(3))	/**< @brief Bits for pending interrupts information */
+
+#define IIR_ID_MODEM	0x00	/**< @brief Modem status changed */
+#define IIR_ID_THRE		0x02	/**< @brief Transmitter holding register (FIFO) empty */
+#define IIR_ID_RDA		0x04	/**< @brief Received data reached the FIFO trigger level */
+#define IIR_ID_LSR		0x06	/**< @brief Receiver line status: an error or break */
+#define IIR_ID_TIMEOUT	0x0C	/**< @brief Data waits in the receive FIFO, below the trigger level */
 
 /* UART FIFO Control Register */
 
@@ -101,58 +122,117 @@
 #define FIFO_CR		BIT(1)	/**< @brief Clear bytes in RCVR FIFO */
 #define FIFO_EN		BIT(0)	/**< @brief Enable both FIFO's */
 
+#define FIFO_TRIGGER_8	FIFO_RCVR1	/**< @brief Received data interrupt once 8 bytes wait */
+
+#define SERIAL_FIFO_SIZE	16		/**< @brief Bytes the 16550 transmit FIFO holds */
+#define SERIAL_RING_SIZE	1024	/**< @brief Capacity of each ring, must be a power of two */
+
+/**
+ * @brief Counters of the serial port
+ */
+typedef struct {
+	unsigned long rx_bytes;		///> Bytes received
+	unsigned long tx_bytes;		///> Bytes handed to the UART
+	unsigned long rx_dropped;	///> Bytes lost because the receive ring was full
+	unsigned long tx_dropped;	///> Bytes not queued because the transmit ring was full
+	unsigned long line_errors;	///> Overrun, parity, framing errors and breaks seen in LSR
+} SerialStats_t;
+
 /**
  * @brief Subscribes and enables Serial Port interrupts
  *
+ * @param port SERIAL_COM1 or SERIAL_COM2
+ *
  * @return Returns bit order in interrupt mask; negative value on failure
  */
-int serial_subscribe_int(void);
+int serial_subscribe_int(unsigned port);
 
 /**
  * @brief Unsubscribes Serial Port interrupts
  *
  * @return Return 0 upon success and non-zero otherwise
  */
-int serial_unsubscribe_int(void);
+int serial_unsubscribe_int(unsigned port);
 
 /**
- * @brief Enables Interrupt Mode for the Serial Port
+ * @brief Enables Interrupt Mode for the Serial Port: received data, line status and THR empty
  *
  * @return Return 0 upon success and non-zero otherwise
  */
-int serial_enable_interrupts();
+int serial_enable_interrupts(unsigned port);
 
 /**
  * @brief Disables Interruptions in the Serial Port
  *
  * @return Return 0 upon success and non-zero otherwise
  */
-int serial_disable_interrupts();
+int serial_disable_interrupts(unsigned port);
 
 /**
- * @brief Sets the desired configuration of the UART registers
+ * @brief Sets the desired configuration of the UART registers, and enables the FIFOs
  *
  * This function should be called in both serial port ends, and any transmission of information
  *
  * @return Return 0 upon success and non-zero otherwise
  */
-int serial_set_conf();
+int serial_set_conf(unsigned port);
 
 /**
- * @brief Reads information received using the serial port
+ * @brief Changes the bit rate. Bytes still being sent are garbled, see serial_tx_drained()
+ *
+ * @param rate Bits per second, a divisor of SERIAL_BASE_BR
  *
- * @return unsigned char read from the Receiver Buffer
+ * @return Return 0 upon success and non-zero otherwise
  */
-unsigned char serial_read();
+int serial_set_rate(unsigned port, unsigned long rate);
 
 /**
- * @brief Sends information using the serial port
+ * @brief Gets the current bit rate
+ *
+ * @return Bits per second
+ */
+unsigned long serial_get_rate(unsigned port);
+
+/**
+ * @brief Whether every byte written has left the UART, so the rate can change
+ */
+int serial_tx_drained(unsigned port);
+
+/**
+ * @brief Services the UART: handles every pending interrupt, draining the receive FIFO
+ * to the receive ring and refilling the transmit FIFO from the transmit ring
+ */
+void serial_irq_handler(unsigned port);
+
+/**
+ * @brief Takes a byte received using the serial port, from the receive ring
+ *
+ * @param byte Where to store the byte
+ * @param errors Where to store the line errors the byte came with (SERIAL_LINE_ERRORS
+ * bits), 0 if none. An overrun, or a byte dropped with the ring full, flags the byte after the gap
+ *
+ * @return Return 0 upon success, non-zero if no byte was waiting
+ */
+int serial_read(unsigned port, unsigned char * byte, unsigned char * errors);
+
+/**
+ * @brief Queues a byte to be sent using the serial port. Never waits
  *
  * @param info information going to be send
  *
- * @return Return 0 upon success and non-zero otherwise
+ * @return Return 0 upon success, non-zero if the transmit ring was full and the byte was dropped
+ */
+int serial_write(unsigned port, unsigned char info);
+
+/**
+ * @brief Room left in the transmit ring, in bytes: as many serial_write() calls succeed
+ */
+unsigned serial_tx_free(unsigned port);
+
+/**
+ * @brief Gets the counters of the serial port
  */
-int serial_write(unsigned char info);
+const SerialStats_t * serial_get_stats(unsigned port);
 
 /**@}*/
 
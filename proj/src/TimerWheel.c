@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "TimerWheel.h"
+
+struct wheel_timer_t {
+	unsigned long frame;	// Frame in which the timer expires
+	wheel_cb_t cb;
+	void * data;
+
+	WheelTimer * prev;		// Circular doubly-linked list, for O(1) cancel
+	WheelTimer * next;
+};
+
+struct timer_wheel_t {
+	unsigned long now;		// Last frame advanced to
+
+	WheelTimer slots[WHEEL_LEVELS][WHEEL_SIZE];	// List heads (sentinels)
+
+	WheelTimer * free_list;	// Recycled timers, avoids a malloc per event
+};
+
+/** List helpers **/
+
+static void list_init(WheelTimer * head) {
+	head->prev = head;
+	head->next = head;
+}
+
+static void list_unlink(WheelTimer * node) {
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+}
+
+static void list_append(WheelTimer * head, WheelTimer * node) {
+	node->prev = head->prev;
+	node->next = head;
+	head->prev->next = node;
+	head->prev = node;
+}
+
+// Moves every node of src to the (empty) dst list
+static void list_move(WheelTimer * src, WheelTimer * dst) {
+	if (src->next == src) {
+		list_init(dst);
+		return;
+	}
+
+	dst->next = src->next;
+	dst->prev = src->prev;
+	dst->next->prev = dst;
+	dst->prev->next = dst;
+	list_init(src);
+}
+
+/** **/
+
+TimerWheel * new_timer_wheel(unsigned long now) {
+	TimerWheel * self = (TimerWheel *) malloc(sizeof(TimerWheel));
+	if (NULL == self)
+		return NULL;
+
+	unsigned level, slot;
+	for (level = 0; level < WHEEL_LEVELS; ++level)
+		for (slot = 0; slot < WHEEL_SIZE; ++slot)
+			list_init(&self->slots[level][slot]);
+
+	self->now = now;
+	self->free_list = NULL;
+
+	return self;
+}
+
+void delete_timer_wheel(TimerWheel * self) {
+	unsigned level, slot;
+	for (level = 0; level < WHEEL_LEVELS; ++level) {
+		for (slot = 0; slot < WHEEL_SIZE; ++slot) {
+			WheelTimer * head = &self->slots[level][slot];
+			while (head->next != head) {
+				WheelTimer * node = head->next;
+				list_unlink(node);
+				free(node);
+			}
+		}
+	}
+
+	while (NULL != self->free_list) {
+		WheelTimer * node = self->free_list;
+		self->free_list = node->next;
+		free(node);
+	}
+
+	free(self);
+}
+
+unsigned long timer_wheel_now(TimerWheel * self) {
+	return self->now;
+}
+
+// Private Method -- Places a timer in the slot matching its distance to now
+static void timer_wheel_place(TimerWheel * self, WheelTimer * timer) {
+	unsigned long frame = timer->frame > self->now ? timer->frame : self->now + 1;
+	unsigned long delta = frame - self->now;
+
+	unsigned level = 0;
+	while (level < WHEEL_LEVELS - 1
+			&& delta >= (1UL << (WHEEL_BITS * (level + 1))))
+		++level;
+
+	// Too far away for the wheel: park it in the furthest slot, it is re-placed on cascade
+	if (delta >= (1UL << (WHEEL_BITS * WHEEL_LEVELS)))
+		frame = self->now + (1UL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+	list_append(&self->slots[level][(frame >> (WHEEL_BITS * level)) & WHEEL_MASK],
+			timer);
+}
+
+WheelTimer * timer_wheel_add(TimerWheel * self, unsigned long frame,
+		wheel_cb_t cb, void * data) {
+	WheelTimer * timer;
+
+	if (NULL != self->free_list) {
+		timer = self->free_list;
+		self->free_list = timer->next;
+	} else {
+		timer = (WheelTimer *) malloc(sizeof(WheelTimer));
+		if (NULL == timer) {
+			printf("timer_wheel_add -> FAILED malloc()\n");
+			return NULL;
+		}
+	}
+
+	timer->frame = frame;
+	timer->cb = cb;
+	timer->data = data;
+
+	timer_wheel_place(self, timer);
+
+	return timer;
+}
+
+// Private Method
+static void timer_wheel_recycle(TimerWheel * self, WheelTimer * timer) {
+	timer->next = self->free_list;
+	self->free_list = timer;
+}
+
+void timer_wheel_cancel(TimerWheel * self, WheelTimer * timer) {
+	if (NULL == timer)
+		return;
+
+	list_unlink(timer);
+	timer_wheel_recycle(self, timer);
+}
+
+void timer_wheel_reset(TimerWheel * self, unsigned long now) {
+	unsigned level, slot;
+	for (level = 0; level < WHEEL_LEVELS; ++level) {
+		for (slot = 0; slot < WHEEL_SIZE; ++slot) {
+			WheelTimer * head = &self->slots[level][slot];
+			while (head->next != head) {
+				WheelTimer * node = head->next;
+				list_unlink(node);
+				timer_wheel_recycle(self, node);
+			}
+		}
+	}
+
+	self->now = now;
+}
+
+// Private Method -- Re-places the timers of a coarse slot. Returns the slot index
+static unsigned timer_wheel_cascade(TimerWheel * self, unsigned level) {
+	unsigned slot = (self->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	WheelTimer pending;
+
+	list_move(&self->slots[level][slot], &pending);
+	while (pending.next != &pending) {
+		WheelTimer * timer = pending.next;
+		list_unlink(timer);
+		timer_wheel_place(self, timer);
+	}
+
+	return slot;
+}
+
+void timer_wheel_advance(TimerWheel * self, unsigned long now) {
+	while (self->now < now) {
+		++(self->now);
+
+		// Refill finer levels when a coarser slot comes into range
+		unsigned level = 1;
+		if (0 == (self->now & WHEEL_MASK)) {
+			while (level < WHEEL_LEVELS && 0 == timer_wheel_cascade(self, level))
+				++level;
+		}
+
+		// Detach the expiring slot first, so callbacks can safely add/cancel timers
+		WheelTimer expired;
+		list_move(&self->slots[0][self->now & WHEEL_MASK], &expired);
+
+		while (expired.next != &expired) {
+			WheelTimer * timer = expired.next;
+			list_unlink(timer);
+
+			if (timer->frame > self->now) {	// Parked far-away timer
+				timer_wheel_place(self, timer);
+				continue;
+			}
+
+			wheel_cb_t cb = timer->cb;
+			void * data = timer->data;
+			timer_wheel_recycle(self, timer);
+			cb(data);
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#ifndef __TIMER_WHEEL_H
+#define __TIMER_WHEEL_H
+
+/** @defgroup TimerWheel TimerWheel
+ * @{
+ * Hierarchical timer wheel, scheduling callbacks on frame numbers.
+ *
+ * Insertion and cancellation are O(1), and advancing one frame only costs
+ * the events due in that frame (plus an occasional cascade of a coarser level).
+ */
+
+#define WHEEL_BITS		6						/**< @brief log2 of the number of slots per level */
+#define WHEEL_SIZE		(1 << WHEEL_BITS)		/**< @brief Number of slots per level */
+#define WHEEL_MASK		(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS	4						/**< @brief Levels cover 2^24 frames (~77h at 60 fps) */
+
+struct timer_wheel_t;
+typedef struct timer_wheel_t TimerWheel;
+
+struct wheel_timer_t;
+typedef struct wheel_timer_t WheelTimer;
+
+/**
+ * @brief Function called when a timer expires
+ *
+ * @param data Pointer given when the timer was added
+ */
+typedef void (*wheel_cb_t)(void * data);
+
+/**
+ * @brief Constructs a new, empty, TimerWheel
+ *
+ * @param now Current frame
+ *
+ * @return Pointer to the newly created TimerWheel
+ */
+TimerWheel * new_timer_wheel(unsigned long now);
+
+/**
+ * @brief Deletes a TimerWheel. Pending timers are discarded without being called
+ *
+ * @param self Pointer to the TimerWheel to be deleted
+ */
+void delete_timer_wheel(TimerWheel * self);
+
+/**
+ * @brief Gets the current frame of the TimerWheel
+ *
+ * @param self Pointer to the TimerWheel
+ *
+ * @return Last frame the TimerWheel was advanced to
+ */
+unsigned long timer_wheel_now(TimerWheel * self);
+
+/**
+ * @brief Schedules a callback, in O(1)
+ *
+ * Timers scheduled for the current frame, or a past one, expire on the next advance.
+ * Timers expiring on the same frame are called in the order they were added.
+ *
+ * @param self Pointer to the TimerWheel
+ * @param frame Frame in which the callback should be called
+ * @param cb Function to call
+ * @param data Argument passed to cb
+ *
+ * @return Handle to the timer, valid until it expires or is cancelled
+ */
+WheelTimer * timer_wheel_add(TimerWheel * self, unsigned long frame,
+		wheel_cb_t cb, void * data);
+
+/**
+ * @brief Cancels a pending timer, in O(1)
+ *
+ * @param self Pointer to the TimerWheel
+ * @param timer Handle returned by timer_wheel_add(). Must not have expired yet
+ */
+void timer_wheel_cancel(TimerWheel * self, WheelTimer * timer);
+
+/**
+ * @brief Cancels every pending timer and moves the TimerWheel to another frame.
+ * The timers are kept for reuse, so adding as many again allocates nothing
+ *
+ * @param self Pointer to the TimerWheel
+ * @param now New current frame, may be earlier than the current one
+ */
+void timer_wheel_reset(TimerWheel * self, unsigned long now);
+
+/**
+ * @brief Advances the TimerWheel up to a frame, calling every timer due until then
+ *
+ * Callbacks may add or cancel timers.
+ *
+ * @param self Pointer to the TimerWheel
+ * @param now Frame to advance to
+ */
+void timer_wheel_advance(TimerWheel * self, unsigned long now);
+
+/**@}*/
+
+#endif /* __TIMER_WHEEL_H */
@@ -4,6 +4,7 @@
 #include <minix/sysutil.h>
 #include <time.h>	// for the random seed
 #include <stdlib.h>
+#include <string.h>
 #include "video_gr.h"
 #include "Input.h"
 #include "stddef.h"
@@ -11,14 +12,52 @@
 #include "planetary.h"
 #include "vbe.h"
 #include "RTC.h"
-
-/* Interrupt Handlers' Loop */
-int main() {
+#include "Replay.h"
+#include "Random.h"
+#include "Serial.h"
+#include "Frame.h"
+#include "Highscores.h"
+#include "Clock.h"
+
+/* Interrupt Handlers' Loop
+ * Arguments: "record <file>" logs the session's input, "replay <file>" plays it back,
+ * "watch" watches the multiplayer games instead of playing them, "ring <nodes> <index> [rate]"
+ * plays them in a ring of machines, through COM1 and COM2. "export <file>" writes the
+ * leaderboard as text, "import <file>" adds the scores of such a file to it. "clock [hz]"
+ * tells the time with the periodic interrupt of the RTC, 8192 Hz by default */
+int main(int argc, char ** argv) {
 	printf("\t\t\tSTART OF PROJECT SERVICE\n");
 	sef_startup();
 	sys_enable_iop(SELF);
 
-	srand(time(NULL));
+	unsigned long seed = time(NULL);
+	unsigned ports = 1, port;	// Serial ports used, from COM1 on
+	unsigned long clock_hz = 0;	// Frequency of the RTC periodic interrupt, 0 for none
+	if (3 == argc && 0 == strcmp(argv[1], "record")) {
+		if (OK != replay_record(argv[2], seed))
+			return 1;
+	} else if (3 == argc && 0 == strcmp(argv[1], "replay")) {
+		if (OK != replay_play(argv[2], &seed))
+			return 1;
+	} else if (2 == argc && 0 == strcmp(argv[1], "watch")) {
+		planetary_set_watch(1);
+	} else if ((4 == argc || 5 == argc) && 0 == strcmp(argv[1], "ring")) {
+		unsigned long rate = 5 == argc ? strtoul(argv[4], NULL, 10) : SERIAL_MAX_BIT_RATE;
+		if (OK != planetary_set_ring(atoi(argv[2]), atoi(argv[3]), rate))
+			return 1;
+		ports = SERIAL_PORTS;
+	} else if ((2 == argc || 3 == argc) && 0 == strcmp(argv[1], "clock")) {
+		clock_hz = 3 == argc ? strtoul(argv[2], NULL, 10) : RTC_PERIODIC_MAX_HZ;
+	} else if (3 == argc && 0 == strcmp(argv[1], "export")) {
+		highscores_open(SCORES_PATH, SCORES_TXT_PATH);
+		return highscores_export(argv[2], 0);
+	} else if (3 == argc && 0 == strcmp(argv[1], "import")) {
+		if (OK != highscores_open(SCORES_PATH, SCORES_TXT_PATH)
+				|| OK != highscores_import(argv[2]) || OK != highscores_save())
+			return 1;
+		return highscores_flush();
+	}
+	rng_seed_streams(seed);
 
 	int ipc_status;
 	message msg;
@@ -35,7 +74,9 @@ int main() {
 		return 1;
 	}
 	int timer_irq_set;
-	unsigned timer_freq = 60;
+	unsigned timer_freq = RENDER_RATE;
+	planetary_set_render_rate(timer_freq);
+	planetary_measure_time(1);
 	if ((timer_irq_set = BIT(timer_subscribe_int()))
 			< 0|| timer_set_square(0, timer_freq) != OK) { // hook_id returned for Timer 0
 		printf("FAILED timer_subscribe_int()\n");
@@ -46,19 +87,31 @@ int main() {
 		printf("FAILED rtc_subscribe_int()\n");
 		return 1;
 	}
-
-	//Setting Serial configuration
-	if (serial_set_conf() != OK) {
-		printf("FAILED serial_set_conf()\n");
+	if (rtc_enable_int(B_UEI) != OK) { // The date, read once a second
+		printf("FAILED rtc_enable_int()\n");
 		return 1;
 	}
-
-	int serial_irq_set;
-	if ((serial_irq_set = BIT(serial_subscribe_int())) < 0) {
-		printf("FAILED serial_subscribe_int()\n");
+	if (0 != clock_hz && clock_use_rtc(clock_hz) != OK) {
+		printf("FAILED clock_use_rtc()\n");
 		return 1;
 	}
 
+	//Setting Serial configuration
+	int serial_irq_set = 0;
+	for (port = 0; port < ports; ++port) {
+		if (serial_set_conf(port) != OK) {
+			printf("FAILED serial_set_conf()\n");
+			return 1;
+		}
+
+		int hook;
+		if ((hook = serial_subscribe_int(port)) < 0) {
+			printf("FAILED serial_subscribe_int()\n");
+			return 1;
+		}
+		serial_irq_set |= BIT(hook);
+	}
+
 	/* ** */
 
 	//Initiate Graphics Mode
@@ -67,12 +120,10 @@ int main() {
 		return 1;
 	}
 
-	// Mouse Packets
-	unsigned char packet[PACKET_NELEMENTS];
-	unsigned short counter = 0; // Keeps the number of bytes ready in the packet
-
 	int r;
 	int gameRunning = 1;
+	unsigned long frames = 0;	// Timer interrupts handled
+	uint64_t frame_us, frames_us = 0, frame_max_us = 0;	// Time they took
 	while (gameRunning) {
 		/* Get a request message. */
 		if ((r = driver_receive(ANY, &msg, &ipc_status)) != 0) {
@@ -82,17 +133,16 @@ int main() {
 		if (is_ipc_notify(ipc_status)) { /* received notification */
 			switch (_ENDPOINT_P(msg.m_source)) {
 			case HARDWARE: /* hardware interrupt notification */
+				if (msg.NOTIFY_ARG & rtc_irq_set) { /* RTC interrupt, first: the others are timed by it */
+					rtc_ih();
+				}
+
 				if (msg.NOTIFY_ARG & mouse_irq_set) {
 
-					mouse_handler(packet, &counter);
-					if (counter == PACKET_NELEMENTS) {
-						mouse_packet_handler(packet);
-						counter = 0;
-					}
+					mouse_handler(mouse_packet_handler);
 				}
 
 				if (msg.NOTIFY_ARG & serial_irq_set) { /* serial interrupt */
-					printf("Received serial!!!\n");
 					serial_handler();
 
 				}
@@ -104,11 +154,19 @@ int main() {
 
 				if (msg.NOTIFY_ARG & timer_irq_set) { /* timer interrupt */
 
+					uint64_t frame_start = now_us();
 					if ( OK != timer_handler()) {
 						printf("Timer Handler Returned EXIT Code!\n");
 						gameRunning = 0;
 					}
 					buffer_handler();
+					input_presented();
+
+					frame_us = now_us() - frame_start;
+					frames_us += frame_us;
+					if (frame_us > frame_max_us)
+						frame_max_us = frame_us;
+					++frames;
 
 				}
 
@@ -121,6 +179,31 @@ int main() {
 		}
 	}
 
+	ReplayCheck_t check;
+	planetary_get_check(&check);
+	if (OK != replay_stop(&check))
+		printf("FAILED replay_stop()\n");
+
+	printf("Frames: %lu, handled in %lu us on average, %lu us at most\n",
+			frames, frames ? (unsigned long) (frames_us / frames) : 0,
+			(unsigned long) frame_max_us);
+	if (0 != clock_hz)
+		printf("RTC periods: %lu, at %lu Hz\n", rtc_periodic_count(), clock_hz);
+	printf("Mouse packets: %lu, dropped: %lu, resyncs: %lu\n",
+			mouse_get_parser()->packets, mouse_get_parser()->dropped,
+			mouse_get_parser()->resyncs);
+	for (port = 0; port < ports; ++port) {
+		printf("COM%u bytes received: %lu (%lu dropped), sent: %lu (%lu dropped), line errors: %lu\n",
+				port + 1, serial_get_stats(port)->rx_bytes,
+				serial_get_stats(port)->rx_dropped, serial_get_stats(port)->tx_bytes,
+				serial_get_stats(port)->tx_dropped, serial_get_stats(port)->line_errors);
+		printf("COM%u frames sent: %lu (%lu again), received: %lu (%lu twice, %lu bad), dropped: %lu\n",
+				port + 1, frame_get_stats(port)->sent,
+				frame_get_stats(port)->retransmitted, frame_get_stats(port)->received,
+				frame_get_stats(port)->duplicates, frame_get_stats(port)->bad,
+				frame_get_stats(port)->dropped);
+	}
+
 	/* Unsubscribe All Interrupts */
 	if (kbd_unsubscribe_int() < 0) {
 		printf("FAILED kbd_unsubscribe_int()\n");
@@ -134,17 +217,23 @@ int main() {
 		printf("FAILED timer_unsubscribe_int()\n");
 		return 1;
 	}
-	if (rtc_unsubscribe_int() < 0) {
-		printf("FAILED rtc_unsubscribe_int()\n");
+	if (rtc_disable_int(B_UEI | B_PIE) != OK) {
+		printf("FAILED rtc_disable_int()\n");
 		return 1;
 	}
-	if (serial_enable_interrupts() < 0) {
-		printf("FAILED serial_enbale_interrupts and the end of the game\n");
+	if (rtc_unsubscribe_int() < 0) {
+		printf("FAILED rtc_unsubscribe_int()\n");
 		return 1;
 	}
-	if (serial_unsubscribe_int() < 0) {
-		printf("FAILED serial_unsubscribe_int()\n");
-		return 1;
+	for (port = 0; port < ports; ++port) {
+		if (serial_enable_interrupts(port) < 0) {
+			printf("FAILED serial_enbale_interrupts and the end of the game\n");
+			return 1;
+		}
+		if (serial_unsubscribe_int(port) < 0) {
+			printf("FAILED serial_unsubscribe_int()\n");
+			return 1;
+		}
 	}
 	/* ** */
 
@@ -4,8 +4,10 @@
 #include <minix/sysutil.h>
 #include "mouse.h"
 #include "i8042.h"
+#include "Clock.h"
 
 static int mouse_hook_id = MOUSE_INITIAL_HOOK_ID;
+static MouseParser_t parser;
 static const unsigned maxIter = 50; // Maximum iterations/tries when retrieving data	TODO: Recheck
 
 #define HELPER_NEG 0xFFFFFF00
@@ -16,7 +18,7 @@ int int_value(unsigned char delta_var, int sign) {
 		return (unsigned int) delta_var;
 }
 
-int mouse_write_cmd(char cmd) {
+int mouse_write_cmd(unsigned char cmd) {
 	unsigned long stat;
 	unsigned iter = 0;
 	while (iter++ < maxIter) {
@@ -46,6 +48,52 @@ int mouse_write_cmd(char cmd) {
 	return 1;
 }
 
+int mouse_configure(unsigned char rate, unsigned char resolution) {
+	static const unsigned char rates[] = { 10, 20, 40, 60, 80, 100, 200 };
+
+	unsigned i;
+	for (i = 0; i < sizeof(rates) && rates[i] != rate; ++i)
+		;
+	if (sizeof(rates) == i || resolution > MOUSE_RES_8_MM) {
+		printf("mouse_configure() -> Invalid rate %u or resolution %u\n", rate,
+				resolution);
+		return 1;
+	}
+
+	if (mouse_write_cmd(SET_SAMPLE_RATE) != OK || mouse_write_cmd(rate) != OK) {
+		printf("mouse_configure() -> FAILED to set the sample rate\n");
+		return 1;
+	}
+	if (mouse_write_cmd(SET_RESOLUTION) != OK
+			|| mouse_write_cmd(resolution) != OK) {
+		printf("mouse_configure() -> FAILED to set the resolution\n");
+		return 1;
+	}
+
+	return OK;
+}
+
+int mouse_enable_wheel() {
+	// IntelliMouse unlock sequence: sample rates 200, 100, 80
+	static const unsigned char knock[] = { 200, 100, 80 };
+
+	unsigned i;
+	for (i = 0; i < sizeof(knock); ++i) {
+		if (mouse_write_cmd(SET_SAMPLE_RATE) != OK
+				|| mouse_write_cmd(knock[i]) != OK) {
+			printf("mouse_enable_wheel() -> FAILED to set the sample rate\n");
+			return -1;
+		}
+	}
+
+	if (mouse_write_cmd(GET_DEVICE_ID) != OK) {
+		printf("mouse_enable_wheel() -> FAILED to get the device id\n");
+		return -1;
+	}
+
+	return MOUSE_ID_WHEEL == mouse_read();
+}
+
 int mouse_subscribe_int() {
 	if (sys_irqsetpolicy(MOUSE_IRQ, IRQ_REENABLE | IRQ_EXCLUSIVE,
 			&mouse_hook_id) != OK) {
@@ -57,8 +105,12 @@ int mouse_subscribe_int() {
 		return -1;
 	}
 
-	// Enable stream mode
+	// Enable stream mode, configured while the mouse is quiet
+	mouse_write_cmd(DISABLE_DATA_R);
 	mouse_write_cmd(SET_STREAM_MODE);
+	mouse_parser_init(&parser,
+			1 == mouse_enable_wheel() ? MOUSE_PACKET_MAX : PACKET_NELEMENTS);
+	mouse_configure(MOUSE_SAMPLE_RATE, MOUSE_RESOLUTION);
 	mouse_write_cmd(ENABLE_DATA_R);
 
 	return MOUSE_INITIAL_HOOK_ID;
@@ -77,20 +129,6 @@ int mouse_unsubscribe_int() {
 	return MOUSE_INITIAL_HOOK_ID;
 }
 
-int mouse_synchronize()	// Synchronizes with FIRST byte, returns data read
-{
-	int data;
-	unsigned iter = 0;
-
-	while (iter++ < maxIter) {
-		if (((data = mouse_read()) & BYTE0_SYNC_BIT) != 0)
-			return data;
-	}
-
-	printf("mouse_synchronize() -> Max Iterations Reached. Was %d.\n", iter);
-	return -1;
-}
-
 int mouse_read()	// Reads Mouse Data from OutPut Buffer
 {
 	unsigned long stat, data;
@@ -115,18 +153,38 @@ int mouse_read()	// Reads Mouse Data from OutPut Buffer
 	return -1;
 }
 
-int mouse_handler(unsigned char * packet, unsigned short * counter) {
-	if (*counter == 0) {
-		int sync_result = mouse_synchronize();// Sync packet if expecting first byte
+int mouse_poll()	// Reads Mouse Data from OutPut Buffer, if there is any
+{
+	unsigned long stat, data;
 
-		if (sync_result == -1) {
-			printf("mouse_handler() -> FAILED mouse_synchronize()\n");
-			return 1;
-		}
-		packet[(*counter)++] = sync_result;
-		return OK;
-	} else
-		packet[(*counter)++] = mouse_read();
+	if (sys_inb(STAT_REG, &stat) != OK) {
+		printf("mouse_poll() -> FAILED sys_inb()\n");
+		return -1;
+	}
+	// Keyboard bytes are left for the keyboard handler
+	if ((stat & (STAT_OBF | STAT_AUX)) != (STAT_OBF | STAT_AUX))
+		return -1;
+
+	if (sys_inb(OUT_BUF, &data) != OK) {
+		printf("mouse_poll() -> FAILED sys_inb()\n");
+		return -1;
+	}
+	return data;
+}
+
+int mouse_handler(mouse_packet_cb_t on_packet) {
+	MousePacket_t packet;
+	unsigned bytes = 0;
+	int data;
+
+	while (bytes++ < MOUSE_DRAIN_MAX && (data = mouse_poll()) >= 0) {
+		if (mouse_parser_feed(&parser, data, now_us(), &packet))
+			on_packet(&packet);
+	}
 
 	return OK;
 }
+
+const MouseParser_t * mouse_get_parser() {
+	return &parser;
+}
@@ -7,6 +7,8 @@
  * Functions for using the i8042 KBC/KBD
  */
 
+#include "MouseParser.h"
+
 /**
  * @brief Function to get the signed value of an unsigned value
  *
@@ -18,16 +20,38 @@
 int int_value(unsigned char delta_var, int sign);
 
 /**
- * @brief Writes a command in the mouse input buffer
+ * @brief Writes a command, or a command argument, in the mouse input buffer
  *
  * @param cmd Command that is written in the input buffer
  *
  * @return Return 0 upon success and non-zero otherwise
  */
-int mouse_write_cmd(char cmd);
+int mouse_write_cmd(unsigned char cmd);
+
+/**
+ * @brief Sets the sample rate and the resolution of the mouse.
+ * Data reporting should be disabled while doing so
+ *
+ * @param rate Samples per second: 10, 20, 40, 60, 80, 100 or 200
+ * @param resolution One of MOUSE_RES_1_MM to MOUSE_RES_8_MM
+ *
+ * @return Return 0 upon success and non-zero otherwise
+ */
+int mouse_configure(unsigned char rate, unsigned char resolution);
 
 /**
- * @brief Subscribes and enables Mouse interrupts
+ * @brief Switches an IntelliMouse to 4 byte packets, reporting the scroll wheel.
+ * Data reporting should be disabled while doing so
+ *
+ * Leaves the sample rate changed, mouse_configure() should follow
+ *
+ * @return Return 1 if the mouse has a wheel, 0 if it does not, -1 on failure
+ */
+int mouse_enable_wheel(void);
+
+/**
+ * @brief Subscribes and enables Mouse interrupts, in stream mode at MOUSE_SAMPLE_RATE and MOUSE_RESOLUTION.
+ * The scroll wheel is enabled if the mouse has one
  *
  * @return Returns bit order in interrupt mask; negative value on failure
  */
@@ -41,30 +65,44 @@ int mouse_subscribe_int(void);
 int mouse_unsubscribe_int(void);
 
 /**
- * @brief Synchronizes the mouse
+ * @brief Reads data from the mouse output buffer
+ *
+ * @return Return value read upon sucess and -1 otherwise
+ */
+int mouse_read(void);
+
+/**
+ * @brief Reads a mouse byte if there is one waiting, without waiting for it
  *
- * @return Return byte1 upon sucess and -1 otherwise
+ * @return Return the byte read, -1 if there was none
  */
-int mouse_synchronize(void);
+int mouse_poll(void);
 
 /**
- * @brief Reads data from the mouse output buffer
+ * @brief Function called for every valid mouse packet
  *
- * @return Return value read upon sucess and -1 otherwise
+ * @param packet Packet assembled
  */
-int mouse_read(void);
+typedef void (*mouse_packet_cb_t)(const MousePacket_t * packet);
 
 /**
  * @brief Mouse Interrupt Handler
  *
- * Fetches Mouse output and prints packets in a human friendly way
+ * Reads every byte waiting in the KBC, so packets sent at high sample rates are not
+ * left behind for the next interrupt, and feeds them to the packet parser
  *
- * @param packet pointer to packet that shall be processed
- * @param counter pointer to counter that controls the packet count of bytes
+ * @param on_packet function called with every valid packet completed
  *
  * @return Return 0 upon success and non-zero otherwise
  */
-int mouse_handler(unsigned char * packet, unsigned short * counter);
+int mouse_handler(mouse_packet_cb_t on_packet);
+
+/**
+ * @brief Gets the packet parser of the mouse, with its dropped and resynced packet counters
+ *
+ * @return The parser
+ */
+const MouseParser_t * mouse_get_parser(void);
 
 /**@}*/
 
@@ -79,6 +117,13 @@ int mouse_handler(unsigned char * packet, unsigned short * counter);
 
 #define PACKET_NELEMENTS		3	/**< @brief Number of Elements in every mouse packet */
 
+#define MOUSE_SAMPLE_RATE		200	/**< @brief Packets per second, the highest PS/2 rate */
+#define MOUSE_RESOLUTION		MOUSE_RES_4_MM	/**< @brief Counts per millimetre */
+#define MOUSE_DRAIN_MAX			64	/**< @brief Most bytes read in one interrupt */
+
+#define MOUSE_ID_STANDARD		0x00	/**< @brief Device id of a standard PS/2 mouse */
+#define MOUSE_ID_WHEEL			0x03	/**< @brief Device id of an IntelliMouse, with a scroll wheel */
+
 /* PS/2 Mouse-Related KBC Commands*/
 
 #define READ_CMD_B			0x20	/**< @brief Read Command Byte */
@@ -99,11 +144,19 @@ int mouse_handler(unsigned char * packet, unsigned short * counter);
 #define SET_REMOTE_MODE		0XF0	/**< @brief Send data on request only */
 #define READ_DATA			0xEB	/**< @brief Send data packet request */
 #define SET_STREAM_MODE		0xEA	/**< @brief Send data on events */
+#define GET_DEVICE_ID		0xF2	/**< @brief Mouse answers its id after the ACK */
 #define STATUS_REQUEST		0xE9	/**< @brief Get mouse configuration (3 bytes) */
-#define SET_RESOLUTION		0XE8
+#define SET_RESOLUTION		0XE8	/**< @brief Sets the counts per millimetre, followed by one of MOUSE_RES_* */
 #define SET_SCALING_2_1		0xE7	/**< @brief Acceleration mode */
 #define SET_SCALING_1_1		0xE6	/**< @brief Linear mode */
 
+/* SET_RESOLUTION arguments */
+
+#define MOUSE_RES_1_MM		0x00	/**< @brief 1 count per millimetre */
+#define MOUSE_RES_2_MM		0x01	/**< @brief 2 counts per millimetre */
+#define MOUSE_RES_4_MM		0x02	/**< @brief 4 counts per millimetre, the default */
+#define MOUSE_RES_8_MM		0x03	/**< @brief 8 counts per millimetre */
+
 /* PS/2 Mouse Packet Meanings */
 
 #define BYTE0_Y_OVF			BIT(7)	/** <@brief Bit set if overflow occurred in the vertical axis */
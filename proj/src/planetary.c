@@ -1,16 +1,27 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "planetary.h"
 #include "video_gr.h"
 #include "Input.h"
 #include "Bitmap.h"
 #include "GVector.h"
+#include "GHeap.h"
+#include "TimerWheel.h"
 #include "Missile.h"
+#include "Fixed.h"
 #include "BMPsHolder.h"
 #include "RTC.h"
 #include "Highscores.h"
 #include "Serial.h"
 #include "Communication.h"
+#include "Profiler.h"
+#include "Clock.h"
+#include "Replay.h"
+#include "Random.h"
+#include "Rollback.h"
+#include "BitPack.h"
 
 static int menu_timer_handler();
 static int game_timer_handler();
@@ -18,6 +29,29 @@ static int end_game_timer_handler(int highscore_flag);
 static int highscores_timer_handler();
 static int multiplayer_timer_handler();
 static int multiplayer_end_animation(int winner_flag);
+static int net_game_start();
+static void net_game_stop();
+static int net_game_timer_handler();
+static void spectate_stop();
+static int spectate_timer_handler();
+
+static TimerWheel * ui_events = NULL;	// Events outside of a Game, keyed on ui_ticks
+static unsigned long ui_ticks = 0;		// Simulation steps since start
+
+static unsigned long render_rate = FRAME_RATE;	// Timer interrupts per second
+static unsigned long sim_acc_us = 0;	// Elapsed time not simulated yet, in microseconds
+static int measured_time = 0;		// Whether the time elapsed is measured, or the interrupt period
+static uint64_t last_frame_us = 0;	// now_us() at the previous interrupt, 0 before the first
+static unsigned sim_steps = 0;		// Simulation steps due in the current interrupt
+static fixed_t render_alpha = 0;	// Fraction of a step elapsed since the last one, 16.16
+
+static game_state_t game_state = MENU;
+
+static Stress_t stress;			// Stress scenario, used while stress_on
+static int stress_on = 0;
+
+static ReplayCheck_t last_check;	// State of the last game step, for replays to compare
+static unsigned key_fire_steps = 0;	// Steps SPACE was held for, 0 when released
 
 /**
  * Menu Struct and Methods
@@ -76,14 +110,52 @@ static void delete_menu() {
 /**
  * Game Struct and Methods
  */
+
+/**
+ * Predicted impact of an enemy missile with the ground or a base
+ */
 typedef struct {
-	GVector * e_missiles;	// Enemy Missiles
+	unsigned long frame;	// FRAME in which the impact should be checked
+	unsigned id;			// Id of the enemy missile. Stale if the missile is gone
+	int target;				// Base index, or IMPACT_GROUND
+} Impact_t;
+
+#define IMPACT_GROUND	-1
+
+#define GAME_SUSPENDED	3	// game_update() return value: ESC saved the game
+#define MP_GAVE_UP		3	// multiplayer_timer_handler() return value: no game, back to the menu
+
+static int impact_cmp(const void * a, const void * b) {
+	unsigned long fa = ((const Impact_t *) a)->frame;
+	unsigned long fb = ((const Impact_t *) b)->frame;
+
+	return (fa > fb) - (fa < fb);
+}
+
+typedef struct {
+	GVector * e_missiles;	// Enemy Missiles, sorted by id (spawn order)
 	GVector * f_missiles;	// Friendly Missiles
 	GVector * explosions;	// Explosions on Screen
 
+	GHeap * impacts;		// Predicted impacts of e_missiles, ordered by frame
+	GVector * due_impacts;	// Impacts popped in the current frame
+
 	unsigned long frames;		// FRAMES survived, frames == times * FRAME_RATE
 	unsigned long enemy_spawn_fr;	// FRAME in which an enemy should be spawned
 
+	TimerWheel * events;		// Scheduled events, keyed on ticks
+	unsigned long ticks;		// FRAMES since creation, end of game animation included
+	WheelTimer * spawn_timer;	// Pending enemy spawn
+
+	int end_animation;		// End of game animation started
+	int end_animation_over;	// End of game animation timed out
+	int blink;				// Score visibility, in the end of game animation
+
+	int stress;				// Playing the stress scenario
+	int net;				// Players of a multiplayer game, stepped by the Rollback with their inputs. 0 otherwise
+	unsigned wave_size;		// Enemy missiles in the next wave, stress scenario
+	unsigned fire_cursor;	// Next e_missile to shoot at, stress scenario
+
 	unsigned cannon_pos[2];	// x position of the left and right cannons
 	unsigned health_points;	// number of bases left
 
@@ -92,10 +164,13 @@ typedef struct {
 
 	unsigned buildings_size_y[3];
 
-	Score_t * highscores;	// Array containing HighScores
+	GVector * spare_missiles;	// Missiles kept by snapshot restores, for reuse
+	GVector * spare_explosions;	// Explosions kept by snapshot restores, for reuse
 
 } Game_t;
 
+static void spawn_enemy(void * data);
+
 static Game_t * new_game() {
 	printf("Game Instance called!\n");
 
@@ -108,6 +183,26 @@ static Game_t * new_game() {
 	Game->f_missiles = new_gvector(sizeof(void*));
 	Game->explosions = new_gvector(sizeof(void*));
 
+	Game->impacts = new_gheap(sizeof(Impact_t), impact_cmp);
+	Game->due_impacts = new_gvector(sizeof(Impact_t));
+
+	Game->spare_missiles = new_gvector(sizeof(void*));
+	Game->spare_explosions = new_gvector(sizeof(void*));
+
+	Game->ticks = 0;
+	Game->events = new_timer_wheel(Game->ticks);
+	Game->spawn_timer = timer_wheel_add(Game->events, Game->enemy_spawn_fr,
+			spawn_enemy, Game);
+
+	Game->end_animation = 0;
+	Game->end_animation_over = 0;
+	Game->blink = 1;
+
+	Game->stress = stress_on;
+	Game->net = 0;
+	Game->wave_size = stress.wave_size;
+	Game->fire_cursor = 0;
+
 	Game->health_points = 3;
 
 	Game->cannon_pos[0] = LEFT_CANNON_POS_X;
@@ -118,16 +213,14 @@ static Game_t * new_game() {
 		Game->bases_hp[idx] = 2;
 	}
 	for (idx = 0; idx < NUM_BASES; ++idx) {
-		Game->bases_pos[idx] = 200
-				+ idx * ((float) vg_getHorRes() - 200.) / NUM_BASES;
+		Game->bases_pos[idx] = 200 + idx * (vg_getHorRes() - 200) / NUM_BASES;
 	}
 
 	Game->buildings_size_y[0] = BUILDING0_SIZE_Y;
 	Game->buildings_size_y[1] = BUILDING1_SIZE_Y;
 	Game->buildings_size_y[2] = BUILDING2_SIZE_Y;
 
-	Game->highscores = loadScores(
-	SCORES_TXT_PATH);
+	highscores_open(SCORES_PATH, SCORES_TXT_PATH); // Once for the process
 
 	printf("Game Instance was successfully created\n");
 
@@ -161,6 +254,21 @@ static void delete_game() {
 		}
 		delete_gvector(game_ptr->explosions);
 
+		delete_gheap(game_ptr->impacts);
+		delete_gvector(game_ptr->due_impacts);
+
+		for (idx = 0; idx < gvector_get_size(game_ptr->spare_missiles); ++idx) {
+			free(*(Missile **) gvector_at(game_ptr->spare_missiles, idx));
+		}
+		delete_gvector(game_ptr->spare_missiles);
+
+		for (idx = 0; idx < gvector_get_size(game_ptr->spare_explosions); ++idx) {
+			free(*(Explosion **) gvector_at(game_ptr->spare_explosions, idx));
+		}
+		delete_gvector(game_ptr->spare_explosions);
+
+		delete_timer_wheel(game_ptr->events);
+
 		free(game_ptr);
 		game_ptr = NULL;
 
@@ -168,30 +276,781 @@ static void delete_game() {
 	}
 }
 
-/** **/
+/**
+ * Predicts the first impact of an enemy missile (ground or base) and schedules it.
+ * last_frame is the frame of the missile's last update.
+ */
+static void schedule_impact(Game_t * self, Missile * missile,
+		unsigned long last_frame) {
+	Impact_t impact;
+	impact.id = missile_getId(missile);
+	impact.target = IMPACT_GROUND;
+
+	long frames = missile_framesToGround(missile, GROUND_Y), tmp;
+	unsigned idx;
+	for (idx = 0; idx < NUM_BASES; ++idx) {
+		tmp = missile_framesToRect(missile,
+				self->bases_pos[idx] - BUILDING_SIZE_X / 2, GROUND_Y,
+				BUILDING_SIZE_X, self->buildings_size_y[self->bases_hp[idx]]);
+		if (tmp >= 0 && (frames < 0 || tmp < frames)) {
+			frames = tmp;
+			impact.target = idx;
+		}
+	}
+
+	if (frames < 0)
+		return; // Never hits anything
+
+	impact.frame = last_frame + (frames > 1 ? frames : 1);
+	gheap_push(self->impacts, &impact);
+}
+
+/**
+ * Binary search for an enemy missile by id.
+ * Returns its index in e_missiles, or -1 if it no longer exists.
+ */
+static int find_emissile(Game_t * self, unsigned id) {
+	int low = 0, high = (int) gvector_get_size(self->e_missiles) - 1;
+
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		unsigned mid_id = missile_getId(
+				*(Missile **) gvector_at(self->e_missiles, mid));
+
+		if (mid_id == id)
+			return mid;
+		else if (mid_id < id)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+
+	return -1;
+}
 
 // Returns the frame in which an enemy should be spawned
 unsigned long next_spawn_frame() {	// 500 / (1 + frames / 512)
-	return game_instance()->frames + 256000. / (game_instance()->frames + 512);
+	return game_instance()->frames + 256000 / (game_instance()->frames + 512);
+}
+
+// Spawns an enemy missile, and predicts its impact
+static void add_enemy(Game_t * self, Missile * new_enemy) {
+	gvector_push_back(self->e_missiles, &new_enemy);
+	schedule_impact(self, new_enemy, self->frames - 1); // Moves this frame
+}
+
+// Stress scenario -- spawns a whole wave, up to the limit of enemies alive
+static void spawn_wave(Game_t * self) {
+	uint32_t draws[WAVE_DRAW_CHUNK * EMISSILE_DRAWS];
+	unsigned idx, left = self->wave_size, alive = gvector_get_size(self->e_missiles);
+
+	if (0 != stress.max_enemies)
+		left = alive >= stress.max_enemies ? 0 :
+				(stress.max_enemies - alive < left ? stress.max_enemies - alive : left);
+
+	// Draws the random values of many missiles at once
+	while (0 != left) {
+		unsigned chunk = left < WAVE_DRAW_CHUNK ? left : WAVE_DRAW_CHUNK;
+
+		rng_fill(rng_stream(RNG_SPAWN), draws, chunk * EMISSILE_DRAWS);
+		for (idx = 0; idx < chunk; ++idx)
+			add_enemy(self, new_emissile_from(self->bases_pos, self->bases_hp,
+					draws + idx * EMISSILE_DRAWS));
+		left -= chunk;
+	}
+
+	self->wave_size += stress.wave_growth;
+}
+
+// Timer callback -- spawns an enemy missile (or a wave) and schedules the next one
+static void spawn_enemy(void * data) {
+	Game_t * self = (Game_t *) data;
+
+	if (self->stress) {
+		spawn_wave(self);
+		self->enemy_spawn_fr = self->frames + stress.wave_period;
+	} else {
+		self->enemy_spawn_fr = next_spawn_frame();
+		printf("Spawning New Enemy Missile\n");
+		add_enemy(self, new_emissile(self->bases_pos, self->bases_hp));
+	}
+
+	self->spawn_timer = timer_wheel_add(self->events,
+			self->ticks + (self->enemy_spawn_fr - self->frames), spawn_enemy,
+			self);
+}
+
+// Timer callback -- removes an explosion whose animation ended
+static void explosion_ended(void * data) {
+	Game_t * self = game_instance();
+	Explosion * oldest;
+
+	// Explosions last the same and are kept in the order they started, so they end in
+	// that order: the first one ends now, data or another one ending in the same step
+	if (0 == gvector_get_size(self->explosions))
+		return;
+	oldest = *(Explosion **) gvector_at(self->explosions, 0);
+	gvector_pop_front(self->explosions);
+	delete_explosion(oldest);
+	printf("\t\t\tExplosion deleted\n");
+}
+
+// Adds an explosion to the game, starting its animation in the current frame
+static void push_explosion(Game_t * self, Explosion * exp) {
+	explosion_setStartFrame(exp, self->ticks);
+	gvector_push_back(self->explosions, &exp);
+	timer_wheel_add(self->events, explosion_getEndFrame(exp), explosion_ended,
+			exp);
+}
+
+// Most friendly missiles allowed at once
+static unsigned max_friendly(Game_t * self) {
+	if (self->stress)
+		return stress.max_friendly;
+	return self->net ? self->net * MAX_NUM_MISSILES : MAX_NUM_MISSILES;
+}
+
+// Stress scenario -- shoots at enemy missiles in turn, from both cannons
+static void auto_fire(Game_t * self) {
+	unsigned shots = 0, tries = 0, num_enemies = gvector_get_size(
+			self->e_missiles);
+
+	while (shots < stress.auto_fire && tries < num_enemies
+			&& gvector_get_size(self->f_missiles) < max_friendly(self)) {
+		Missile * target = *(Missile **) gvector_at(self->e_missiles,
+				self->fire_cursor++ % num_enemies);
+		int target_pos[2] = { missile_getPosX(target), missile_getPosY(target) };
+		++tries;
+
+		if (target_pos[1] >= CANNON_POS_Y)
+			continue; // Can't shoot downwards
+
+		int cannon = (self->fire_cursor & 1);
+		int tmp_pos[2] = { self->cannon_pos[cannon]
+				+ (cannon ? -CANNON_PROJECTILE_OFFSET : CANNON_PROJECTILE_OFFSET),
+		CANNON_POS_Y };
+		Missile * tmp = new_fmissile(tmp_pos, target_pos);
+		gvector_push_back(self->f_missiles, &tmp);
+		++shots;
+	}
+}
+
+void planetary_set_stress(const Stress_t * cfg) {
+	if (NULL == cfg) {
+		stress_on = 0;
+	} else {
+		stress = *cfg;
+		stress_on = 1;
+	}
+}
+
+/**
+ * Snapshots
+ */
+
+#define SNAPSHOT_MAGIC		"PDSN"
+#define SNAPSHOT_VERSION	2		// Version 1 wrote the structures as laid out in memory
+#define SNAPSHOT_TMP_SUFFIX	".tmp"	// Appended to the file name while it is written
+#define SNAPSHOT_PATH_MAX	256
+
+/**
+ * Fixed part of a snapshot. Missiles, explosions and impacts follow it in the file
+ */
+typedef struct {
+	uint32_t frames;
+	uint32_t enemy_spawn_fr;
+	uint32_t ticks;
+	uint32_t stress;
+	uint32_t wave_size;
+	uint32_t fire_cursor;
+	uint32_t bases_hp[NUM_BASES];
+	uint32_t next_missile_id;
+
+	uint32_t num_e_missiles;
+	uint32_t num_f_missiles;
+	uint32_t num_explosions;
+	uint32_t num_impacts;
+
+	Rng_t rng[RNG_NUM_STREAMS];
+	Input_t input;
+} SnapshotHeader_t;
+
+struct snapshot_t {
+	SnapshotHeader_t header;
+	int saved;					// Whether the header and arrays hold a game
+
+	unsigned max_missiles;		// Capacity of missiles, enemy and friendly ones together
+	unsigned max_explosions;
+	unsigned max_impacts;
+
+	MissileState_t * missiles;	// Enemy missiles, then friendly ones
+	ExplosionState_t * explosions;
+	Impact_t * impacts;			// In heap order
+};
+
+Snapshot * new_snapshot(unsigned max_missiles, unsigned max_explosions,
+		unsigned max_impacts) {
+	Snapshot * snap = malloc(sizeof(Snapshot));
+	if (NULL == snap)
+		return NULL;
+
+	snap->max_missiles = max_missiles;
+	snap->max_explosions = max_explosions;
+	snap->max_impacts = max_impacts;
+
+	snap->missiles = malloc(max_missiles * sizeof(MissileState_t));
+	snap->explosions = malloc(max_explosions * sizeof(ExplosionState_t));
+	snap->impacts = malloc(max_impacts * sizeof(Impact_t));
+	memset(&snap->header, 0, sizeof(SnapshotHeader_t));
+	snap->saved = 0;
+
+	if (NULL == snap->missiles || NULL == snap->explosions
+			|| NULL == snap->impacts) {
+		printf("new_snapshot -> FAILED malloc()\n");
+		delete_snapshot(snap);
+		return NULL;
+	}
+
+	return snap;
+}
+
+void delete_snapshot(Snapshot * snap) {
+	free(snap->missiles);
+	free(snap->explosions);
+	free(snap->impacts);
+	free(snap);
+}
+
+int snapshot_save(Snapshot * snap) {
+	Game_t * self = game_ptr;
+	SnapshotHeader_t * h = &snap->header;
+	unsigned idx, num_e, num_f;
+
+	// Only games in progress, the end of game animation is not kept
+	if (NULL == self || self->end_animation || 0 == self->health_points)
+		return 1;
+
+	num_e = gvector_get_size(self->e_missiles);
+	num_f = gvector_get_size(self->f_missiles);
+	if (num_e + num_f > snap->max_missiles
+			|| gvector_get_size(self->explosions) > snap->max_explosions
+			|| gheap_get_size(self->impacts) > snap->max_impacts) {
+		printf("snapshot_save -> Too many entities for the snapshot\n");
+		return 1;
+	}
+
+	PROF_BEGIN(PROF_SNAPSHOT);
+
+	h->frames = self->frames;
+	h->enemy_spawn_fr = self->enemy_spawn_fr;
+	h->ticks = self->ticks;
+	h->stress = self->stress;
+	h->wave_size = self->wave_size;
+	h->fire_cursor = self->fire_cursor;
+	for (idx = 0; idx < NUM_BASES; ++idx)
+		h->bases_hp[idx] = self->bases_hp[idx];
+	h->next_missile_id = missile_getNextId();
+
+	h->num_e_missiles = num_e;
+	h->num_f_missiles = num_f;
+	h->num_explosions = gvector_get_size(self->explosions);
+	h->num_impacts = gheap_get_size(self->impacts);
+
+	for (idx = 0; idx < num_e; ++idx)
+		missile_getState(*(Missile **) gvector_at(self->e_missiles, idx),
+				&snap->missiles[idx]);
+	for (idx = 0; idx < num_f; ++idx)
+		missile_getState(*(Missile **) gvector_at(self->f_missiles, idx),
+				&snap->missiles[num_e + idx]);
+	for (idx = 0; idx < h->num_explosions; ++idx)
+		explosion_getState(*(Explosion **) gvector_at(self->explosions, idx),
+				&snap->explosions[idx]);
+	if (0 != h->num_impacts)
+		memcpy(snap->impacts, gheap_elems(self->impacts),
+				h->num_impacts * sizeof(Impact_t));
+
+	for (idx = 0; idx < RNG_NUM_STREAMS; ++idx)
+		h->rng[idx] = *rng_stream(idx);
+	h->input = *input_instance();
+	snap->saved = 1;
+
+	PROF_END(PROF_SNAPSHOT);
+	return OK;
+}
+
+// Private Method -- Gives a vector of pointers count objects, reusing the ones it holds and the spare ones
+static int restore_objects(GVector * objects, GVector * spares,
+		unsigned count, size_t size) {
+	unsigned idx, held = gvector_get_size(objects), spare = gvector_get_size(
+			spares);
+
+	for (idx = count; idx < held; ++idx) // Surplus waits in the spares
+		gvector_push_back(spares, gvector_at(objects, idx));
+
+	gvector_resize(objects, count);
+	for (idx = held; idx < count; ++idx) {
+		void * obj;
+		if (0 != spare) {
+			obj = *(void **) gvector_at(spares, --spare);
+		} else if (NULL == (obj = malloc(size))) {
+			printf("restore_objects -> FAILED malloc()\n");
+			gvector_resize(objects, idx);
+			gvector_resize(spares, spare);
+			return 1;
+		}
+		*(void **) gvector_at(objects, idx) = obj;
+	}
+	if (held < count)
+		gvector_resize(spares, spare);
+
+	return OK;
+}
+
+int snapshot_restore(const Snapshot * snap) {
+	Game_t * self = game_instance();
+	const SnapshotHeader_t * h = &snap->header;
+	unsigned idx;
+
+	if (!snap->saved)
+		return 1;
+
+	PROF_BEGIN(PROF_RESTORE);
+
+	if (OK != restore_objects(self->e_missiles, self->spare_missiles,
+			h->num_e_missiles, missile_getSizeOf())
+			|| OK != restore_objects(self->f_missiles, self->spare_missiles,
+					h->num_f_missiles, missile_getSizeOf())
+			|| OK != restore_objects(self->explosions, self->spare_explosions,
+					h->num_explosions, explosion_getSizeOf())) {
+		PROF_END(PROF_RESTORE);
+		return 1;
+	}
+
+	for (idx = 0; idx < h->num_e_missiles; ++idx)
+		missile_setState(*(Missile **) gvector_at(self->e_missiles, idx),
+				&snap->missiles[idx]);
+	for (idx = 0; idx < h->num_f_missiles; ++idx)
+		missile_setState(*(Missile **) gvector_at(self->f_missiles, idx),
+				&snap->missiles[h->num_e_missiles + idx]);
+	for (idx = 0; idx < h->num_explosions; ++idx)
+		explosion_setState(*(Explosion **) gvector_at(self->explosions, idx),
+				&snap->explosions[idx]);
+	gheap_assign(self->impacts, snap->impacts, h->num_impacts);
+
+	self->frames = h->frames;
+	self->enemy_spawn_fr = h->enemy_spawn_fr;
+	self->ticks = h->ticks;
+	self->stress = h->stress;
+	self->wave_size = h->wave_size;
+	self->fire_cursor = h->fire_cursor;
+	self->health_points = 0;
+	for (idx = 0; idx < NUM_BASES; ++idx) {
+		self->bases_hp[idx] = h->bases_hp[idx];
+		if (self->bases_hp[idx] > 0)
+			++(self->health_points);
+	}
+	missile_setNextId(h->next_missile_id);
+
+	for (idx = 0; idx < RNG_NUM_STREAMS; ++idx)
+		*rng_stream(idx) = h->rng[idx];
+	if (!self->net) // Net games take their input from the Rollback, the live one stays
+		*input_instance() = h->input;
+
+	// Scheduled events are rebuilt from the state they depend on
+	timer_wheel_reset(self->events, self->ticks);
+	self->spawn_timer = timer_wheel_add(self->events,
+			self->ticks + (self->enemy_spawn_fr - self->frames), spawn_enemy,
+			self);
+	for (idx = 0; idx < h->num_explosions; ++idx) {
+		Explosion * exp = *(Explosion **) gvector_at(self->explosions, idx);
+		timer_wheel_add(self->events, explosion_getEndFrame(exp),
+				explosion_ended, exp);
+	}
+
+	PROF_END(PROF_RESTORE);
+	return OK;
+}
+
+/** Snapshot files: little endian, field by field **/
+
+static void put_u16(FILE * file, uint16_t value) {
+	fputc(value & 0xFF, file);
+	fputc(value >> 8, file);
+}
+
+static void put_u32(FILE * file, uint32_t value) {
+	put_u16(file, value & 0xFFFF);
+	put_u16(file, value >> 16);
+}
+
+static void put_u64(FILE * file, uint64_t value) {
+	put_u32(file, value & 0xFFFFFFFF);
+	put_u32(file, value >> 32);
+}
+
+// Past the end of the file, the bytes read are 0: feof() tells it once everything is read
+static uint16_t get_u16(FILE * file) {
+	int low = fgetc(file), high = fgetc(file);
+	return EOF == low || EOF == high ? 0 : (uint16_t) (low | (high << 8));
+}
+
+static uint32_t get_u32(FILE * file) {
+	uint32_t low = get_u16(file);
+	return low | ((uint32_t) get_u16(file) << 16);
+}
+
+static uint64_t get_u64(FILE * file) {
+	uint64_t low = get_u32(file);
+	return low | ((uint64_t) get_u32(file) << 32);
+}
+
+// Private Method -- Writes the fixed part of a snapshot
+static void put_header(FILE * file, const SnapshotHeader_t * h) {
+	const Input_t * in = &h->input;
+	unsigned idx, i;
+
+	put_u32(file, h->frames);
+	put_u32(file, h->enemy_spawn_fr);
+	put_u32(file, h->ticks);
+	put_u32(file, h->stress);
+	put_u32(file, h->wave_size);
+	put_u32(file, h->fire_cursor);
+	for (idx = 0; idx < NUM_BASES; ++idx)
+		put_u32(file, h->bases_hp[idx]);
+	put_u32(file, h->next_missile_id);
+
+	put_u32(file, h->num_e_missiles);
+	put_u32(file, h->num_f_missiles);
+	put_u32(file, h->num_explosions);
+	put_u32(file, h->num_impacts);
+
+	for (idx = 0; idx < RNG_NUM_STREAMS; ++idx)
+		for (i = 0; i < 4; ++i)
+			put_u32(file, h->rng[idx].s[i]);
+
+	put_u32(file, in->keys_down);
+	put_u32(file, in->keys_pressed);
+	put_u32(file, in->keys_released);
+	for (idx = 0; idx < MOUSE_NUM_BUTTONS; ++idx) {
+		for (i = 0; i < INPUT_PENDING_CLICKS; ++i)
+			put_u64(file, in->clicks_us[idx][i]);
+		put_u32(file, in->num_clicks[idx]);
+	}
+	put_u64(file, in->click_us);
+	put_u32(file, in->mouse_pos[0]);
+	put_u32(file, in->mouse_pos[1]);
+	put_u64(file, in->motion_us);
+	put_u32(file, in->wheel);
+	put_u32(file, in->res[0]);
+	put_u32(file, in->res[1]);
+}
+
+// Private Method -- Reads the fixed part of a snapshot
+static void get_header(FILE * file, SnapshotHeader_t * h) {
+	Input_t * in = &h->input;
+	unsigned idx, i;
+
+	h->frames = get_u32(file);
+	h->enemy_spawn_fr = get_u32(file);
+	h->ticks = get_u32(file);
+	h->stress = get_u32(file);
+	h->wave_size = get_u32(file);
+	h->fire_cursor = get_u32(file);
+	for (idx = 0; idx < NUM_BASES; ++idx)
+		h->bases_hp[idx] = get_u32(file);
+	h->next_missile_id = get_u32(file);
+
+	h->num_e_missiles = get_u32(file);
+	h->num_f_missiles = get_u32(file);
+	h->num_explosions = get_u32(file);
+	h->num_impacts = get_u32(file);
+
+	for (idx = 0; idx < RNG_NUM_STREAMS; ++idx)
+		for (i = 0; i < 4; ++i)
+			h->rng[idx].s[i] = get_u32(file);
+
+	in->keys_down = get_u32(file);
+	in->keys_pressed = get_u32(file);
+	in->keys_released = get_u32(file);
+	for (idx = 0; idx < MOUSE_NUM_BUTTONS; ++idx) {
+		for (i = 0; i < INPUT_PENDING_CLICKS; ++i)
+			in->clicks_us[idx][i] = get_u64(file);
+		in->num_clicks[idx] = get_u32(file);
+	}
+	in->click_us = get_u64(file);
+	in->mouse_pos[0] = (int32_t) get_u32(file);
+	in->mouse_pos[1] = (int32_t) get_u32(file);
+	in->motion_us = get_u64(file);
+	in->wheel = (int32_t) get_u32(file);
+	in->res[0] = get_u32(file);
+	in->res[1] = get_u32(file);
+}
+
+// Private Method -- Writes the state of a missile
+static void put_missile(FILE * file, const MissileState_t * m) {
+	unsigned i;
+
+	for (i = 0; i < 2; ++i) {
+		put_u32(file, m->pos[i]);
+		put_u32(file, m->prev_pos[i]);
+		put_u32(file, m->velocity[i]);
+		put_u16(file, m->init_pos[i]);
+		put_u16(file, m->end_pos[i]);
+	}
+	put_u32(file, m->id);
+	put_u16(file, m->color);
+	put_u16(file, m->friendly);
+}
+
+// Private Method -- Reads the state of a missile
+static void get_missile(FILE * file, MissileState_t * m) {
+	unsigned i;
+
+	for (i = 0; i < 2; ++i) {
+		m->pos[i] = (fixed_t) get_u32(file);
+		m->prev_pos[i] = (fixed_t) get_u32(file);
+		m->velocity[i] = (fixed_t) get_u32(file);
+		m->init_pos[i] = (int16_t) get_u16(file);
+		m->end_pos[i] = (int16_t) get_u16(file);
+	}
+	m->id = get_u32(file);
+	m->color = get_u16(file);
+	m->friendly = get_u16(file);
+}
+
+int snapshot_write(const Snapshot * snap, const char * path) {
+	const SnapshotHeader_t * h = &snap->header;
+	char tmp[SNAPSHOT_PATH_MAX];
+	unsigned idx;
+	FILE * file;
+	int failed;
+
+	// Written whole under another name, then renamed over the old one: never a torn file
+	if (strlen(path) + strlen(SNAPSHOT_TMP_SUFFIX) >= SNAPSHOT_PATH_MAX) {
+		printf("snapshot_write -> FAILED, name too long: %s\n", path);
+		return 1;
+	}
+	strcpy(tmp, path);
+	strcat(tmp, SNAPSHOT_TMP_SUFFIX);
+	if (NULL == (file = fopen(tmp, "wb"))) {
+		printf("snapshot_write -> FAILED to open %s\n", tmp);
+		return 1;
+	}
+
+	fwrite(SNAPSHOT_MAGIC, 1, 4, file);
+	put_u32(file, SNAPSHOT_VERSION);
+	put_header(file, h);
+	for (idx = 0; idx < h->num_e_missiles + h->num_f_missiles; ++idx)
+		put_missile(file, &snap->missiles[idx]);
+	for (idx = 0; idx < h->num_explosions; ++idx) {
+		put_u32(file, snap->explosions[idx].pos[0]);
+		put_u32(file, snap->explosions[idx].pos[1]);
+		put_u32(file, snap->explosions[idx].start_frame);
+	}
+	for (idx = 0; idx < h->num_impacts; ++idx) {
+		put_u32(file, snap->impacts[idx].frame);
+		put_u32(file, snap->impacts[idx].id);
+		put_u32(file, snap->impacts[idx].target);
+	}
+
+	failed = ferror(file) || 0 != fflush(file) || 0 != fsync(fileno(file));
+	failed = 0 != fclose(file) || failed;
+	if (failed || 0 != rename(tmp, path)) {
+		printf("snapshot_write -> FAILED to write %s\n", path);
+		remove(tmp); // The file stays as it was
+		return 1;
+	}
+	return OK;
+}
+
+int snapshot_read(Snapshot * snap, const char * path) {
+	SnapshotHeader_t * h = &snap->header;
+	char magic[4];
+	unsigned idx, num_missiles;
+	FILE * file = fopen(path, "rb");
+
+	if (NULL == file)
+		return 1;
+
+	snap->saved = 0;
+	if (4 != fread(magic, 1, 4, file) || 0 != memcmp(magic, SNAPSHOT_MAGIC, 4)
+			|| SNAPSHOT_VERSION != get_u32(file)) {
+		printf("snapshot_read -> %s is not a snapshot of this version\n", path);
+		fclose(file);
+		return 1;
+	}
+
+	get_header(file, h);
+	num_missiles = h->num_e_missiles + h->num_f_missiles;
+	if (feof(file) || num_missiles > snap->max_missiles
+			|| h->num_explosions > snap->max_explosions
+			|| h->num_impacts > snap->max_impacts) {
+		printf("snapshot_read -> %s is truncated or too large\n", path);
+		fclose(file);
+		return 1;
+	}
+
+	for (idx = 0; idx < num_missiles; ++idx)
+		get_missile(file, &snap->missiles[idx]);
+	for (idx = 0; idx < h->num_explosions; ++idx) {
+		snap->explosions[idx].pos[0] = (fixed_t) get_u32(file);
+		snap->explosions[idx].pos[1] = (fixed_t) get_u32(file);
+		snap->explosions[idx].start_frame = get_u32(file);
+	}
+	for (idx = 0; idx < h->num_impacts; ++idx) {
+		snap->impacts[idx].frame = get_u32(file);
+		snap->impacts[idx].id = get_u32(file);
+		snap->impacts[idx].target = (int32_t) get_u32(file);
+	}
+
+	if (feof(file) || ferror(file)) {
+		printf("snapshot_read -> %s is truncated or too large\n", path);
+		fclose(file);
+		return 1;
+	}
+
+	fclose(file);
+	snap->saved = 1;
+	return OK;
+}
+
+/** Pause and resume **/
+
+// Private Method -- Saves the game in progress, to be resumed from the menu
+static int game_suspend() {
+	Snapshot * snap;
+	int ret;
+
+	if (GAME_SINGLE != game_state || REPLAY_OFF != replay_mode())
+		return 1; // Replays must start from a new game
+
+	if (NULL == (snap = new_snapshot(SAVE_MAX_MISSILES, SAVE_MAX_EXPLOSIONS,
+			SAVE_MAX_IMPACTS)))
+		return 1;
+
+	ret = snapshot_save(snap) || snapshot_write(snap, SAVE_PATH);
+	delete_snapshot(snap);
+	if (OK == ret)
+		printf("Game saved to %s\n", SAVE_PATH);
+	return ret;
+}
+
+// Private Method -- Starts a single player game, from the saved one if there is one
+static void game_start_single() {
+	Snapshot * snap;
+
+	if (REPLAY_OFF != replay_mode())
+		return;
+	if (NULL == (snap = new_snapshot(SAVE_MAX_MISSILES, SAVE_MAX_EXPLOSIONS,
+			SAVE_MAX_IMPACTS)))
+		return;
+
+	if (OK == snapshot_read(snap, SAVE_PATH) && OK == snapshot_restore(snap)) {
+		printf("Game resumed from %s\n", SAVE_PATH);
+		remove(SAVE_PATH); // A save is resumed once
+	}
+	delete_snapshot(snap);
+}
+
+/** **/
+
+// Enables or disables the interrupts of the serial ports multiplayer uses
+static void mp_serial_interrupts(int enable) {
+	unsigned port;
+
+	for (port = 0; port < com_ports(); ++port) {
+		if (enable)
+			serial_enable_interrupts(port);
+		else
+			serial_disable_interrupts(port);
+	}
+}
+
+// Starts waiting for the other player, the session announces this end until one answers
+static void start_mp_waiting() {
+	mp_serial_interrupts(1);
+	setComState(MP_WAITING);
+}
+
+void planetary_set_render_rate(unsigned long rate) {
+	render_rate = rate;
+	sim_acc_us = 0;
+}
+
+void planetary_measure_time(int measured) {
+	measured_time = measured;
+	last_frame_us = 0;
+}
+
+// Private Method -- Accumulates the time of one interrupt, sets sim_steps and render_alpha
+static void sim_accumulate() {
+	unsigned long elapsed_us = 1000000 / render_rate;
+	uint64_t now;
+
+	if (measured_time) {
+		// Beyond MAX_SIM_STEPS it would be dropped anyway
+		now = now_us();
+		if (0 != last_frame_us)
+			elapsed_us = now - last_frame_us < MAX_SIM_STEPS * SIM_DT_US ?
+					now - last_frame_us : MAX_SIM_STEPS * SIM_DT_US;
+		last_frame_us = now;
+	}
+	sim_acc_us += elapsed_us;
+
+	sim_steps = 0;
+	while (sim_acc_us >= SIM_DT_US && sim_steps < MAX_SIM_STEPS) {
+		sim_acc_us -= SIM_DT_US;
+		++sim_steps;
+	}
+
+	// Too far behind to catch up: slow the game down rather than spiral
+	if (sim_acc_us >= SIM_DT_US)
+		sim_acc_us %= SIM_DT_US;
+
+	render_alpha = (fixed_t) ((sim_acc_us << FIXED_SHIFT) / SIM_DT_US);
+}
+
+game_state_t planetary_get_state() {
+	return game_state;
+}
+
+void planetary_get_check(ReplayCheck_t * check) {
+	*check = last_check;
 }
 
 int timer_handler() {
-	static game_state_t game_state = MENU;
 	static int highscore_flag = 0, winner_flag = 0;
 
 	int ret;
+	int input_read = 1;	// Whether the input of this frame was looked at
+
+	sim_accumulate();
+	if (OK != replay_begin_frame(&sim_steps))
+		return 1;	// Replay over
+	input_drain();
+
+	if (NULL == ui_events)
+		ui_events = new_timer_wheel(ui_ticks);
+	timer_wheel_advance(ui_events, ui_ticks += sim_steps);
 
 	switch (game_state) {
 	case MENU:
 		if ( OK != menu_timer_handler(&game_state)) {
+			highscores_flush();
 			delete_bmps_holder();
 			delete_menu();
+			delete_timer_wheel(ui_events);
+			ui_events = NULL;
 			return 1;
 		}
 		break;
 	case GAME_SINGLE:
+		input_read = 0 != sim_steps; // Read by the simulation steps
 		ret = game_timer_handler();
-		if (OK != ret) {
+		if (GAME_SUSPENDED == ret) {
+			delete_game(); // Saved, resumed from the menu
+			game_state = MENU;
+		} else if (OK != ret) {
 			game_state = END_GAME_ANIMATION;
 			printf("\tEND OF GAME -- \n");
 			// highscore
@@ -202,8 +1061,13 @@ int timer_handler() {
 		}
 		break;
 	case GAME_MULTI:
+		input_read = 0 != sim_steps;
 		ret = multiplayer_timer_handler();
-		if (OK != ret ) {
+		if (MP_GAVE_UP == ret) {
+			mp_serial_interrupts(0);
+			setComState(NONE);
+			game_state = MENU;
+		} else if (OK != ret ) {
 			// Fetch winning status
 			printf("ENDED MULTIPLAYER!\n");
 			game_state = MP_END_ANIMATION;
@@ -213,12 +1077,14 @@ int timer_handler() {
 		}
 		break;
 	case MP_END_ANIMATION:
+		com_update(); // Until the other end has MP_ENDED
 		if ( OK != multiplayer_end_animation(winner_flag) ) {
 			delete_game();
 			game_state = MENU;
 			winner_flag = 0;
 			setComState(NONE);
 		}
+		break;
 	case END_GAME_ANIMATION:
 		if ( OK != end_game_timer_handler(highscore_flag)) {
 			delete_game();
@@ -233,33 +1099,65 @@ int timer_handler() {
 		break;
 	}
 
+	// The frames not simulating a game have time to spare for the disk
+	if (GAME_SINGLE != game_state && GAME_MULTI != game_state)
+		highscores_idle();
+
+	// Keep the key presses and releases for a frame that simulates
+	if (input_read)
+		input_end_frame();
+
 	return OK;
 }
 
+// Stops the multiplayer game, whichever way it is played
+static void mp_game_stop() {
+	if (COM_MODE_ROLLBACK == com_get_mode())
+		net_game_stop();
+	else
+		spectate_stop();
+}
+
 static int multiplayer_timer_handler() {
-	static unsigned long count;
+	int ret;
+
+	com_update();
 
 	switch(getComState()) {
+	case NONE: // No one answered
+		return MP_GAVE_UP;
 	case MP_WAITING:
+		if (key_released_this_frame(KEY_ESC)) { // Stops waiting
+			setComState(MP_ENDED);
+			return MP_GAVE_UP;
+		}
+
 		// draw bitmap waiting for connection
 		drawBitmap(vg_getBufferPtr(), BMPsHolder()->waiting_MP, 0, 0,
 				ALIGN_LEFT);
 		draw_mouse_cross(get_mouse_pos(), WHITE);
-
-		if (count % (FRAME_RATE / 2) == 0 ) {
-			serial_write(MP_WAITING);
-			count = 0;
-		}
-		++count;
 		break;
-	case MP_ONGOING: // You Lost
-		if (game_timer_handler() != OK) {
+	case MP_ONGOING:
+		if (key_released_this_frame(KEY_ESC)) { // You Lost, by leaving
+			mp_game_stop();
+			setComState(MP_ENDED);
+			return 1;
+		}
+
+		ret = COM_MODE_ROLLBACK == com_get_mode() ?
+				net_game_timer_handler() : spectate_timer_handler();
+		if (ROLLBACK_FAILED == ret) {
+			mp_game_stop();
 			setComState(MP_ENDED);
 			return 1;
+		} else if (OK != ret) { // You both Lost
+			mp_game_stop();
+			return 1;
 		}
 		break;
-	case MP_ENDED: // You Won!
-		serial_disable_interrupts();
+	case MP_ENDED: // You Won! The other player left, or stopped answering
+		mp_game_stop();
+		mp_serial_interrupts(0);
 		return 2;
 		break;
 	}
@@ -270,32 +1168,26 @@ static int multiplayer_timer_handler() {
 static int menu_timer_handler(game_state_t * game_state) {
 	static int selected = 0; // Button highlighted. 0 indicates none
 
-	Input_t * Input = input_instance();
 	Menu_t * Menu = menu_instance();
 
 	int enter_flag = 0; // Indicates whether enter was pressed
 
 	/** Handle Keyboard Input **/
-	switch (input_get_key()) {
-	case ESC_BREAK:
-		printf("ESC BREAK_CODE DETECTED: 0x%X\n", ESC_BREAK);
+	if (key_released_this_frame(KEY_ESC)) {
+		printf("ESC RELEASE DETECTED\n");
 		return 1;
-		break;
-	case ENTER_BREAK:
-		printf("ENTER BREAK_CODE DETECTED: 0x%X\n", ENTER_BREAK);
+	}
+	if (key_released_this_frame(KEY_ENTER)) {
+		printf("ENTER RELEASE DETECTED\n");
 		enter_flag = 1;
-		break;
-	case UP_MAKE:
-		printf("UP_ARROW MAKE CODE DETECTED: 0x%X\n", UP_MAKE);
+	}
+	if (key_pressed_this_frame(KEY_UP)) {
+		printf("UP_ARROW PRESS DETECTED\n");
 		selected = selected - 1 < 0 ? 3 : selected - 1; // 3 is the number of buttons
-		break;
-	case DOWN_MAKE:
-		printf("DOWN_ARROW MAKE CODE DETECTED: 0x%X\n", DOWN_MAKE);
+	}
+	if (key_pressed_this_frame(KEY_DOWN)) {
+		printf("DOWN_ARROW PRESS DETECTED\n");
 		selected = selected + 1 > 3 ? 0 : selected + 1;
-		break;
-	default:
-		// Un-mapped key_code received, do nothing
-		break;
 	}
 
 	drawBitmap(vg_getBufferPtr(), BMPsHolder()->menu_background, 0, 0,
@@ -308,6 +1200,7 @@ static int menu_timer_handler(game_state_t * game_state) {
 
 		if (get_mouseRMB()) {
 			*game_state = GAME_SINGLE;
+			game_start_single();
 			selected = 0;
 		}
 	} else if (mouse_inside_rect(Menu->MP_pos[0], Menu->MP_pos[1],
@@ -316,8 +1209,7 @@ static int menu_timer_handler(game_state_t * game_state) {
 		selected = 2;
 
 		if (get_mouseRMB()) {
-			serial_enable_interrupts();
-			setComState(MP_WAITING);
+			start_mp_waiting();
 			*game_state = GAME_MULTI;
 			selected = 0;
 		}
@@ -343,14 +1235,18 @@ static int menu_timer_handler(game_state_t * game_state) {
 	case 1:
 		drawBitmap(vg_getBufferPtr(), BMPsHolder()->SP_button, Menu->SP_pos[0],
 				Menu->SP_pos[1], ALIGN_LEFT);
-		if (enter_flag)
+		if (enter_flag) {
 			*game_state = GAME_SINGLE;
+			game_start_single();
+		}
 		break;
 	case 2:
 		drawBitmap(vg_getBufferPtr(), BMPsHolder()->MP_button, Menu->MP_pos[0],
 				Menu->MP_pos[1], ALIGN_LEFT);
-		if (enter_flag)
+		if (enter_flag) {
+			start_mp_waiting();
 			*game_state = GAME_MULTI;
+		}
 		break;
 	case 3:
 		drawBitmap(vg_getBufferPtr(), BMPsHolder()->HS_button, Menu->HS_pos[0],
@@ -368,106 +1264,140 @@ static int menu_timer_handler(game_state_t * game_state) {
 	return OK;
 }
 
-static int game_timer_handler() {
-
-	Input_t * Input = input_instance();
-	Game_t * self = game_instance();
-	if (NULL == self)
-		printf("THIS SHOULD NEVER HAPPEN\n");
-	unsigned idx;
+// Private Method -- Fires a friendly missile from a cannon (0 left, 1 right). Returns whether it did
+static int fire_cannon(Game_t * self, unsigned cannon, const int * target) {
+	if (gvector_get_size(self->f_missiles) >= max_friendly(self)
+			|| target[1] >= CANNON_POS_Y)
+		return 0;
+
+	int tmp_pos[2] = { self->cannon_pos[cannon]
+			+ (cannon ? -CANNON_PROJECTILE_OFFSET : CANNON_PROJECTILE_OFFSET),
+	CANNON_POS_Y };
+	Missile * tmp = new_fmissile(tmp_pos, target);
+	gvector_push_back(self->f_missiles, &tmp);
+	return 1;
+}
 
-	/** Handle Input **/
-	// Keyboard
-	switch (input_get_key()) {
-	case ESC_BREAK:
-		printf("ESC BREAK_CODE DETECTED\n");
-		return 1;
-		break;
-	default:
-		break;
+// Private Method -- Moves the aim with the arrows or WASD held, once per step. Returns the
+// cannons SPACE fires from, as NET_FIRE_LEFT / NET_FIRE_RIGHT: the right one with LSHIFT held
+static unsigned keyboard_controls() {
+	int dx = 0, dy = 0;
+
+	if (key_down(KEY_LEFT) || key_down(KEY_A))
+		dx -= KEY_AIM_SPEED;
+	if (key_down(KEY_RIGHT) || key_down(KEY_D))
+		dx += KEY_AIM_SPEED;
+	if (key_down(KEY_UP) || key_down(KEY_W))
+		dy -= KEY_AIM_SPEED;
+	if (key_down(KEY_DOWN) || key_down(KEY_S))
+		dy += KEY_AIM_SPEED;
+	if (0 != dx || 0 != dy)
+		move_mouse_pos(dx, dy);
+
+	if (!key_down(KEY_SPACE)) {
+		key_fire_steps = 0;
+		return 0;
 	}
+	// Fires at once, then every KEY_FIRE_PERIOD steps while held
+	if (0 != key_fire_steps++ % KEY_FIRE_PERIOD)
+		return 0;
+	return key_down(KEY_LSHIFT) ? NET_FIRE_RIGHT : NET_FIRE_LEFT;
+}
 
-	// Mouse
-	//spawn missiles on mouse clicks
-	if ( get_mouseRMB() && gvector_get_size(self->f_missiles) < MAX_NUM_MISSILES
-			&& get_mouse_pos()[1] < CANNON_POS_Y ) {
-		int tmp_pos[2] = { self->cannon_pos[0] + CANNON_PROJECTILE_OFFSET,
-		CANNON_POS_Y };
-		Missile * tmp = new_fmissile(tmp_pos, get_mouse_pos());
-		gvector_push_back(self->f_missiles, &tmp);
-	}
-	if ( get_mouseLMB() && gvector_get_size(self->f_missiles) < MAX_NUM_MISSILES
-			&& get_mouse_pos()[1] < CANNON_POS_Y ) {
-		int tmp_pos[2] = { self->cannon_pos[1] - CANNON_PROJECTILE_OFFSET,
-		CANNON_POS_Y };
-		Missile * tmp = new_fmissile(tmp_pos, get_mouse_pos());
-		gvector_push_back(self->f_missiles, &tmp);
-	}
+// Keeps the state of the last step, for replays to compare
+static void game_set_check(Game_t * self) {
+	last_check.frames = self->frames;
+	last_check.score = self->frames / FRAME_RATE;
+	last_check.e_missiles = gvector_get_size(self->e_missiles);
+	last_check.f_missiles = gvector_get_size(self->f_missiles);
+	last_check.explosions = gvector_get_size(self->explosions);
+}
 
-	/** Spontaneous self Events **/
-	++(self->frames);
-	if (self->frames == self->enemy_spawn_fr) {
-		self->enemy_spawn_fr = next_spawn_frame();
-		printf("Spawning New Enemy Missile\n");
-		Missile * new_enemy = new_emissile(self->bases_pos, self->bases_hp);
-		gvector_push_back(self->e_missiles, &new_enemy);
-	}
+// Simulates a single step of the Game, at FRAME_RATE. net holds the players' input of a net game, NULL otherwise
+static int game_update(Game_t * self, const NetInput_t * net) {
+	unsigned idx, fire;
 
-	/** Draw self **/
-	drawBitmap(vg_getBufferPtr(), BMPsHolder()->game_background, 0, 0,
-			ALIGN_LEFT);
+	PROF_BEGIN(PROF_UPDATE);
 
-	// Draw Bases/Houses
-	for (idx = 0; idx < NUM_BASES; ++idx) {
-		unsigned base_hp = self->bases_hp[idx];
+	/** Handle Input **/
+	if (NULL != net) {
+		// Every player fires from both cannons, in player order
+		for (idx = 0; idx < NET_PLAYERS; ++idx) {
+			int target[2] = { net[idx].pos[0], net[idx].pos[1] };
+			if (net[idx].fire & NET_FIRE_LEFT)
+				fire_cannon(self, 0, target);
+			if (net[idx].fire & NET_FIRE_RIGHT)
+				fire_cannon(self, 1, target);
+		}
+	} else {
+		// Keyboard
+		if (key_released_this_frame(KEY_ESC)) {
+			printf("ESC RELEASE DETECTED\n");
+			PROF_END(PROF_UPDATE);
+			return OK == game_suspend() ? GAME_SUSPENDED : 1;
+		}
 
-		drawBitmap(vg_getBufferPtr(), BMPsHolder()->buildings[base_hp],
-				self->bases_pos[idx],
-				GROUND_Y - self->buildings_size_y[base_hp], ALIGN_CENTER);
+		fire = keyboard_controls();
+		if (fire & NET_FIRE_LEFT)
+			fire_cannon(self, 0, get_mouse_pos());
+		if (fire & NET_FIRE_RIGHT)
+			fire_cannon(self, 1, get_mouse_pos());
+
+		// Mouse
+		//spawn missiles on mouse clicks
+		if (get_mouseRMB() && fire_cannon(self, 0, get_mouse_pos()))
+			PROF_DELAY(PROF_CLICK_TO_MISSILE, now_us() - input_get_click_time());
+		if (get_mouseLMB() && fire_cannon(self, 1, get_mouse_pos()))
+			PROF_DELAY(PROF_CLICK_TO_MISSILE, now_us() - input_get_click_time());
 	}
 
-	// Draw and Update enemy missiles
-	for (idx = 0; idx < gvector_get_size(self->e_missiles); ++idx) {
-		draw_missile(*(Missile **) gvector_at(self->e_missiles, idx));
+	if (self->stress)
+		auto_fire(self);
+
+	/** Spontaneous self Events **/
+	++(self->frames);
+	timer_wheel_advance(self->events, ++(self->ticks));
+
+	// Update enemy missiles
+	for (idx = 0; idx < gvector_get_size(self->e_missiles); ++idx)
 		missile_update(*(Missile **) gvector_at(self->e_missiles, idx));
-	}
 
-	// Draw and Update friendly missiles
+	// Update friendly missiles
 	for (idx = 0; idx < gvector_get_size(self->f_missiles); ++idx) {
 		Missile * current = *(Missile **) gvector_at(self->f_missiles, idx);
-		draw_missile(current);
 		if (missile_update(current)) { // Reached End-Pos
 			gvector_erase(self->f_missiles, idx);
 			--idx;
 
-			Explosion * tmp = (Explosion *) delete_missile(current);
-			gvector_push_back(self->explosions, &tmp);
+			push_explosion(self, delete_missile(current));
 		}
 	}
 
-	// Draw and Update Explosions
-	for (idx = 0; idx < gvector_get_size(self->explosions); ++idx) {
-		Explosion * current = *(Explosion **) gvector_at(self->explosions, idx);
-		draw_explosion(current);
-		if (explosion_update(current)) { // Animation ended ?
-			gvector_erase(self->explosions, idx);
-			--idx;
-			delete_explosion(current);
-			printf("\t\t\tExplosion deleted\n");
-		}
-	}
+	PROF_END(PROF_UPDATE);
 
 	/** Collision Detection **/
+	PROF_BEGIN(PROF_COLLISION);
+
+	// Fetch the e_missiles whose impact is due this frame
+	gvector_clear(self->due_impacts);
+	while (0 != gheap_get_size(self->impacts)
+			&& ((Impact_t *) gheap_top(self->impacts))->frame <= self->frames) {
+		gvector_push_back(self->due_impacts, gheap_top(self->impacts));
+		gheap_pop(self->impacts);
+	}
 
 	// Check Collisions e_missiles with ground
-	for (idx = 0; idx < gvector_get_size(self->e_missiles); ++idx) {
-		Missile * current = *(Missile **) gvector_at(self->e_missiles, idx);
+	for (idx = 0; idx < gvector_get_size(self->due_impacts); ++idx) {
+		int m_idx = find_emissile(self,
+				((Impact_t *) gvector_at(self->due_impacts, idx))->id);
+		if (m_idx < 0)
+			continue; // Already destroyed by an explosion
+
+		Missile * current = *(Missile **) gvector_at(self->e_missiles, m_idx);
 		if (missile_getPosY(current) > GROUND_Y) {
-			gvector_erase(self->e_missiles, idx);
-			--idx;
+			gvector_erase(self->e_missiles, m_idx);
 
-			Explosion * tmp = delete_missile(current);
-			gvector_push_back(self->explosions, &tmp);
+			push_explosion(self, delete_missile(current));
 		}
 	}
 
@@ -481,12 +1411,11 @@ static int game_timer_handler() {
 			Missile * missile_ptr = *(Missile **) gvector_at(self->e_missiles,
 					j);
 
-			if (missile_collidedWithExplosion(missile_ptr, exp_ptr)) {
+			if (missile_collidedWithExplosion(missile_ptr, exp_ptr, self->ticks)) {
 				gvector_erase(self->e_missiles, j);
 				--j;
 
-				Explosion * tmp = delete_missile(missile_ptr);
-				gvector_push_back(self->explosions, &tmp);
+				push_explosion(self, delete_missile(missile_ptr));
 			}
 		}
 
@@ -495,76 +1424,78 @@ static int game_timer_handler() {
 			Missile * missile_ptr = *(Missile **) gvector_at(self->f_missiles,
 					j);
 
-			if (missile_collidedWithExplosion(missile_ptr, exp_ptr)) {
+			if (missile_collidedWithExplosion(missile_ptr, exp_ptr, self->ticks)) {
 				gvector_erase(self->f_missiles, j);
 				--j;
 
-				Explosion * tmp = delete_missile(missile_ptr);
-				gvector_push_back(self->explosions, &tmp);
+				push_explosion(self, delete_missile(missile_ptr));
 			}
 		}
 	}
 
 	// Note! Bases aren't destroyed on collisions with explosions by design!
-	// Check Collisions missiles with bases, update bases
-	for (idx = 0; idx < NUM_BASES; ++idx) {
-
-		// Enemy Missiles
-		for (j = 0; j < gvector_get_size(self->e_missiles); ++j) {
-			Missile * missile_ptr = *(Missile **) gvector_at(self->e_missiles,
-					j);
-
-			if (missile_collidedWithRect(missile_ptr,
-					self->bases_pos[idx] - BUILDING_SIZE_X / 2.0,
-					GROUND_Y, BUILDING_SIZE_X,
-					self->buildings_size_y[self->bases_hp[idx]])) {
-				printf("\tCollision Detected! Enemy Missile with base %d!\n",
-						idx);
-
-				gvector_erase(self->e_missiles, j);
-				--j;
+	// Check Collisions of due e_missiles with their target base, update bases
+	for (idx = 0; idx < gvector_get_size(self->due_impacts); ++idx) {
+		Impact_t * impact = (Impact_t *) gvector_at(self->due_impacts, idx);
+		int m_idx = find_emissile(self, impact->id);
+		if (m_idx < 0)
+			continue; // Hit the ground or destroyed by an explosion
+
+		Missile * missile_ptr = *(Missile **) gvector_at(self->e_missiles,
+				m_idx);
+		int base = impact->target;
+
+		if (IMPACT_GROUND != base
+				&& missile_collidedWithRect(missile_ptr,
+						self->bases_pos[base] - BUILDING_SIZE_X / 2,
+						GROUND_Y, BUILDING_SIZE_X,
+						self->buildings_size_y[self->bases_hp[base]])) {
+			printf("\tCollision Detected! Enemy Missile with base %d!\n",
+					base);
+
+			gvector_erase(self->e_missiles, m_idx);
+
+			push_explosion(self, delete_missile(missile_ptr));
+
+			if (!(self->stress && stress.invulnerable))
+				self->bases_hp[base] =
+						self->bases_hp[base] > 0 ? self->bases_hp[base] - 1 : 0;
+		} else {
+			// Prediction was early, or the base shrank meanwhile
+			schedule_impact(self, missile_ptr, self->frames);
+		}
+	}
 
-				Explosion * tmp = delete_missile(missile_ptr);
-				gvector_push_back(self->explosions, &tmp);
+	PROF_END(PROF_COLLISION);
 
-				self->bases_hp[idx] =
-						self->bases_hp[idx] > 0 ? self->bases_hp[idx] - 1 : 0;
-			}
-		}
+	PROF_GAUGE(PROF_E_MISSILES, gvector_get_size(self->e_missiles));
+	PROF_GAUGE(PROF_F_MISSILES, gvector_get_size(self->f_missiles));
+	PROF_GAUGE(PROF_EXPLOSIONS, gvector_get_size(self->explosions));
 
-	}
+	game_set_check(self);
 
 	/** **/
 
-	// Draw Score - Upper Right Corner
-	draw_score(self->frames / FRAME_RATE, vg_getHorRes() - 10, 10);
-
 	// Calculate HP -- Game ends if it's zero
-	unsigned health_points = 0;
+	self->health_points = 0;
 	for (idx = 0; idx < NUM_BASES; ++idx) {
 		if (self->bases_hp[idx] > 0)
-			++health_points;
+			++(self->health_points);
 	}
 
-	// Draw Lives - Upper Left Corner
-	for (idx = 0; idx < health_points; ++idx) {
-		drawBitmap(vg_getBufferPtr(), BMPsHolder()->heart,
-				10 + (idx * HEART_SIZE_X + 10), 10, ALIGN_LEFT);
-	}
-
-	// Draw mouse cross last, so it is in the top layer
-	draw_mouse_cross(get_mouse_pos(), BLACK);
+	if (0 == self->health_points) { // Everything Explodes in the End x)
 
-	if (0 == health_points) { // Everything Explodes in the End x)
+		timer_wheel_cancel(self->events, self->spawn_timer);
+		self->spawn_timer = NULL;
 
 		// Delete Enemy Missiles
+		gheap_clear(self->impacts);
 		while (0 != gvector_get_size(self->e_missiles)) {
 			Missile * missile_ptr = *(Missile **) gvector_at(self->e_missiles,
 					0);
 			gvector_erase(self->e_missiles, 0);
 
-			Explosion * tmp = delete_missile(missile_ptr);
-			gvector_push_back(self->explosions, &tmp);
+			push_explosion(self, delete_missile(missile_ptr));
 		}
 
 		// Delete Friendly Missiles
@@ -573,27 +1504,33 @@ static int game_timer_handler() {
 					0);
 			gvector_erase(self->f_missiles, 0);
 
-			Explosion * tmp = delete_missile(missile_ptr);
-			gvector_push_back(self->explosions, &tmp);
+			push_explosion(self, delete_missile(missile_ptr));
 		}
 
+		if (NULL != net)
+			return 1; // Both ends lost, on the same step. No scores are kept
+
 		/* Update Scores */
 		//creating a new Score
 		Score_t endgame;
 		endgame.score = (self->frames / FRAME_RATE);
 
 		//Assembling Date and Hour
-		Date_t * date = rtc_read_date();
-		endgame.hour = date->hour;
-		endgame.minute = date->minute;
-		endgame.day = date->day;
-		endgame.month = date->month;
-		endgame.year = 2000 + date->year;
-		free(date);
-
-		if (updateScores(self->highscores, endgame)) {
-			writeScores(SCORES_TXT_PATH,
-					self->highscores);
+		Date_t date;
+		rtc_read_date(&date);
+		replay_date(&date);
+		endgame.hour = date.hour;
+		endgame.minute = date.minute;
+		endgame.day = date.day;
+		endgame.month = date.month;
+		endgame.year = 2000 + date.year;
+
+		int rank;
+		if (REPLAY_PLAYING == replay_mode()) // Replays leave the store alone
+			rank = highscores_rank(endgame.score);
+		else if ((rank = highscores_insert(&endgame)) >= 0)
+			highscores_save(); // Written in idle ticks
+		if (rank >= 0 && rank < HIGHSCORE_NUMBER) {
 			printf("END_OF_GAME->HIGHSCORE\n");
 			return 2; // return highscore flag
 		}
@@ -604,32 +1541,708 @@ static int game_timer_handler() {
 	return OK;
 }
 
+// Draws the Game, interpolating missiles between the last two steps
+static void game_draw(Game_t * self) {
+	unsigned idx;
+
+	drawBitmap(vg_getBufferPtr(), BMPsHolder()->game_background, 0, 0,
+			ALIGN_LEFT);
+
+	// Draw Bases/Houses
+	for (idx = 0; idx < NUM_BASES; ++idx) {
+		unsigned base_hp = self->bases_hp[idx];
+
+		drawBitmap(vg_getBufferPtr(), BMPsHolder()->buildings[base_hp],
+				self->bases_pos[idx],
+				GROUND_Y - self->buildings_size_y[base_hp], ALIGN_CENTER);
+	}
+
+	// Draw enemy missiles
+	for (idx = 0; idx < gvector_get_size(self->e_missiles); ++idx)
+		draw_missile(*(Missile **) gvector_at(self->e_missiles, idx),
+				render_alpha);
+
+	// Draw friendly missiles
+	for (idx = 0; idx < gvector_get_size(self->f_missiles); ++idx)
+		draw_missile(*(Missile **) gvector_at(self->f_missiles, idx),
+				render_alpha);
+
+	// Draw Explosions
+	for (idx = 0; idx < gvector_get_size(self->explosions); ++idx) {
+		draw_explosion(*(Explosion **) gvector_at(self->explosions, idx),
+				self->ticks);
+	}
+
+	// Draw Score - Upper Right Corner
+	draw_score(self->frames / FRAME_RATE, vg_getHorRes() - 10, 10);
+
+	// Draw Lives - Upper Left Corner
+	for (idx = 0; idx < self->health_points; ++idx) {
+		drawBitmap(vg_getBufferPtr(), BMPsHolder()->heart,
+				10 + (idx * HEART_SIZE_X + 10), 10, ALIGN_LEFT);
+	}
+
+	// Draw mouse cross last, so it is in the top layer
+	draw_mouse_cross(get_mouse_pos(), BLACK);
+}
+
+// Handles Timer Interrupts while a Game is ongoing
+static int game_timer_handler() {
+	Game_t * self = game_instance();
+	if (NULL == self)
+		printf("THIS SHOULD NEVER HAPPEN\n");
+
+	unsigned step;
+	for (step = 0; step < sim_steps; ++step) {
+		int ret = game_update(self, NULL);
+		if (OK != ret)
+			return ret;
+	}
+
+	PROF_BEGIN(PROF_DRAW);
+	game_draw(self);
+	PROF_END(PROF_DRAW);
+
+	return OK;
+}
+
+/**
+ * Net game: a single game on both ends, stepped by the Rollback
+ */
+
+static Snapshot * net_snaps[ROLLBACK_WINDOW];	// State before the last steps, to go back to
+
+static int net_save(unsigned slot) {
+	return snapshot_save(net_snaps[slot]);
+}
+
+static int net_load(unsigned slot) {
+	return snapshot_restore(net_snaps[slot]);
+}
+
+static int net_step(const NetInput_t inputs[NET_PLAYERS]) {
+	return game_update(game_instance(), inputs);
+}
+
+// Starts the game both ends play, from the seed they agreed on
+static int net_game_start() {
+	static const RollbackCb_t cb = { net_save, net_load, net_step };
+	unsigned slot;
+
+	delete_game();
+	rng_seed_streams(com_get_seed());
+	game_instance()->net = rollback_players();
+
+	for (slot = 0; slot < ROLLBACK_WINDOW; ++slot) {
+		if (NULL == (net_snaps[slot] = new_snapshot(SAVE_MAX_MISSILES,
+				SAVE_MAX_EXPLOSIONS, SAVE_MAX_IMPACTS))) {
+			net_game_stop();
+			return 1;
+		}
+	}
+
+	rollback_attach(&cb);
+	return OK;
+}
+
+static void net_game_stop() {
+	unsigned slot;
+	const RollbackStats_t * stats = rollback_get_stats();
+
+	printf("Net game: %lu steps, %lu rollbacks (%lu steps simulated again, %u at most), %lu stalls\n",
+			stats->frames, stats->rollbacks, stats->resimulated,
+			stats->max_depth, stats->stalls);
+
+	rollback_stop();
+	for (slot = 0; slot < ROLLBACK_WINDOW; ++slot) {
+		if (NULL != net_snaps[slot])
+			delete_snapshot(net_snaps[slot]);
+		net_snaps[slot] = NULL;
+	}
+}
+
+// Private Method -- Takes the local input of a step
+static void net_local_input(NetInput_t * input) {
+	input->fire = keyboard_controls();
+	input->pos[0] = get_mouse_pos()[0];
+	input->pos[1] = get_mouse_pos()[1];
+	input->fire |= (get_mouseRMB() ? NET_FIRE_LEFT : 0)
+			| (get_mouseLMB() ? NET_FIRE_RIGHT : 0);
+}
+
+// Handles Timer Interrupts while a net game is ongoing
+static int net_game_timer_handler() {
+	Game_t * self = game_instance();
+	unsigned step, player;
+	int ret;
+
+	if (NULL == net_snaps[0] && OK != net_game_start())
+		return ROLLBACK_FAILED;
+
+	// Corrects the steps the remote input received proves mispredicted, then runs the new ones
+	ret = rollback_update();
+	for (step = 0; OK == ret && step < sim_steps && rollback_ready(); ++step) {
+		NetInput_t local;
+
+		net_local_input(&local);
+		com_send_input(rollback_frame(), &local);
+		ret = rollback_step(&local);
+	}
+
+	PROF_BEGIN(PROF_DRAW);
+	game_draw(self);
+	for (player = 0; player < rollback_players(); ++player) {
+		const NetInput_t * remote = rollback_last_remote(player);
+		int remote_pos[2] = { remote->pos[0], remote->pos[1] };
+		if (player != com_get_player())
+			draw_mouse_cross(remote_pos, RED);
+	}
+	PROF_END(PROF_DRAW);
+
+	return ret;
+}
+
+/**
+ * Watched game: one end plays, and sends each step to the other end as the changes it
+ * made (a delta): missiles spawned and destroyed, explosions started, bases damaged.
+ * Every SPECTATE_KEYFRAME steps, and whenever a step could not be sent, the whole game
+ * goes instead (a keyframe). Missiles fly straight at constant velocity, so one is
+ * described by how it started, and how many steps ago.
+ */
+
+#define SPEC_POS_BITS	10	// Bits of a position on screen, where missiles start and aim at
+#define SPEC_HP_BITS	2	// Bits of the health of a base
+
+typedef struct {
+	unsigned id;
+	Missile * missile;
+} SpecEntry_t;
+
+static int spec_on = 0;
+static GVector * spec_sent = NULL;	// Missiles the watching end has, by id
+static GVector * spec_now = NULL;	// Missiles alive after the step, by id
+static unsigned spec_bases_hp[NUM_BASES];	// Health of the bases the watching end has
+static unsigned long spec_next_key = 0;	// Step of the next keyframe
+static int spec_synced = 0;		// Watching end: a keyframe arrived since steps were lost
+static unsigned char spec_buf[COM_DELTA_MAX];
+static SpectateStats_t spec_stats;
+
+void planetary_set_watch(int watch) {
+	com_set_watch(watch);
+}
+
+int planetary_set_ring(unsigned nodes, unsigned index, unsigned long rate) {
+	if (OK != com_set_ring(nodes, index, rate))
+		return 1;
+	com_ring_sustains(FRAME_RATE);
+	return OK;
+}
+
+const SpectateStats_t * planetary_get_spectate_stats() {
+	return &spec_stats;
+}
+
+// Private Method -- Lists the missiles alive by id, merging the enemy and friendly ones
+static void spec_list_alive(Game_t * self, GVector * out) {
+	unsigned e = 0, f = 0, num_e = gvector_get_size(self->e_missiles),
+			num_f = gvector_get_size(self->f_missiles);
+	SpecEntry_t entry;
+
+	gvector_clear(out);
+	while (e < num_e || f < num_f) {
+		Missile * em = e < num_e ? *(Missile **) gvector_at(self->e_missiles, e) : NULL;
+		Missile * fm = f < num_f ? *(Missile **) gvector_at(self->f_missiles, f) : NULL;
+
+		if (NULL == fm || (NULL != em && missile_getId(em) < missile_getId(fm))) {
+			entry.missile = em;
+			++e;
+		} else {
+			entry.missile = fm;
+			++f;
+		}
+		entry.id = missile_getId(entry.missile);
+		gvector_push_back(out, &entry);
+	}
+}
+
+// Private Method -- Steps a missile has flown
+static unsigned spec_missile_age(const MissileState_t * st) {
+	int axis = abs(st->velocity[0]) > abs(st->velocity[1]) ? 0 : 1;
+
+	if (0 == st->velocity[axis])
+		return 0;
+	return (st->pos[axis] - INT_TO_FIXED(st->init_pos[axis])) / st->velocity[axis];
+}
+
+// Private Method -- Writes how a missile started, and its age in keyframes
+static void spec_put_missile(BitPack_t * bp, Missile * missile,
+		unsigned prev_id, int key) {
+	MissileState_t st;
+
+	missile_getState(missile, &st);
+	bitpack_put_varint(bp, st.id - prev_id);
+	bitpack_put(bp, st.friendly, 1);
+	bitpack_put(bp, st.init_pos[0], SPEC_POS_BITS);
+	bitpack_put(bp, st.init_pos[1], SPEC_POS_BITS);
+	if (st.friendly) { // Its velocity follows from where it aims at
+		bitpack_put(bp, st.end_pos[0], SPEC_POS_BITS);
+		bitpack_put(bp, st.end_pos[1], SPEC_POS_BITS);
+	} else {
+		bitpack_put_svarint(bp, st.velocity[0]);
+		bitpack_put_svarint(bp, st.velocity[1]);
+	}
+	if (key)
+		bitpack_put_varint(bp, spec_missile_age(&st));
+}
+
+// Private Method -- Writes an explosion, and its age in keyframes
+static void spec_put_explosion(BitPack_t * bp, Game_t * self, Explosion * exp,
+		int key) {
+	bitpack_put_svarint(bp, explosion_getPosX(exp));
+	bitpack_put_svarint(bp, explosion_getPosY(exp));
+	if (key) {
+		ExplosionState_t st;
+		explosion_getState(exp, &st);
+		bitpack_put_varint(bp, self->ticks - st.start_frame);
+	}
+}
+
+// Private Method -- Writes the whole game. Returns the bits the missiles took
+static unsigned long spec_encode_key(Game_t * self, BitPack_t * bp) {
+	unsigned idx, prev_id = 0, num = gvector_get_size(spec_now);
+	unsigned long bits;
+
+	bitpack_put(bp, 1, 1);
+	bitpack_put_varint(bp, self->frames);
+	bitpack_put_varint(bp, self->ticks);
+	for (idx = 0; idx < NUM_BASES; ++idx)
+		bitpack_put(bp, self->bases_hp[idx], SPEC_HP_BITS);
+
+	bits = bp->bit;
+	bitpack_put_varint(bp, num);
+	for (idx = 0; idx < num; ++idx) {
+		SpecEntry_t * entry = (SpecEntry_t *) gvector_at(spec_now, idx);
+		spec_put_missile(bp, entry->missile, prev_id, 1);
+		prev_id = entry->id;
+	}
+	bits = bp->bit - bits;
+
+	bitpack_put_varint(bp, gvector_get_size(self->explosions));
+	for (idx = 0; idx < gvector_get_size(self->explosions); ++idx)
+		spec_put_explosion(bp, self,
+				*(Explosion **) gvector_at(self->explosions, idx), 1);
+	return bits;
+}
+
+// Private Method -- Writes what the step changed, comparing both sorted lists of missiles
+static void spec_encode_delta(Game_t * self, BitPack_t * bp) {
+	unsigned idx, prev_id = 0, count = 0, first, changed = 0;
+	unsigned num_sent = gvector_get_size(spec_sent), num_now = gvector_get_size(spec_now);
+	unsigned long bits;
+
+	bitpack_put(bp, 0, 1);
+
+	// Spawned: the ids past the last one sent, as ids only grow
+	first = num_now;
+	while (first > 0 && (0 == num_sent
+			|| ((SpecEntry_t *) gvector_at(spec_now, first - 1))->id
+					> ((SpecEntry_t *) gvector_at(spec_sent, num_sent - 1))->id))
+		--first;
+	bitpack_put_varint(bp, num_now - first);
+	bits = bp->bit;
+	if (0 != num_sent)
+		prev_id = ((SpecEntry_t *) gvector_at(spec_sent, num_sent - 1))->id;
+	for (idx = first; idx < num_now; ++idx) {
+		SpecEntry_t * entry = (SpecEntry_t *) gvector_at(spec_now, idx);
+		spec_put_missile(bp, entry->missile, prev_id, 0);
+		prev_id = entry->id;
+	}
+	spec_stats.spawned += num_now - first;
+	spec_stats.spawn_bits += bp->bit - bits;
+
+	// Destroyed: the ids sent that are gone
+	{
+		unsigned s, n = 0;
+		for (s = 0; s < num_sent; ++s) {
+			unsigned id = ((SpecEntry_t *) gvector_at(spec_sent, s))->id;
+			while (n < first && ((SpecEntry_t *) gvector_at(spec_now, n))->id < id)
+				++n;
+			if (n >= first || ((SpecEntry_t *) gvector_at(spec_now, n))->id != id)
+				++count;
+		}
+
+		bitpack_put_varint(bp, count);
+		prev_id = 0;
+		for (s = 0, n = 0; s < num_sent; ++s) {
+			unsigned id = ((SpecEntry_t *) gvector_at(spec_sent, s))->id;
+			while (n < first && ((SpecEntry_t *) gvector_at(spec_now, n))->id < id)
+				++n;
+			if (n >= first || ((SpecEntry_t *) gvector_at(spec_now, n))->id != id) {
+				bitpack_put_varint(bp, id - prev_id);
+				prev_id = id;
+			}
+		}
+	}
+
+	// Explosions started: the last ones added, in this step
+	for (first = gvector_get_size(self->explosions); first > 0; --first) {
+		ExplosionState_t st;
+		explosion_getState(*(Explosion **) gvector_at(self->explosions, first - 1),
+				&st);
+		if (st.start_frame != self->ticks)
+			break;
+	}
+	bitpack_put_varint(bp, gvector_get_size(self->explosions) - first);
+	for (idx = first; idx < gvector_get_size(self->explosions); ++idx)
+		spec_put_explosion(bp, self,
+				*(Explosion **) gvector_at(self->explosions, idx), 0);
+
+	for (idx = 0; idx < NUM_BASES; ++idx)
+		changed |= self->bases_hp[idx] != spec_bases_hp[idx];
+	bitpack_put(bp, changed, 1);
+	if (changed)
+		for (idx = 0; idx < NUM_BASES; ++idx)
+			bitpack_put(bp, self->bases_hp[idx], SPEC_HP_BITS);
+}
+
+// Sends the step just simulated, as a delta or a keyframe
+static void spectate_send_step(Game_t * self) {
+	BitPack_t bp;
+	int key = self->frames >= spec_next_key;
+	unsigned len, idx;
+	unsigned long missile_bits = 0;
+	GVector * tmp;
+
+	spec_list_alive(self, spec_now);
+
+	bitpack_init(&bp, spec_buf, sizeof(spec_buf));
+	if (key)
+		missile_bits = spec_encode_key(self, &bp);
+	else
+		spec_encode_delta(self, &bp);
+	len = bitpack_bytes(&bp);
+
+	if (bp.overflow || OK != com_send_delta(spec_buf, len)) {
+		++spec_stats.dropped;
+		spec_next_key = self->frames + 1; // The other end is behind, send everything
+	} else {
+		++spec_stats.steps;
+		spec_stats.bytes += COM_DELTA_WIRE(len);
+		if (COM_DELTA_WIRE(len) > spec_stats.max_bytes)
+			spec_stats.max_bytes = COM_DELTA_WIRE(len);
+		if (key) {
+			++spec_stats.keyframes;
+			spec_stats.keyframe_bytes += COM_DELTA_WIRE(len);
+			spec_stats.keyframe_missiles += gvector_get_size(spec_now);
+			spec_stats.keyframe_missile_bits += missile_bits;
+			spec_next_key = self->frames + SPECTATE_KEYFRAME;
+		}
+	}
+
+	// What the other end has now, as far as the next delta is concerned
+	tmp = spec_sent;
+	spec_sent = spec_now;
+	spec_now = tmp;
+	for (idx = 0; idx < NUM_BASES; ++idx)
+		spec_bases_hp[idx] = self->bases_hp[idx];
+}
+
+// Private Method -- Rebuilds a missile from how it started, and its age
+static Missile * spec_new_missile(MissileState_t * st, unsigned age) {
+	Missile * missile;
+	unsigned axis;
+
+	if (st->friendly) { // Same velocity as the playing end computed
+		int init_pos[2] = { st->init_pos[0], st->init_pos[1] };
+		int end_pos[2] = { st->end_pos[0], st->end_pos[1] };
+		MissileState_t fired;
+
+		missile = new_fmissile(init_pos, end_pos);
+		missile_getState(missile, &fired);
+		st->velocity[0] = fired.velocity[0];
+		st->velocity[1] = fired.velocity[1];
+		st->color = fired.color;
+	} else {
+		if (NULL == (missile = malloc(missile_getSizeOf())))
+			return NULL;
+		st->color = RED;
+	}
+
+	for (axis = 0; axis < 2; ++axis) {
+		st->pos[axis] = (fixed_t) ((uint32_t) INT_TO_FIXED(st->init_pos[axis])
+				+ age * (uint32_t) st->velocity[axis]);
+		st->prev_pos[axis] = age ? st->pos[axis] - st->velocity[axis] : st->pos[axis];
+	}
+	missile_setState(missile, st);
+	return missile;
+}
+
+// Private Method -- Reads a missile, adding it to the game
+static unsigned spec_get_missile(Game_t * self, BitPack_t * bp,
+		unsigned prev_id, int key) {
+	MissileState_t st;
+	unsigned age = 0;
+	Missile * missile;
+
+	memset(&st, 0, sizeof(st));
+	st.id = prev_id + bitpack_get_varint(bp);
+	st.friendly = bitpack_get(bp, 1);
+	st.init_pos[0] = bitpack_get(bp, SPEC_POS_BITS);
+	st.init_pos[1] = bitpack_get(bp, SPEC_POS_BITS);
+	if (st.friendly) {
+		st.end_pos[0] = bitpack_get(bp, SPEC_POS_BITS);
+		st.end_pos[1] = bitpack_get(bp, SPEC_POS_BITS);
+	} else {
+		st.velocity[0] = bitpack_get_svarint(bp);
+		st.velocity[1] = bitpack_get_svarint(bp);
+	}
+	if (key)
+		age = bitpack_get_varint(bp);
+
+	if (!bp->overflow && NULL != (missile = spec_new_missile(&st, age)))
+		gvector_push_back(st.friendly ? self->f_missiles : self->e_missiles,
+				&missile);
+	return st.id;
+}
+
+// Private Method -- Reads an explosion, adding it to the game
+static void spec_get_explosion(Game_t * self, BitPack_t * bp, int key) {
+	int pos[2];
+	Explosion * exp;
+
+	pos[0] = bitpack_get_svarint(bp);
+	pos[1] = bitpack_get_svarint(bp);
+	exp = new_explosion(pos);
+	explosion_setStartFrame(exp, self->ticks - (key ? bitpack_get_varint(bp) : 0));
+	gvector_push_back(self->explosions, &exp);
+	timer_wheel_add(self->events, explosion_getEndFrame(exp), explosion_ended,
+			exp);
+}
+
+// Private Method -- Removes a missile, without the explosion the playing end sends apart
+static void spec_remove_missile(Game_t * self, unsigned id) {
+	GVector * missiles = self->e_missiles;
+	int idx = find_emissile(self, id);
+
+	if (idx < 0) {
+		missiles = self->f_missiles;
+		for (idx = (int) gvector_get_size(missiles) - 1; idx >= 0; --idx)
+			if (missile_getId(*(Missile **) gvector_at(missiles, idx)) == id)
+				break;
+		if (idx < 0)
+			return;
+	}
+
+	delete_explosion(delete_missile(*(Missile **) gvector_at(missiles, idx)));
+	gvector_erase(missiles, idx);
+}
+
+// Private Method -- Empties the game, to be filled by a keyframe
+static void spec_clear(Game_t * self) {
+	unsigned idx;
+
+	for (idx = 0; idx < gvector_get_size(self->e_missiles); ++idx)
+		free(*(Missile **) gvector_at(self->e_missiles, idx));
+	for (idx = 0; idx < gvector_get_size(self->f_missiles); ++idx)
+		free(*(Missile **) gvector_at(self->f_missiles, idx));
+	for (idx = 0; idx < gvector_get_size(self->explosions); ++idx)
+		delete_explosion(*(Explosion **) gvector_at(self->explosions, idx));
+	gvector_clear(self->e_missiles);
+	gvector_clear(self->f_missiles);
+	gvector_clear(self->explosions);
+	gheap_clear(self->impacts);
+}
+
+// Private Method -- Applies a step received. Returns non-zero if it is not valid
+static int spectate_apply_step(Game_t * self, unsigned char * step, unsigned len) {
+	BitPack_t bp;
+	unsigned idx, num, prev_id = 0;
+
+	bitpack_init(&bp, step, len);
+	if (bitpack_get(&bp, 1)) { // Keyframe
+		spec_clear(self);
+		self->frames = bitpack_get_varint(&bp);
+		self->ticks = bitpack_get_varint(&bp);
+		timer_wheel_reset(self->events, self->ticks);
+		self->spawn_timer = NULL;
+		for (idx = 0; idx < NUM_BASES; ++idx)
+			self->bases_hp[idx] = bitpack_get(&bp, SPEC_HP_BITS);
+
+		num = bitpack_get_varint(&bp);
+		for (idx = 0; idx < num && !bp.overflow; ++idx)
+			prev_id = spec_get_missile(self, &bp, prev_id, 1);
+		num = bitpack_get_varint(&bp);
+		for (idx = 0; idx < num && !bp.overflow; ++idx)
+			spec_get_explosion(self, &bp, 1);
+
+		spec_synced = !bp.overflow;
+	} else if (spec_synced) {
+		++(self->frames);
+		timer_wheel_advance(self->events, ++(self->ticks));
+
+		num = bitpack_get_varint(&bp);
+		if (0 != gvector_get_size(self->f_missiles))
+			prev_id = missile_getId(*(Missile **) gvector_at(self->f_missiles,
+					gvector_get_size(self->f_missiles) - 1));
+		if (0 != gvector_get_size(self->e_missiles)) {
+			unsigned last = missile_getId(*(Missile **) gvector_at(
+					self->e_missiles, gvector_get_size(self->e_missiles) - 1));
+			prev_id = last > prev_id ? last : prev_id;
+		}
+		for (idx = 0; idx < num && !bp.overflow; ++idx)
+			prev_id = spec_get_missile(self, &bp, prev_id, 0);
+
+		// Spawned missiles move in the step they appear, as on the playing end
+		for (idx = 0; idx < gvector_get_size(self->e_missiles); ++idx)
+			missile_update(*(Missile **) gvector_at(self->e_missiles, idx));
+		for (idx = 0; idx < gvector_get_size(self->f_missiles); ++idx)
+			missile_update(*(Missile **) gvector_at(self->f_missiles, idx));
+
+		num = bitpack_get_varint(&bp);
+		for (idx = 0, prev_id = 0; idx < num && !bp.overflow; ++idx) {
+			prev_id += bitpack_get_varint(&bp);
+			spec_remove_missile(self, prev_id);
+		}
+
+		num = bitpack_get_varint(&bp);
+		for (idx = 0; idx < num && !bp.overflow; ++idx)
+			spec_get_explosion(self, &bp, 0);
+
+		if (bitpack_get(&bp, 1))
+			for (idx = 0; idx < NUM_BASES; ++idx)
+				self->bases_hp[idx] = bitpack_get(&bp, SPEC_HP_BITS);
+
+		if (bp.overflow)
+			spec_synced = 0; // Wait for the next keyframe
+	}
+
+	self->health_points = 0;
+	for (idx = 0; idx < NUM_BASES; ++idx)
+		if (self->bases_hp[idx] > 0)
+			++(self->health_points);
+	game_set_check(self);
+
+	return bp.overflow;
+}
+
+// Starts a watched game, on either end
+static int spectate_start() {
+	delete_game();
+	rng_seed_streams(com_get_seed());
+	game_instance();
+
+	if (NULL == spec_sent)
+		spec_sent = new_gvector(sizeof(SpecEntry_t));
+	if (NULL == spec_now)
+		spec_now = new_gvector(sizeof(SpecEntry_t));
+	gvector_clear(spec_sent);
+	memset(spec_bases_hp, 0, sizeof(spec_bases_hp));
+	memset(&spec_stats, 0, sizeof(spec_stats));
+	spec_next_key = 0;
+	spec_synced = 0;
+
+	if (COM_MODE_WATCH == com_get_mode()) { // Nothing is simulated here
+		timer_wheel_cancel(game_ptr->events, game_ptr->spawn_timer);
+		game_ptr->spawn_timer = NULL;
+	}
+
+	spec_on = 1;
+	return OK;
+}
+
+static void spectate_stop() {
+	if (spec_on && COM_MODE_HOST == com_get_mode())
+		printf("Watched game: %lu steps, %lu bytes (%u at most), %lu keyframes, %lu steps dropped\n",
+				spec_stats.steps, spec_stats.bytes, spec_stats.max_bytes,
+				spec_stats.keyframes, spec_stats.dropped);
+	spec_on = 0;
+}
+
+// Handles Timer Interrupts while a watched game is ongoing, on either end
+static int spectate_timer_handler() {
+	Game_t * self;
+	unsigned step, steps = sim_steps;
+	int ret = OK;
+
+	if (!spec_on && OK != spectate_start())
+		return ROLLBACK_FAILED;
+	self = game_instance();
+
+	if (COM_MODE_HOST == com_get_mode()) {
+		// Played as a net game of one, so ESC and the end of the game are left to the caller
+		NetInput_t inputs[NET_PLAYERS];
+		memset(inputs, 0, sizeof(inputs));
+
+		for (step = 0; OK == ret && step < sim_steps; ++step) {
+			net_local_input(&inputs[0]);
+			ret = game_update(self, inputs);
+			spectate_send_step(self);
+		}
+	} else {
+		// Falls behind at most WATCH_MAX_BACKLOG steps, catching up if it does
+		if (com_delta_queued() > WATCH_MAX_BACKLOG)
+			steps += com_delta_queued() - WATCH_MAX_BACKLOG;
+
+		for (step = 0; OK == ret && step < steps; ++step) {
+			int len = com_read_delta(spec_buf);
+			if (0 == len)
+				break;
+			if (len < 0 || OK != spectate_apply_step(self, spec_buf, len))
+				spec_synced = 0;
+			else if (0 == self->health_points)
+				ret = 1; // The playing end lost
+		}
+	}
+
+	PROF_BEGIN(PROF_DRAW);
+	game_draw(self);
+	PROF_END(PROF_DRAW);
+
+	return ret;
+}
+
+// Timer callback -- half-second beat of the end of game animation
+static void end_game_beat(void * data) {
+	Game_t * self = (Game_t *) data;
+
+	// Spawn Random Explosion
+	Rng_t * rng = rng_stream(RNG_COSMETIC);
+	int rand_pos[2] = { EXPLOSION_SIZE_X
+			+ rng_below(rng, vg_getHorRes() - 2 * EXPLOSION_SIZE_X),
+	EXPLOSION_SIZE_Y + rng_below(rng, vg_getVerRes() - 2 * EXPLOSION_SIZE_Y) };
+	push_explosion(self, new_explosion(rand_pos));
+
+	self->blink = !self->blink;
+	timer_wheel_add(self->events, self->ticks + FRAME_RATE / 2, end_game_beat,
+			self);
+}
+
+// Timer callback -- end of game animation timed out
+static void end_game_timeout(void * data) {
+	((Game_t *) data)->end_animation_over = 1;
+}
+
 // Handles Timer Interrupts in the End of Game Animation State
 static int end_game_timer_handler(int highscore_flag) {
-	static unsigned count = 0;	// For blinking animation
-
 	Game_t * self = game_instance();
 	unsigned idx;
 
-	/** Handle Input **/
+	/** Handle Keyboard Input **/
 	// Keyboard
-	switch (input_get_key()) {
-	case ESC_BREAK:
-		count = 0;
-		return 1;
-		break;
-	case ENTER_BREAK:
-		count = 0;
+	if (key_released_this_frame(KEY_ESC) || key_released_this_frame(KEY_ENTER))
 		return 1;
-	default:
-		break;
+
+	if (!self->end_animation) {
+		self->end_animation = 1;
+		timer_wheel_add(self->events, self->ticks, end_game_beat, self);
+		// Exit after 10 seconds
+		timer_wheel_add(self->events, self->ticks + 10 * FRAME_RATE,
+				end_game_timeout, self);
 	}
+	timer_wheel_advance(self->events, self->ticks += sim_steps);
 
-	// Exit after 10 seconds
-	if (count / 60 == 10) {
-		count = 0;
+	if (self->end_animation_over)
 		return 1;
-	}
 
 	// Draw Background
 	drawBitmap(vg_getBufferPtr(), BMPsHolder()->game_background, 0, 0,
@@ -641,30 +2254,14 @@ static int end_game_timer_handler(int highscore_flag) {
 				vg_getHorRes() / 2, 100, ALIGN_CENTER);
 	}
 
-	// Spawn Random Explosions every 0.5 seconds
-	if (count % (FRAME_RATE / 2) == 0) {
-		int rand_pos[2] = { EXPLOSION_SIZE_X
-				+ rand() % (vg_getHorRes() - 2 * EXPLOSION_SIZE_X),
-		EXPLOSION_SIZE_Y + rand() % (vg_getVerRes() - 2 * EXPLOSION_SIZE_Y) };
-		Explosion * new = new_explosion(rand_pos);
-		gvector_push_back(self->explosions, &new);
-	}
-
-	// Draw and Update Explosions
+	// Draw Explosions
 	for (idx = 0; idx < gvector_get_size(self->explosions); ++idx) {
-		Explosion * current = *(Explosion **) gvector_at(self->explosions, idx);
-		draw_explosion(current);
-		if (explosion_update(current)) { // Animation ended ?
-			gvector_erase(self->explosions, idx);
-			--idx;
-			delete_explosion(current);
-			printf("\t\t\tExplosion deleted\n");
-		}
+		draw_explosion(*(Explosion **) gvector_at(self->explosions, idx),
+				self->ticks);
 	}
 
-	++count;
 	// Draw Blinking Score -- Center of Screen
-	if ((count / (FRAME_RATE / 2)) % 2)
+	if (self->blink)
 		draw_score(self->frames / FRAME_RATE,
 				vg_getHorRes() / 2 + NUMBER_SIZE_X / 2,
 				vg_getVerRes() / 2 + NUMBER_SIZE_Y / 2);
@@ -673,28 +2270,19 @@ static int end_game_timer_handler(int highscore_flag) {
 }
 
 static int highscores_timer_handler() {
-	static Score_t * scores = NULL;
+	const Score_t * score;
 
-	// Fetch Highscores if not loaded
-	if (NULL == scores)
-		scores = loadScores(SCORES_TXT_PATH);
+	// Loaded once, by the first game or visit
+	highscores_open(SCORES_PATH, SCORES_TXT_PATH);
 
 	/** Handle Keyboard Input **/
-	switch (input_get_key()) {
-	case ESC_BREAK:
-		printf("ESC BREAK_CODE DETECTED: 0x%X\n", ESC_BREAK);
-		free(scores);
-		scores = NULL;
+	if (key_released_this_frame(KEY_ESC)) {
+		printf("ESC RELEASE DETECTED\n");
 		return 1;
-		break;
-	default:
-		break;
 	}
 
 	//Checking if Exit Button clicked
 	if (mouse_inside_circle(EXIT_X, EXIT_Y, EXIT_RADIUS) && get_mouseRMB()) {
-		free(scores);
-		scores = NULL;
 		return 1;
 	}
 
@@ -703,13 +2291,13 @@ static int highscores_timer_handler() {
 			ALIGN_LEFT);
 
 	unsigned i;
-	for (i = 0; i < HIGHSCORE_NUMBER; ++i) {
-		draw_score(scores[i].score, SCORE_SCORE_X, SCORE_Y + i * SCORE_Y_INC);
-		draw_score(scores[i].hour, SCORE_HOUR_X, SCORE_Y + i * SCORE_Y_INC);
-		draw_score(scores[i].minute, SCORE_MINUTE_X, SCORE_Y + i * SCORE_Y_INC);
-		draw_score(scores[i].day, SCORE_DAY_X, SCORE_Y + i * SCORE_Y_INC);
-		draw_score(scores[i].month, SCORE_MONTH_X, SCORE_Y + i * SCORE_Y_INC);
-		draw_score(scores[i].year, SCORE_YEAR_X, SCORE_Y + i * SCORE_Y_INC);
+	for (i = 0; i < HIGHSCORE_NUMBER && NULL != (score = highscores_at(i)); ++i) {
+		draw_score(score->score, SCORE_SCORE_X, SCORE_Y + i * SCORE_Y_INC);
+		draw_score(score->hour, SCORE_HOUR_X, SCORE_Y + i * SCORE_Y_INC);
+		draw_score(score->minute, SCORE_MINUTE_X, SCORE_Y + i * SCORE_Y_INC);
+		draw_score(score->day, SCORE_DAY_X, SCORE_Y + i * SCORE_Y_INC);
+		draw_score(score->month, SCORE_MONTH_X, SCORE_Y + i * SCORE_Y_INC);
+		draw_score(score->year, SCORE_YEAR_X, SCORE_Y + i * SCORE_Y_INC);
 	}
 
 	// Draw mouse cross last, so it is in the top layer
@@ -722,13 +2310,9 @@ static int highscores_timer_handler() {
 static int multiplayer_end_animation(int winner_flag) {
 
 	/** Handle Keyboard Input **/
-	switch (input_get_key()) {
-	case ESC_BREAK:
-		printf("ESC BREAK_CODE DETECTED: 0x%X\n", ESC_BREAK);
+	if (key_released_this_frame(KEY_ESC)) {
+		printf("ESC RELEASE DETECTED\n");
 		return 1;
-		break;
-	default:
-		break;
 	}
 
 	// Draw Background
@@ -3,12 +3,18 @@
 
 #include "Bitmap.h"
 #include "BMPsHolder.h"
+#include "Replay.h"
 
 #define OK			0
 
-#define FRAME_RATE	60
+#define FRAME_RATE	60		/**< @brief Simulation steps per second. Velocities and delays are counted in steps */
+#define RENDER_RATE	60		/**< @brief Timer 0 frequency, frames drawn per second (30, 60, 120 or 144) */
+
+#define SIM_DT_US		(1000000 / FRAME_RATE)	/**< @brief Length of a simulation step, in microseconds */
+#define MAX_SIM_STEPS	8	/**< @brief Most steps simulated per frame drawn. Time beyond that is dropped */
 
 #define MAX_NUM_MISSILES	4
+#define WAVE_DRAW_CHUNK		64	/**< @brief Enemy missiles of a wave whose random values are drawn at once */
 
 #define GROUND_Y					595
 
@@ -17,8 +23,25 @@
 #define LEFT_CANNON_POS_X			5
 #define RIGHT_CANNON_POS_X			795
 #define CANNON_PROJECTILE_OFFSET	32
+#define KEY_AIM_SPEED				6	/**< @brief Pixels the aim moves per step while an arrow or WASD is held */
+#define KEY_FIRE_PERIOD				12	/**< @brief Steps between two missiles while SPACE is held */
+
+#ifndef SAVE_PATH
+#define SAVE_PATH					RES_PATH "Save.bin"	/**< @brief Single player game left with ESC, resumed from the menu */
+#endif
+#define SAVE_MAX_MISSILES			1024
+#define SAVE_MAX_EXPLOSIONS			512
+#define SAVE_MAX_IMPACTS			1024
 
-#define SCORES_TXT_PATH				"/home/planetary_defense/res/Scores.txt"
+#ifndef SCORES_PATH
+#define SCORES_PATH					RES_PATH "Scores.bin"	/**< @brief The leaderboard */
+#endif
+#ifndef SCORES_TXT_PATH
+#define SCORES_TXT_PATH				RES_PATH "Scores.txt"	/**< @brief Table of the versions before the leaderboard, imported once */
+#endif
+
+#define SPECTATE_KEYFRAME			120	/**< @brief Steps between two keyframes of a watched game */
+#define WATCH_MAX_BACKLOG			4	/**< @brief Steps the watching end falls behind at most before catching up */
 
 #define SCORE_SCORE_X				169
 #define SCORE_HOUR_X				297
@@ -33,9 +56,175 @@ typedef enum {
 	MENU, GAME_SINGLE, GAME_MULTI, HIGH_SCORES, END_GAME_ANIMATION, MP_END_ANIMATION
 } game_state_t;
 
+/**
+ * @brief Stress scenario: replaces the spawn curve with waves and plays automatically,
+ * to load the engine with far more entities than a normal game reaches
+ */
+typedef struct {
+	unsigned wave_size;		///> Enemy missiles in the first wave
+	unsigned wave_growth;	///> Enemy missiles added to each following wave
+	unsigned wave_period;	///> Frames between two waves
+	unsigned max_enemies;	///> Most enemy missiles alive at once, 0 for no limit
+	unsigned auto_fire;		///> Friendly missiles fired per frame at enemy missiles
+	unsigned max_friendly;	///> Most friendly missiles alive at once
+	int invulnerable;		///> Bases take no damage, so the game never ends
+} Stress_t;
+
+/**
+ * @brief Counters of a watched game, on the playing end
+ */
+typedef struct {
+	unsigned long steps;			///> Steps sent
+	unsigned long bytes;			///> Bytes sent for them, framing included
+	unsigned max_bytes;				///> Most bytes sent for a step
+	unsigned long keyframes;		///> Steps sent whole
+	unsigned long keyframe_bytes;	///> Bytes sent for the keyframes, framing included
+	unsigned long keyframe_missiles;	///> Missiles in the keyframes
+	unsigned long keyframe_missile_bits;	///> Bits the missiles took in them
+	unsigned long spawned;			///> Missiles sent as spawned in deltas
+	unsigned long spawn_bits;		///> Bits they took
+	unsigned long dropped;			///> Steps not sent, the other end being too far behind
+} SpectateStats_t;
+
+/**
+ * Snapshot of a game in progress: every value the following steps depend on, so
+ * restoring it and replaying the same input reproduces the same game
+ */
+struct snapshot_t;
+typedef struct snapshot_t Snapshot;
+
+/**
+ * @brief Constructs a new, empty, Snapshot. Memory is allocated once, here
+ *
+ * @param max_missiles Most missiles, enemy and friendly ones together, the Snapshot holds
+ * @param max_explosions Most explosions the Snapshot holds
+ * @param max_impacts Most predicted impacts the Snapshot holds
+ *
+ * @return Pointer to the newly created Snapshot, NULL on failure
+ */
+Snapshot * new_snapshot(unsigned max_missiles, unsigned max_explosions,
+		unsigned max_impacts);
+
+/**
+ * @brief Deletes a Snapshot
+ *
+ * @param snap Pointer to the Snapshot to be deleted
+ */
+void delete_snapshot(Snapshot * snap);
+
+/**
+ * @brief Saves the current game to a Snapshot, without allocating memory
+ *
+ * @param snap Snapshot to overwrite
+ *
+ * @return 0 on success, non-zero if there is no game in progress (or it is ending)
+ * or it does not fit in the Snapshot
+ */
+int snapshot_save(Snapshot * snap);
+
+/**
+ * @brief Makes a saved game the current one, starting it if needed.
+ * Once restores have been done, objects are reused and nothing is allocated
+ *
+ * @param snap Snapshot filled by snapshot_save() or snapshot_read()
+ *
+ * @return 0 on success, non-zero if the Snapshot is empty
+ */
+int snapshot_restore(const Snapshot * snap);
+
+/**
+ * @brief Writes a Snapshot to a file
+ *
+ * The file is little endian, written field by field; it is written whole under another
+ * name, then renamed over path, so a failure leaves the old file as it was.
+ *
+ * @param snap Snapshot to write
+ * @param path File to write, overwritten
+ *
+ * @return 0 on success, non-zero otherwise
+ */
+int snapshot_write(const Snapshot * snap, const char * path);
+
+/**
+ * @brief Reads a Snapshot written by snapshot_write()
+ *
+ * @param snap Snapshot to overwrite
+ * @param path File to read
+ *
+ * @return 0 on success, non-zero if the file is missing, of another version or does not fit
+ */
+int snapshot_read(Snapshot * snap, const char * path);
+
+/**
+ * @brief Enables or disables the stress scenario, from the next game on
+ *
+ * @param stress Scenario to play, copied. NULL goes back to the normal game
+ */
+void planetary_set_stress(const Stress_t * stress);
+
+/**
+ * @brief Asks to watch the multiplayer games instead of playing them.
+ * Takes effect on the next connection
+ */
+void planetary_set_watch(int watch);
+
+/**
+ * @brief Plays the multiplayer games in a ring of 3 or 4 machines, each with COM1 cabled
+ * to COM2 of the one before. Tells whether the rate carries every input of every step
+ *
+ * @param nodes Machines of the ring, 0 for two machines on COM1
+ * @param index This machine, 0 leads
+ * @param rate Bit rate of every cable
+ *
+ * @return 0 on success, non-zero if the ring is invalid
+ */
+int planetary_set_ring(unsigned nodes, unsigned index, unsigned long rate);
+
+/**
+ * @brief Gets the counters of the last watched game
+ */
+const SpectateStats_t * planetary_get_spectate_stats();
+
+/**
+ * @brief Sets the frequency timer_handler() is called at
+ *
+ * The simulation keeps running at FRAME_RATE steps per second whatever the rate,
+ * drawing interpolates between the last two steps.
+ *
+ * @param rate Timer 0 frequency, in Hz
+ */
+void planetary_set_render_rate(unsigned long rate);
+
+/**
+ * @brief Feeds the simulation the time measured by now_us() between two timer_handler()
+ * calls, instead of the period of the interrupt
+ *
+ * Timer interrupts that pile up behind a slow frame come as one, so only the measured
+ * time keeps the game at its pace on a slow machine: it then draws fewer frames, each
+ * simulating more steps (MAX_SIM_STEPS at most).
+ *
+ * @param measured Whether to measure the time, off by default for runs that must not depend on it
+ */
+void planetary_measure_time(int measured);
+
+/**
+ * @brief Gets the screen currently shown
+ *
+ * @return Current state of the State-Machine run by timer_handler()
+ */
+game_state_t planetary_get_state();
+
+/**
+ * @brief Gets the state of the last game step, which a replay of the session must reproduce
+ *
+ * @param check Filled with the frames, score and entity counts of the last game step
+ */
+void planetary_get_check(ReplayCheck_t * check);
+
 /**
  * @brief Timer 0 interrupt handler. Regulates Frame-Rate.
- * Uses a State-Machine to call the appropriate "draw state".
+ * Runs the simulation steps due since the last call, then
+ * uses a State-Machine to call the appropriate "draw state".
  * @return Returns non-zero when user event dictates end of application.
  */
 int timer_handler();
@@ -3,6 +3,10 @@
 
 #include <stdint.h>
 
+#if HEADLESS
+typedef uint32_t phys_bytes;	// From <minix/types.h> otherwise
+#endif
+
 /** @defgroup vbe vbe
  * @{
  *
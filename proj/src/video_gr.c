@@ -1,8 +1,15 @@
+#if HEADLESS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define OK	0
+#else
 #include <minix/syslib.h>
 #include <minix/drivers.h>
 #include <machine/int86.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#endif
 
 #include "video_gr.h"
 #include "vbe.h"
@@ -40,6 +47,34 @@ int is_valid_pos(unsigned short x, unsigned short y) {
 	return (x < h_res && y < v_res) ? OK : 1;
 }
 
+#if HEADLESS
+// No VBE nor VRAM: frames are drawn to, and flipped into, ordinary memory
+int vg_init(unsigned short mode) {
+	if (MODE_800X600_64k != mode) {
+		printf("vg_init(): only 800x600 64k is available headless\n");
+		return 1;
+	}
+
+	h_res = 800;
+	v_res = 600;
+	bits_per_pixel = 16;
+	vram_size = h_res * v_res * bits_per_pixel / 8;
+
+	video_mem = malloc(vram_size);
+	buffer_ptr = malloc(vram_size);
+
+	return (NULL == video_mem || NULL == buffer_ptr) ? 1 : OK;
+}
+
+int vg_exit() {
+	free(video_mem);
+	free(buffer_ptr);
+
+	return 0;
+}
+
+#else
+
 // Snippet based on the PDF
 int vg_init(unsigned short mode) {
 	struct reg86u r;
@@ -103,6 +138,8 @@ int vg_exit() {
 		return 0;
 }
 
+#endif
+
 int draw_line(unsigned short xi, unsigned short yi, unsigned short xf,
 		unsigned short yf, uint16_t color) {
 
@@ -221,19 +258,21 @@ int draw_mouse_cross(const int * pos, uint16_t color) {
 	return OK;
 }
 
-void draw_missile(Missile * ptr) {
+void draw_missile(Missile * ptr, fixed_t alpha) {
 	unsigned thickness = 2, idx = 0;
+	int pos[2];
+
+	missile_getDrawPos(ptr, alpha, pos);
 
 	for (; idx < thickness; ++idx) {
 		draw_line(missile_getInitX(ptr) + idx, missile_getInitY(ptr),
-				missile_getPosX(ptr) + idx, missile_getPosY(ptr),
-				missile_getColor(ptr));
+				pos[0] + idx, pos[1], missile_getColor(ptr));
 	}
-	draw_circle(missile_getPosX(ptr), missile_getPosY(ptr), 3, MAGENTA);
+	draw_circle(pos[0], pos[1], 3, MAGENTA);
 }
 
-void draw_explosion(Explosion * ptr) {
-	drawBitmap(buffer_ptr, explosion_getBitmap(ptr), explosion_getPosX(ptr),
+void draw_explosion(Explosion * ptr, unsigned long frame) {
+	drawBitmap(buffer_ptr, explosion_getBitmap(ptr, frame), explosion_getPosX(ptr),
 			explosion_getPosY(ptr) - (EXPLOSION_SIZE_X / 2), ALIGN_CENTER);
 }
 
@@ -257,7 +296,7 @@ void draw_score_big(unsigned num, unsigned posX, unsigned posY) {
 
 uint16_t rgb(unsigned char red_value, unsigned char green_value,
 		unsigned char blue_value) {
-	uint16_t return_value;
+	uint16_t return_value = 0;
 
 	//Setting Blue
 	return_value += (blue_value >> 3);
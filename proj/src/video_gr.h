@@ -122,8 +122,17 @@ int draw_mouse_cross(const int * mouse_pos, uint16_t color);
  * @brief Draws a missile
  *
  * @param Pointer to the Missile in question
+ * @param alpha Fraction of a simulation step elapsed since the last update, 16.16
  */
-void draw_missile(Missile * ptr);
+void draw_missile(Missile * ptr, fixed_t alpha);
+
+/**
+ * @brief Draws an explosion
+ *
+ * @param ptr Pointer to the Explosion in question
+ * @param frame Current frame, selects the bitmap of the animation
+ */
+void draw_explosion(Explosion * ptr, unsigned long frame);
 
 /**
  * @brief Draws a number at certain position